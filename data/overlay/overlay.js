@@ -0,0 +1,95 @@
+(() => {
+  "use strict";
+
+  const params = new URLSearchParams(location.search);
+  const maxLines = Math.max(1, Number(params.get("lines") || 2));
+  const showPartial = params.get("partial") !== "0";
+  const timeoutSeconds = Number(params.get("timeout") || 8);
+
+  const container = document.getElementById("captions");
+  let partialLine = null;
+  let retryDelay = 500;
+
+  function createLine(className) {
+    const line = document.createElement("div");
+    line.className = className;
+    container.appendChild(line);
+    return line;
+  }
+
+  function trimLines() {
+    const finals = container.querySelectorAll(".line.final");
+    for (let i = 0; i < finals.length - maxLines; ++i) {
+      finals[i].remove();
+    }
+  }
+
+  function showFinal(text) {
+    if (partialLine) {
+      partialLine.remove();
+      partialLine = null;
+    }
+    if (!text) {
+      return;
+    }
+    const line = createLine("line final");
+    line.textContent = text;
+    trimLines();
+    if (timeoutSeconds > 0) {
+      setTimeout(() => {
+        line.classList.add("fading");
+        line.addEventListener("transitionend", () => line.remove(), { once: true });
+      }, timeoutSeconds * 1000);
+    }
+  }
+
+  function showPartialText(text) {
+    if (!showPartial) {
+      return;
+    }
+    if (!text) {
+      if (partialLine) {
+        partialLine.remove();
+        partialLine = null;
+      }
+      return;
+    }
+    if (!partialLine) {
+      partialLine = createLine("line partial");
+    }
+    partialLine.textContent = text;
+  }
+
+  function handleMessage(data) {
+    let result;
+    try {
+      result = JSON.parse(data);
+    } catch {
+      return; // Control replies such as "ok subscribe" are not JSON
+    }
+    if (typeof result.text === "string") {
+      showFinal(result.text);
+    } else if (typeof result.partial === "string") {
+      showPartialText(result.partial);
+    }
+  }
+
+  function connect() {
+    const scheme = location.protocol === "https:" ? "wss:" : "ws:";
+    const socket = new WebSocket(`${scheme}//${location.host}/`);
+    socket.addEventListener("open", () => {
+      retryDelay = 500;
+      socket.send("unsubscribe broadcast");
+      if (!showPartial) {
+        socket.send("unsubscribe partial");
+      }
+    });
+    socket.addEventListener("message", (event) => handleMessage(event.data));
+    socket.addEventListener("close", () => {
+      setTimeout(connect, retryDelay);
+      retryDelay = Math.min(retryDelay * 2, 10000);
+    });
+  }
+
+  connect();
+})();
@@ -0,0 +1,396 @@
+/*
+Bridge Utils
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include "InplaceFunction.hpp"
+
+namespace KaitoTokyo {
+namespace BridgeUtils {
+
+class CancellationCallback;
+
+namespace Detail {
+
+class CancellationRegistry;
+
+/**
+ * @brief The shared state of one cancellation source, living in a slot of the CancellationRegistry.
+ *
+ * Tokens hold intrusive references to their slot. The last one returns it to the registry, which bumps its
+ * generation, so a token that somehow outlived its slot is caught by an assertion instead of observing the
+ * cancellation of an unrelated operation.
+ */
+class CancellationSlot {
+public:
+	void addRef() noexcept { refs.fetch_add(1, std::memory_order_relaxed); }
+	inline void release() noexcept;
+
+	std::uint32_t generation() const noexcept { return currentGeneration.load(std::memory_order_relaxed); }
+
+	bool isCancelled() const noexcept { return cancelled.load(std::memory_order_acquire); }
+
+	/**
+	 * @brief Marks the slot cancelled and runs the registered callbacks on the calling thread.
+	 * @return false if it was already cancelled.
+	 */
+	inline bool cancel() noexcept;
+
+private:
+	friend class CancellationRegistry;
+	friend class BridgeUtils::CancellationCallback;
+
+	void lock() noexcept
+	{
+		while (locked.test_and_set(std::memory_order_acquire)) {
+			std::this_thread::yield();
+		}
+	}
+
+	void unlock() noexcept { locked.clear(std::memory_order_release); }
+
+	std::atomic<std::uint32_t> refs{0};
+	std::atomic<std::uint32_t> currentGeneration{0};
+	std::atomic<std::uint32_t> nextFree{0}; ///< One plus the index of the next free slot, 0 for none.
+	std::atomic<bool> cancelled{false};
+	std::atomic_flag locked = ATOMIC_FLAG_INIT;
+	std::uint32_t index = 0;
+	CancellationCallback *callbacks = nullptr; ///< Guarded by locked.
+};
+
+/**
+ * @brief A process-wide table of cancellation slots, allocated in chunks that are kept until exit.
+ *
+ * Free slots form a lock-free stack whose head carries a generation tag against ABA, so acquiring and
+ * releasing a slot never allocates once the table is large enough for the tokens alive at the same time.
+ */
+class CancellationRegistry {
+public:
+	static constexpr std::uint32_t slotsPerChunk = 1024;
+	static constexpr std::uint32_t maxChunks = 1024;
+
+	static CancellationRegistry &instance()
+	{
+		static CancellationRegistry registry;
+		return registry;
+	}
+
+	~CancellationRegistry()
+	{
+		for (std::uint32_t i = 0; i < chunkCount; ++i) {
+			delete[] chunks[i].load(std::memory_order_relaxed);
+		}
+	}
+
+	CancellationRegistry(const CancellationRegistry &) = delete;
+	CancellationRegistry &operator=(const CancellationRegistry &) = delete;
+
+	/**
+	 * @brief Takes a free slot with a single reference.
+	 * @throws std::length_error if maxChunks * slotsPerChunk tokens are alive.
+	 */
+	CancellationSlot *acquire()
+	{
+		while (true) {
+			std::uint64_t head = freeHead.load(std::memory_order_acquire);
+			while (head & indexMask) {
+				CancellationSlot *slot = at(static_cast<std::uint32_t>(head & indexMask) - 1);
+				const std::uint32_t nextFree = slot->nextFree.load(std::memory_order_relaxed);
+				const std::uint64_t next = nextTag(head) | nextFree;
+				if (freeHead.compare_exchange_weak(head, next, std::memory_order_acquire)) {
+					slot->refs.store(1, std::memory_order_relaxed);
+					return slot;
+				}
+			}
+			grow();
+		}
+	}
+
+	void recycle(CancellationSlot *slot) noexcept
+	{
+		assert(slot->callbacks == nullptr);
+		slot->cancelled.store(false, std::memory_order_relaxed);
+		slot->currentGeneration.fetch_add(1, std::memory_order_relaxed);
+		pushFree(*slot);
+	}
+
+private:
+	static constexpr std::uint64_t indexMask = 0xffffffffu;
+
+	CancellationRegistry() { grow(); }
+
+	static std::uint64_t nextTag(std::uint64_t head) noexcept { return ((head >> 32) + 1) << 32; }
+
+	CancellationSlot *at(std::uint32_t index) const noexcept
+	{
+		return &chunks[index / slotsPerChunk].load(std::memory_order_acquire)[index % slotsPerChunk];
+	}
+
+	void pushFree(CancellationSlot &slot) noexcept
+	{
+		std::uint64_t head = freeHead.load(std::memory_order_relaxed);
+		do {
+			slot.nextFree.store(static_cast<std::uint32_t>(head & indexMask), std::memory_order_relaxed);
+		} while (!freeHead.compare_exchange_weak(head, nextTag(head) | (slot.index + 1),
+							 std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	void grow()
+	{
+		std::lock_guard<std::mutex> lock(growMutex);
+		if (freeHead.load(std::memory_order_acquire) & indexMask) {
+			return; // Another thread has just grown the table or released a slot
+		}
+		if (chunkCount == maxChunks) {
+			throw std::length_error("too many live cancellation tokens");
+		}
+
+		auto chunk = std::make_unique<CancellationSlot[]>(slotsPerChunk);
+		for (std::uint32_t i = 0; i < slotsPerChunk; ++i) {
+			chunk[i].index = chunkCount * slotsPerChunk + i;
+		}
+		CancellationSlot *slots = chunk.release();
+		chunks[chunkCount++].store(slots, std::memory_order_release);
+		for (std::uint32_t i = slotsPerChunk; i > 0; --i) {
+			pushFree(slots[i - 1]);
+		}
+	}
+
+	std::array<std::atomic<CancellationSlot *>, maxChunks> chunks{};
+	std::uint32_t chunkCount = 0; ///< Guarded by growMutex.
+	std::mutex growMutex;
+	std::atomic<std::uint64_t> freeHead{0}; ///< Generation tag in the upper half, one plus index in the lower.
+};
+
+inline void CancellationSlot::release() noexcept
+{
+	if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		CancellationRegistry::instance().recycle(this);
+	}
+}
+
+} // namespace Detail
+
+/**
+ * @brief A cheap, copyable handle to a cancellation state, e.g. the one a queue hands to each task.
+ *
+ * Checking a token is a single atomic load, and copying it only bumps an intrusive count. A default-constructed
+ * token is never cancelled.
+ */
+class CancellationToken {
+public:
+	CancellationToken() noexcept = default;
+
+	CancellationToken(const CancellationToken &other) noexcept : slot(other.slot), generation(other.generation)
+	{
+		if (slot) {
+			slot->addRef();
+		}
+	}
+
+	CancellationToken(CancellationToken &&other) noexcept
+		: slot(std::exchange(other.slot, nullptr)),
+		  generation(other.generation)
+	{
+	}
+
+	CancellationToken &operator=(CancellationToken other) noexcept
+	{
+		std::swap(slot, other.slot);
+		std::swap(generation, other.generation);
+		return *this;
+	}
+
+	~CancellationToken()
+	{
+		if (slot) {
+			slot->release();
+		}
+	}
+
+	bool isCancelled() const noexcept
+	{
+		assert(!slot || slot->generation() == generation);
+		return slot && slot->isCancelled();
+	}
+
+	/**
+	 * @brief Requests cancellation and runs the registered callbacks on the calling thread.
+	 * @return true if this call cancelled it, false if it was already cancelled or the token is empty.
+	 */
+	bool cancel() const noexcept { return slot && slot->cancel(); }
+
+	/**
+	 * @brief Tells whether the token refers to a cancellation state at all.
+	 */
+	explicit operator bool() const noexcept { return slot != nullptr; }
+
+private:
+	friend class CancellationSource;
+	friend class CancellationCallback;
+
+	explicit CancellationToken(Detail::CancellationSlot *_slot) noexcept
+		: slot(_slot),
+		  generation(_slot->generation())
+	{
+	}
+
+	Detail::CancellationSlot *slot = nullptr;
+	std::uint32_t generation = 0;
+};
+
+/**
+ * @brief Creates a cancellation state and hands out tokens observing it.
+ *
+ * The state lives in a slot of a preallocated table and goes back to it when the source and all its tokens are
+ * gone, so creating one does not allocate.
+ */
+class CancellationSource {
+public:
+	CancellationSource() : state(Detail::CancellationRegistry::instance().acquire()) {}
+
+	CancellationToken token() const noexcept { return state; }
+
+	bool cancel() const noexcept { return state.cancel(); }
+
+	bool isCancelled() const noexcept { return state.isCancelled(); }
+
+private:
+	CancellationToken state;
+};
+
+/**
+ * @brief Runs a callback once its token is cancelled, for as long as this object lives. Like std::stop_callback.
+ *
+ * The callback runs on the thread that cancels, or right away in the constructor if the token is already
+ * cancelled. It must not throw. The destructor unregisters it, and if it is running on another thread at that
+ * moment, waits for it to return. Captures must fit into callbackCapacity bytes, so registering never allocates.
+ */
+class CancellationCallback {
+public:
+	static constexpr std::size_t callbackCapacity = 48;
+	using Callback = InplaceFunction<void(), callbackCapacity>;
+
+	CancellationCallback(const CancellationToken &_token, Callback _callback)
+		: token(_token),
+		  callback(std::move(_callback))
+	{
+		Detail::CancellationSlot *slot = token.slot;
+		if (!slot) {
+			return;
+		}
+		slot->lock();
+		if (slot->isCancelled()) {
+			slot->unlock();
+			callback();
+			done.store(true, std::memory_order_release);
+			return;
+		}
+		next = slot->callbacks;
+		if (next) {
+			next->previous = this;
+		}
+		slot->callbacks = this;
+		registered = true;
+		slot->unlock();
+	}
+
+	~CancellationCallback()
+	{
+		Detail::CancellationSlot *slot = token.slot;
+		if (!slot) {
+			return;
+		}
+		slot->lock();
+		if (registered) {
+			(previous ? previous->next : slot->callbacks) = next;
+			if (next) {
+				next->previous = previous;
+			}
+			slot->unlock();
+			return;
+		}
+		const bool invokedHere = invoker == std::this_thread::get_id();
+		slot->unlock();
+		if (invokedHere) {
+			if (destroyedDuringCall) {
+				*destroyedDuringCall = true; // Destroyed by the callback itself
+			}
+			return;
+		}
+		while (!done.load(std::memory_order_acquire)) {
+			std::this_thread::yield();
+		}
+	}
+
+	CancellationCallback(const CancellationCallback &) = delete;
+	CancellationCallback &operator=(const CancellationCallback &) = delete;
+
+private:
+	friend class Detail::CancellationSlot;
+
+	CancellationToken token;
+	Callback callback;
+	CancellationCallback *previous = nullptr; ///< The links and the fields below are guarded by the slot's lock.
+	CancellationCallback *next = nullptr;
+	bool registered = false;
+	std::thread::id invoker;
+	bool *destroyedDuringCall = nullptr;
+	std::atomic<bool> done{false};
+};
+
+inline bool Detail::CancellationSlot::cancel() noexcept
+{
+	if (cancelled.exchange(true, std::memory_order_acq_rel)) {
+		return false;
+	}
+	lock();
+	while (CancellationCallback *entry = callbacks) {
+		callbacks = entry->next;
+		if (callbacks) {
+			callbacks->previous = nullptr;
+		}
+		entry->registered = false;
+		entry->invoker = std::this_thread::get_id();
+		bool destroyed = false;
+		entry->destroyedDuringCall = &destroyed;
+		unlock();
+
+		entry->callback();
+		if (!destroyed) {
+			entry->destroyedDuringCall = nullptr;
+			entry->done.store(true, std::memory_order_release);
+		}
+		lock();
+	}
+	unlock();
+	return true;
+}
+
+} // namespace BridgeUtils
+} // namespace KaitoTokyo
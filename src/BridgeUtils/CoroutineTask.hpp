@@ -0,0 +1,371 @@
+/*
+Bridge Utils
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+// The plugin itself is built as C++17, where this header is empty. Targets built as C++20 get coroutines.
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <array>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <new>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "TaskFuture.hpp"
+#include "ThrottledTaskQueue.hpp"
+
+namespace KaitoTokyo {
+namespace BridgeUtils {
+
+/**
+ * @brief Recycles coroutine frames through per-thread free lists of power-of-two size classes.
+ *
+ * A frame freed on another thread than it was allocated on simply joins that thread's list. Each list keeps
+ * at most maxCachedPerClass frames; frames larger than the largest class go straight to the global heap.
+ */
+class CoroutineFramePool {
+public:
+	static void *allocate(std::size_t size)
+	{
+		const std::size_t sizeClass = classOf(size);
+		if (sizeClass == classCount) {
+			return ::operator new(size);
+		}
+		std::vector<void *> &list = cache().lists[sizeClass];
+		if (list.empty()) {
+			return ::operator new(classSize(sizeClass));
+		}
+		void *frame = list.back();
+		list.pop_back();
+		return frame;
+	}
+
+	static void deallocate(void *frame, std::size_t size) noexcept
+	{
+		const std::size_t sizeClass = classOf(size);
+		if (sizeClass == classCount) {
+			::operator delete(frame);
+			return;
+		}
+		std::vector<void *> &list = cache().lists[sizeClass];
+		if (list.size() >= maxCachedPerClass) {
+			::operator delete(frame);
+			return;
+		}
+		try {
+			list.push_back(frame);
+		} catch (...) {
+			::operator delete(frame);
+		}
+	}
+
+private:
+	static constexpr std::size_t minClassSize = 64;
+	static constexpr std::size_t classCount = 7; ///< 64 to 4096 bytes.
+	static constexpr std::size_t maxCachedPerClass = 64;
+
+	struct Cache {
+		std::array<std::vector<void *>, classCount> lists;
+
+		~Cache()
+		{
+			for (std::vector<void *> &list : lists) {
+				for (void *frame : list) {
+					::operator delete(frame);
+				}
+			}
+		}
+	};
+
+	static Cache &cache()
+	{
+		thread_local Cache instance;
+		return instance;
+	}
+
+	static constexpr std::size_t classSize(std::size_t sizeClass) noexcept { return minClassSize << sizeClass; }
+
+	static std::size_t classOf(std::size_t size) noexcept
+	{
+		std::size_t sizeClass = 0;
+		while (sizeClass < classCount && classSize(sizeClass) < size) {
+			++sizeClass;
+		}
+		return sizeClass;
+	}
+};
+
+namespace Detail {
+
+struct TaskPromiseBase {
+	std::coroutine_handle<> continuation;
+	std::exception_ptr exception;
+
+	struct FinalAwaiter {
+		bool await_ready() const noexcept { return false; }
+
+		template<typename Promise>
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) const noexcept
+		{
+			const std::coroutine_handle<> next = handle.promise().continuation;
+			return next ? next : std::noop_coroutine();
+		}
+
+		void await_resume() const noexcept {}
+	};
+
+	std::suspend_always initial_suspend() const noexcept { return {}; }
+	FinalAwaiter final_suspend() const noexcept { return {}; }
+	void unhandled_exception() noexcept { exception = std::current_exception(); }
+
+	static void *operator new(std::size_t size) { return CoroutineFramePool::allocate(size); }
+	static void operator delete(void *frame, std::size_t size) noexcept
+	{
+		CoroutineFramePool::deallocate(frame, size);
+	}
+
+	void rethrowIfFailed() const
+	{
+		if (exception) {
+			std::rethrow_exception(exception);
+		}
+	}
+};
+
+template<typename T> struct TaskPromiseValue : TaskPromiseBase {
+	std::optional<T> value;
+
+	template<typename U> void return_value(U &&result) { value.emplace(std::forward<U>(result)); }
+
+	T result()
+	{
+		rethrowIfFailed();
+		return std::move(*value);
+	}
+};
+
+template<> struct TaskPromiseValue<void> : TaskPromiseBase {
+	void return_void() const noexcept {}
+	void result() const { rethrowIfFailed(); }
+};
+
+} // namespace Detail
+
+/**
+ * @brief A lazily started coroutine producing a T, e.g. `Task<std::string> serialize()`.
+ *
+ * Nothing runs until the task is awaited with co_await or handed to spawn. The awaiting coroutine is resumed
+ * directly on whatever thread the task finishes on, and exceptions propagate to it.
+ */
+template<typename T = void> class [[nodiscard]] Task {
+public:
+	struct promise_type : Detail::TaskPromiseValue<T> {
+		Task get_return_object() noexcept
+		{
+			return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+		}
+	};
+
+	Task(Task &&other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+
+	Task &operator=(Task &&other) noexcept
+	{
+		if (this != &other) {
+			reset();
+			handle = std::exchange(other.handle, nullptr);
+		}
+		return *this;
+	}
+
+	~Task() { reset(); }
+
+	Task(const Task &) = delete;
+	Task &operator=(const Task &) = delete;
+
+	auto operator co_await() && noexcept
+	{
+		struct Awaiter {
+			std::coroutine_handle<promise_type> handle;
+
+			bool await_ready() const noexcept { return false; }
+
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+			{
+				handle.promise().continuation = awaiting;
+				return handle;
+			}
+
+			T await_resume() { return handle.promise().result(); }
+		};
+		return Awaiter{handle};
+	}
+
+private:
+	explicit Task(std::coroutine_handle<promise_type> _handle) noexcept : handle(_handle) {}
+
+	void reset() noexcept
+	{
+		if (handle) {
+			handle.destroy();
+			handle = nullptr;
+		}
+	}
+
+	std::coroutine_handle<promise_type> handle;
+};
+
+namespace Detail {
+
+/**
+ * @brief An eagerly started coroutine that destroys itself when done. Only used by spawn.
+ */
+struct DetachedTask {
+	struct promise_type {
+		DetachedTask get_return_object() const noexcept { return {}; }
+		std::suspend_never initial_suspend() const noexcept { return {}; }
+		std::suspend_never final_suspend() const noexcept { return {}; }
+		void return_void() const noexcept {}
+		void unhandled_exception() const noexcept { std::terminate(); }
+
+		static void *operator new(std::size_t size) { return CoroutineFramePool::allocate(size); }
+		static void operator delete(void *frame, std::size_t size) noexcept
+		{
+			CoroutineFramePool::deallocate(frame, size);
+		}
+	};
+};
+
+inline DetachedTask runDetached(Task<> task, std::function<void(std::exception_ptr)> onComplete)
+{
+	std::exception_ptr exception;
+	try {
+		co_await std::move(task);
+	} catch (...) {
+		exception = std::current_exception();
+	}
+	if (onComplete) {
+		onComplete(exception);
+	}
+}
+
+} // namespace Detail
+
+/**
+ * @brief Starts a task on the calling thread without waiting for it.
+ * @param onComplete Called when the task finishes, with the exception it threw if any, e.g. OperationCancelled.
+ */
+inline void spawn(Task<> task, std::function<void(std::exception_ptr)> onComplete = {})
+{
+	Detail::runDetached(std::move(task), std::move(onComplete));
+}
+
+/**
+ * @brief Runs coroutines on the worker thread of a ThrottledTaskQueue.
+ *
+ * `co_await executor.schedule()` suspends the coroutine and resumes it as a task of the queue, pushed with the
+ * executor's options, and evaluates to the task's CancellationToken for cooperative checks later on.
+ *
+ * If that task is cancelled before it runs, whether by its token, by being dropped from a full lane, coalesced,
+ * expired or cancelled on shutdown, the co_await throws OperationCancelled instead. A task that never runs
+ * resumes the coroutine on the thread that discarded it, so the coroutine always gets to unwind.
+ */
+class QueueExecutor {
+public:
+	explicit QueueExecutor(ThrottledTaskQueue &_queue, ThrottledTaskQueue::PushOptions _options = {})
+		: queue(_queue),
+		  options(std::move(_options))
+	{
+	}
+
+	auto schedule() const
+	{
+		struct Awaiter {
+			ThrottledTaskQueue &queue;
+			const ThrottledTaskQueue::PushOptions &options;
+			ThrottledTaskQueue::CancellationToken token;
+
+			struct Resumption {
+				std::coroutine_handle<> handle;
+				Awaiter *awaiter;
+				bool resumed = false;
+
+				Resumption(std::coroutine_handle<> _handle, Awaiter *_awaiter)
+					: handle(_handle),
+					  awaiter(_awaiter)
+				{
+				}
+
+				Resumption(const Resumption &) = delete;
+				Resumption &operator=(const Resumption &) = delete;
+
+				void resume(const ThrottledTaskQueue::CancellationToken &token)
+				{
+					resumed = true;
+					awaiter->token = token;
+					handle.resume();
+				}
+
+				~Resumption()
+				{
+					if (!resumed) {
+						handle.resume(); // Without a token, so that the co_await throws
+					}
+				}
+			};
+
+			bool await_ready() const noexcept { return false; }
+
+			void await_suspend(std::coroutine_handle<> handle)
+			{
+				auto resumption = std::make_shared<Resumption>(handle, this);
+				try {
+					queue.push([resumption](const auto &queued) { resumption->resume(queued); },
+						   options);
+				} catch (...) {
+					resumption->resumed = true; // The exception resumes the coroutine instead
+					throw;
+				}
+				// The coroutine may already be running elsewhere, so this must not be touched any more
+			}
+
+			ThrottledTaskQueue::CancellationToken await_resume() const
+			{
+				if (!token || token.isCancelled()) {
+					throw OperationCancelled();
+				}
+				return token;
+			}
+		};
+		return Awaiter{queue, options, {}};
+	}
+
+private:
+	ThrottledTaskQueue &queue;
+	const ThrottledTaskQueue::PushOptions options;
+};
+
+} // namespace BridgeUtils
+} // namespace KaitoTokyo
+
+#endif // defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
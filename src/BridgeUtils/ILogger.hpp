@@ -18,9 +18,12 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <cstdio>
 #include <iterator>
+#include <mutex>
 #include <stdexcept>
 #include <string_view>
 #include <string>
@@ -32,11 +35,170 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 #include <backward.hpp>
 #endif // HAVE_BACKWARD
 
+/**
+ * @brief The lowest log level compiled in: 0 for debug, 1 for info, 2 for warn and 3 for error.
+ *
+ * Calls below it compile to nothing, although their arguments are still evaluated. Set by the build, which
+ * removes debug calls from release builds of the plugin.
+ */
+#ifndef BRIDGE_UTILS_MIN_LOG_LEVEL
+#define BRIDGE_UTILS_MIN_LOG_LEVEL 0
+#endif
+
+/**
+ * @brief Logs through ILogger::logRateLimited with a limiter of its own for this call site, e.g.
+ * `BRIDGE_UTILS_LOG_RATE_LIMITED(logger, Error, "Failed to decode: {}", e.what())`.
+ */
+#define BRIDGE_UTILS_LOG_RATE_LIMITED(logger, level, ...)                                                        \
+	do {                                                                                                     \
+		static ::KaitoTokyo::BridgeUtils::LogRateLimiter bridgeUtilsCallSiteLimiter(__FILE__, __LINE__); \
+		(logger).logRateLimited(bridgeUtilsCallSiteLimiter,                                              \
+					::KaitoTokyo::BridgeUtils::ILogger::LogLevel::level, __VA_ARGS__);       \
+	} while (false)
+
 namespace KaitoTokyo {
 namespace BridgeUtils {
 
+class ILogger;
+
+/**
+ * @brief Lets through at most burst messages per interval from one call site and counts the rest.
+ *
+ * The count is reported when the next message gets through after the interval has ended, or earlier by
+ * ILogger::reportSuppressed, which walks a registry of all live limiters. Decisions take a few relaxed atomic
+ * operations and no lock, so concurrent callers may occasionally let one message too many pass.
+ */
+class LogRateLimiter {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	struct Decision {
+		bool allowed;
+		std::uint64_t suppressedBefore; ///< Messages suppressed in the previous intervals, to be reported.
+		bool startedSuppressing;        ///< This is the first message held back since the last report.
+	};
+
+	/**
+	 * @param _file The source file of the call site, shown in the summary. May be a full path.
+	 */
+	LogRateLimiter(const char *_file, int _line, std::uint32_t _burst = 5,
+		       Clock::duration _interval = std::chrono::seconds(10)) noexcept
+		: file(baseName(_file)),
+		  line(_line),
+		  burst(_burst),
+		  interval(_interval.count())
+	{
+		Registry &registry = instance();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		next = registry.head;
+		if (next) {
+			next->previous = this;
+		}
+		registry.head = this;
+	}
+
+	~LogRateLimiter() noexcept
+	{
+		Registry &registry = instance();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		(previous ? previous->next : registry.head) = next;
+		if (next) {
+			next->previous = previous;
+		}
+	}
+
+	LogRateLimiter(const LogRateLimiter &) = delete;
+	LogRateLimiter &operator=(const LogRateLimiter &) = delete;
+
+	Decision acquire(Clock::time_point now) noexcept
+	{
+		std::uint64_t suppressedBefore = 0;
+		const Clock::rep ticks = now.time_since_epoch().count();
+		Clock::rep start = windowStart.load(std::memory_order_relaxed);
+		if (ticks - start >= interval && windowStart.compare_exchange_strong(start, ticks,
+										      std::memory_order_relaxed)) {
+			suppressedBefore = suppressed.exchange(0, std::memory_order_relaxed);
+			count.store(0, std::memory_order_relaxed);
+		}
+		if (count.fetch_add(1, std::memory_order_relaxed) < burst) {
+			return {true, suppressedBefore, false};
+		}
+		const bool first = suppressed.fetch_add(1, std::memory_order_relaxed) == 0;
+		return {false, suppressedBefore, first};
+	}
+
+	const char *const file;
+	const int line;
+
+private:
+	friend class ILogger;
+
+	/**
+	 * @brief The live limiters, so that their summaries can be reported from a timer.
+	 */
+	struct Registry {
+		std::mutex mutex;
+		LogRateLimiter *head = nullptr; ///< Guarded by mutex, as are the links of every limiter.
+	};
+
+	static Registry &instance() noexcept
+	{
+		static Registry registry;
+		return registry;
+	}
+
+	/**
+	 * @brief Calls fn(limiter) for every live limiter, with the registry locked.
+	 */
+	template<typename Fn> static void forEach(Fn &&fn) noexcept
+	{
+		Registry &registry = instance();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		for (LogRateLimiter *limiter = registry.head; limiter; limiter = limiter->next) {
+			fn(*limiter);
+		}
+	}
+
+	/**
+	 * @brief Takes the number of messages suppressed so far if the interval they fell in has ended.
+	 */
+	std::uint64_t takeSuppressed(Clock::time_point now) noexcept
+	{
+		if (suppressed.load(std::memory_order_relaxed) == 0 ||
+		    now.time_since_epoch().count() - windowStart.load(std::memory_order_relaxed) < interval) {
+			return 0;
+		}
+		return suppressed.exchange(0, std::memory_order_relaxed);
+	}
+
+	static const char *baseName(const char *path) noexcept
+	{
+		const char *name = path;
+		for (const char *p = path; *p; ++p) {
+			if (*p == '/' || *p == '\\') {
+				name = p + 1;
+			}
+		}
+		return name;
+	}
+
+	const std::uint32_t burst;
+	const Clock::rep interval;
+	std::atomic<Clock::rep> windowStart{0};
+	std::atomic<std::uint32_t> count{0};
+	std::atomic<std::uint64_t> suppressed{0};
+	std::atomic<const ILogger *> owner{nullptr}; ///< The logger last used with it. Only compared, never called.
+	std::atomic<std::int8_t> ownerLevel{0};
+	LogRateLimiter *previous = nullptr;
+	LogRateLimiter *next = nullptr;
+};
+
 class ILogger {
 public:
+	enum class LogLevel : std::int8_t { Debug, Info, Warn, Error };
+
+	static constexpr LogLevel compiledMinimumLevel = static_cast<LogLevel>(BRIDGE_UTILS_MIN_LOG_LEVEL);
+
 	ILogger() noexcept = default;
 	virtual ~ILogger() noexcept = default;
 
@@ -50,22 +212,90 @@ public:
 
 	template<typename... Args> void debug(fmt::format_string<Args...> fmt, Args &&...args) const noexcept
 	{
-		formatAndLog(LogLevel::Debug, fmt, std::forward<Args>(args)...);
+		logAt<LogLevel::Debug>(fmt, std::forward<Args>(args)...);
 	}
 
 	template<typename... Args> void info(fmt::format_string<Args...> fmt, Args &&...args) const noexcept
 	{
-		formatAndLog(LogLevel::Info, fmt, std::forward<Args>(args)...);
+		logAt<LogLevel::Info>(fmt, std::forward<Args>(args)...);
 	}
 
 	template<typename... Args> void warn(fmt::format_string<Args...> fmt, Args &&...args) const noexcept
 	{
-		formatAndLog(LogLevel::Warn, fmt, std::forward<Args>(args)...);
+		logAt<LogLevel::Warn>(fmt, std::forward<Args>(args)...);
 	}
 
 	template<typename... Args> void error(fmt::format_string<Args...> fmt, Args &&...args) const noexcept
 	{
-		formatAndLog(LogLevel::Error, fmt, std::forward<Args>(args)...);
+		logAt<LogLevel::Error>(fmt, std::forward<Args>(args)...);
+	}
+
+	/**
+	 * @brief Discards messages below level before they are formatted. Safe to call from any thread.
+	 */
+	void setMinimumLevel(LogLevel level) noexcept { minimumLevel.store(level, std::memory_order_relaxed); }
+
+	LogLevel getMinimumLevel() const noexcept { return minimumLevel.load(std::memory_order_relaxed); }
+
+	/**
+	 * @brief Tells whether messages of a level are logged at all, e.g. to skip building expensive arguments.
+	 */
+	bool isEnabled(LogLevel level) const noexcept
+	{
+		return level >= compiledMinimumLevel && level >= minimumLevel.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * @brief Logs unless the limiter has let through enough messages for now, and reports how many it held
+	 * back. Usually called through BRIDGE_UTILS_LOG_RATE_LIMITED, for errors that may repeat on every audio
+	 * callback.
+	 */
+	template<typename... Args>
+	void logRateLimited(LogRateLimiter &limiter, LogLevel level, fmt::format_string<Args...> fmt,
+			    Args &&...args) const noexcept
+	{
+		if (!isEnabled(level)) {
+			return;
+		}
+		if (limiter.owner.load(std::memory_order_relaxed) != this) {
+			limiter.ownerLevel.store(static_cast<std::int8_t>(level), std::memory_order_relaxed);
+			limiter.owner.store(this, std::memory_order_relaxed);
+		}
+		const LogRateLimiter::Decision decision = limiter.acquire(LogRateLimiter::Clock::now());
+		if (decision.suppressedBefore > 0) {
+			logSuppressed(level, limiter, decision.suppressedBefore);
+		}
+		if (decision.allowed) {
+			formatAndLog(level, fmt, std::forward<Args>(args)...);
+		} else if (decision.startedSuppressing) {
+			onMessagesSuppressed();
+		}
+	}
+
+	/**
+	 * @brief Logs the summaries of the limiters used with this logger whose interval has ended, which
+	 * logRateLimited would otherwise only do once the call site logs again. Meant to be called from a timer,
+	 * such as ObsLogger's flusher.
+	 * @return Whether any of them still holds back messages whose interval has not ended yet.
+	 */
+	bool reportSuppressed(LogRateLimiter::Clock::time_point now) const noexcept
+	{
+		bool remaining = false;
+		LogRateLimiter::forEach([this, now, &remaining](LogRateLimiter &limiter) {
+			if (limiter.owner.load(std::memory_order_relaxed) != this) {
+				return;
+			}
+			const auto level = static_cast<LogLevel>(limiter.ownerLevel.load(std::memory_order_relaxed));
+			if (!isEnabled(level)) {
+				return;
+			}
+			if (const std::uint64_t count = limiter.takeSuppressed(now)) {
+				logSuppressed(level, limiter, count);
+			} else if (limiter.suppressed.load(std::memory_order_relaxed) > 0) {
+				remaining = true;
+			}
+		});
+		return remaining;
 	}
 
 #ifdef HAVE_BACKWARD
@@ -98,13 +328,35 @@ public:
 #endif // HAVE_BACKWARD
 
 protected:
-	enum class LogLevel : std::int8_t { Debug, Info, Warn, Error };
-
 	virtual void log(LogLevel level, std::string_view message) const noexcept = 0;
 
 	virtual const char *getPrefix() const noexcept = 0;
 
+	/**
+	 * @brief Called when a rate limiter used with this logger starts holding messages back, e.g. to schedule a
+	 * call to reportSuppressed for when its interval ends.
+	 */
+	virtual void onMessagesSuppressed() const noexcept {}
+
 private:
+	void logSuppressed(LogLevel level, const LogRateLimiter &limiter, std::uint64_t count) const noexcept
+	{
+		formatAndLog(level, "Suppressed {} similar messages from {}:{}", count, limiter.file, limiter.line);
+	}
+
+	template<LogLevel level, typename... Args>
+	void logAt(fmt::format_string<Args...> fmt, Args &&...args) const noexcept
+	{
+		if constexpr (level >= compiledMinimumLevel) {
+			if (level >= minimumLevel.load(std::memory_order_relaxed)) {
+				formatAndLog(level, fmt, std::forward<Args>(args)...);
+			}
+		} else {
+			(void)fmt;
+			((void)args, ...);
+		}
+	}
+
 	template<typename... Args>
 	void formatAndLog(LogLevel level, fmt::format_string<Args...> fmt, Args &&...args) const noexcept
 	try {
@@ -118,6 +370,8 @@ private:
 		fprintf(stderr, "[%s] [LOGGER FATAL] An unknown error occurred while formatting log message.\n",
 			getPrefix());
 	}
+
+	std::atomic<LogLevel> minimumLevel{LogLevel::Debug};
 };
 
 } // namespace BridgeUtils
@@ -0,0 +1,121 @@
+/*
+Bridge Utils
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace KaitoTokyo {
+namespace BridgeUtils {
+
+template<typename Signature, std::size_t Capacity = 64> class InplaceFunction;
+
+/**
+ * @brief A move-only std::function replacement that stores the callable inline and never allocates.
+ *
+ * Callables larger than Capacity bytes, over-aligned ones, and ones that may throw on move are rejected at
+ * compile time, so capture large state by pointer or std::shared_ptr instead.
+ */
+template<typename R, typename... Args, std::size_t Capacity> class InplaceFunction<R(Args...), Capacity> {
+public:
+	static constexpr std::size_t capacity = Capacity;
+
+	InplaceFunction() noexcept = default;
+
+	template<typename F, typename Callable = std::decay_t<F>,
+		 typename = std::enable_if_t<!std::is_same_v<Callable, InplaceFunction> &&
+					     std::is_invocable_r_v<R, Callable &, Args...>>>
+	InplaceFunction(F &&callable)
+	{
+		static_assert(sizeof(Callable) <= Capacity, "callable does not fit into InplaceFunction");
+		static_assert(alignof(Callable) <= alignof(std::max_align_t), "callable is over-aligned");
+		static_assert(std::is_nothrow_move_constructible_v<Callable>, "callable must be nothrow movable");
+
+		::new (static_cast<void *>(&storage)) Callable(std::forward<F>(callable));
+		vtable = &vtableFor<Callable>;
+	}
+
+	InplaceFunction(InplaceFunction &&other) noexcept : vtable(other.vtable)
+	{
+		if (vtable) {
+			vtable->move(&storage, &other.storage);
+			other.vtable = nullptr;
+		}
+	}
+
+	InplaceFunction &operator=(InplaceFunction &&other) noexcept
+	{
+		if (this != &other) {
+			reset();
+			if (other.vtable) {
+				other.vtable->move(&storage, &other.storage);
+				vtable = other.vtable;
+				other.vtable = nullptr;
+			}
+		}
+		return *this;
+	}
+
+	InplaceFunction(const InplaceFunction &) = delete;
+	InplaceFunction &operator=(const InplaceFunction &) = delete;
+
+	~InplaceFunction() { reset(); }
+
+	/**
+	 * @brief Destroys the stored callable, if any.
+	 */
+	void reset() noexcept
+	{
+		if (vtable) {
+			vtable->destroy(&storage);
+			vtable = nullptr;
+		}
+	}
+
+	explicit operator bool() const noexcept { return vtable != nullptr; }
+
+	R operator()(Args... args) { return vtable->invoke(&storage, std::forward<Args>(args)...); }
+
+private:
+	struct VTable {
+		R (*invoke)(void *, Args &&...);
+		void (*move)(void *, void *) noexcept;
+		void (*destroy)(void *) noexcept;
+	};
+
+	template<typename Callable>
+	static constexpr VTable vtableFor = {
+		[](void *self, Args &&...args) -> R {
+			return (*static_cast<Callable *>(self))(std::forward<Args>(args)...);
+		},
+		[](void *destination, void *source) noexcept {
+			::new (destination) Callable(std::move(*static_cast<Callable *>(source)));
+			static_cast<Callable *>(source)->~Callable();
+		},
+		[](void *self) noexcept { static_cast<Callable *>(self)->~Callable(); },
+	};
+
+	std::aligned_storage_t<Capacity, alignof(std::max_align_t)> storage;
+	const VTable *vtable = nullptr;
+};
+
+} // namespace BridgeUtils
+} // namespace KaitoTokyo
@@ -0,0 +1,386 @@
+/*
+Bridge Utils
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include "ILogger.hpp"
+#include "InplaceFunction.hpp"
+
+namespace KaitoTokyo {
+namespace BridgeUtils {
+
+/**
+ * @brief A variant of ThrottledTaskQueue whose push neither locks nor allocates.
+ *
+ * Tasks are stored inline in a bounded multi-producer ring (Vyukov's sequence-numbered cells) drained by a single
+ * worker thread. If the ring is full when a task is pushed, the pushing thread cancels and removes the oldest
+ * waiting task, as ThrottledTaskQueue does. A capacity of 1 is rounded up to 2, the smallest ring of this kind.
+ *
+ * The worker only takes the mutex to sleep when the ring is empty, so busy producers never contend on it.
+ */
+class LockFreeThrottledTaskQueue {
+public:
+	/**
+	 * @brief Observes and requests cancellation of one pushed task without owning any shared state.
+	 *
+	 * The token is a ticket into the queue, so it must not outlive the queue. Cancelling a task that has
+	 * already finished is harmless and does not affect later tasks. A task cancelled or dropped stays cancelled.
+	 * Once its cell has taken outcomeHistory more tasks, a finished task is reported as cancelled whatever its
+	 * outcome was, as the queue only keeps that many outcomes per cell.
+	 */
+	class CancellationToken {
+	public:
+		CancellationToken() noexcept = default;
+
+		void cancel() const noexcept
+		{
+			if (queue) {
+				queue->cancel(ticket);
+			}
+		}
+
+		bool isCancelled() const noexcept { return queue && queue->isCancelled(ticket); }
+
+	private:
+		friend class LockFreeThrottledTaskQueue;
+
+		CancellationToken(LockFreeThrottledTaskQueue *_queue, std::size_t _ticket) noexcept
+			: queue(_queue),
+			  ticket(_ticket)
+		{
+		}
+
+		LockFreeThrottledTaskQueue *queue = nullptr;
+		std::size_t ticket = 0;
+	};
+
+	/**
+	 * @brief The type of the tasks. Captures must fit into taskCapacity bytes.
+	 */
+	using CancellableTask = InplaceFunction<void(const CancellationToken &), 64>;
+
+	static constexpr std::size_t taskCapacity = CancellableTask::capacity;
+
+	/**
+	 * @brief How many tasks of each cell, the latest included, remember whether they were cancelled.
+	 */
+	static constexpr std::size_t outcomeHistory = 32;
+
+	/**
+	 * @brief Constructor. Starts the worker thread.
+	 * @param _logger The logger to use for internal messages.
+	 * @param _maxQueueSize The maximum number of waiting tasks. Must be at least 1.
+	 */
+	LockFreeThrottledTaskQueue(const ILogger &_logger, std::size_t _maxQueueSize)
+		: logger(_logger),
+		  cellCount(std::max<std::size_t>(_maxQueueSize, 2)),
+		  cells(std::make_unique<Cell[]>(cellCount))
+	{
+		assert(_maxQueueSize > 0 && "max_size must be greater than 0");
+		for (std::size_t i = 0; i < cellCount; ++i) {
+			cells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+		worker = std::thread(&LockFreeThrottledTaskQueue::workerLoop, this);
+	}
+
+	/**
+	 * @brief Destructor. Stops the queue and waits for the worker thread to finish.
+	 */
+	~LockFreeThrottledTaskQueue()
+	{
+		shutdown();
+		// A push racing with shutdown may have slipped in after the worker drained the ring
+		while (cancelOldest()) {
+		}
+	}
+
+	// Forbid copy and move semantics to keep ownership simple.
+	LockFreeThrottledTaskQueue(const LockFreeThrottledTaskQueue &) = delete;
+	LockFreeThrottledTaskQueue &operator=(const LockFreeThrottledTaskQueue &) = delete;
+	LockFreeThrottledTaskQueue(LockFreeThrottledTaskQueue &&) = delete;
+	LockFreeThrottledTaskQueue &operator=(LockFreeThrottledTaskQueue &&) = delete;
+
+	/**
+	 * @brief Stops the queue, cancels the waiting tasks and waits for the worker thread to finish.
+	 */
+	void shutdown()
+	{
+		if (worker.joinable()) {
+			stopped.store(true, std::memory_order_seq_cst);
+			wakeWorker();
+			worker.join();
+		}
+	}
+
+	/**
+	 * @brief Pushes a cancellable task to the queue. Safe to call from any number of threads.
+	 * @param task A callable taking `const CancellationToken &`, constructed directly in its cell.
+	 * @return A token that can be used to cancel the task externally.
+	 * @throws std::runtime_error if the queue has already been stopped.
+	 */
+	template<typename F> CancellationToken push(F &&task)
+	{
+		if (stopped.load(std::memory_order_acquire)) {
+			throw std::runtime_error("push on stopped LockFreeThrottledTaskQueue");
+		}
+
+		std::size_t position = enqueuePosition.load(std::memory_order_relaxed);
+		Cell *cell;
+		while (true) {
+			cell = &cells[position % cellCount];
+			const std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			const auto difference = static_cast<std::ptrdiff_t>(sequence - position);
+			if (difference == 0) {
+				if (enqueuePosition.compare_exchange_weak(position, position + 1,
+									  std::memory_order_relaxed)) {
+					break;
+				}
+			} else if (difference < 0) {
+				// Full: make room by cancelling the oldest waiting task, then retry
+				cancelOldest();
+				position = enqueuePosition.load(std::memory_order_relaxed);
+			} else {
+				position = enqueuePosition.load(std::memory_order_relaxed);
+			}
+		}
+
+		cell->task = CancellableTask(std::forward<F>(task));
+		startGeneration(*cell, position);
+		cell->sequence.store(position + 1, std::memory_order_release);
+		wakeWorker();
+		return CancellationToken(this, position);
+	}
+
+private:
+	struct alignas(64) Cell {
+		std::atomic<std::size_t> sequence{0};
+		/// The generation of the latest task in the upper half, one cancelled bit per generation in the lower.
+		std::atomic<std::uint64_t> outcomes{0};
+		CancellableTask task;
+	};
+
+	static constexpr std::uint64_t outcomeMask = (std::uint64_t(1) << outcomeHistory) - 1;
+	static_assert(outcomeHistory <= 32, "outcomes holds a 32-bit generation next to the bits");
+
+	std::uint32_t generationOf(std::size_t ticket) const noexcept
+	{
+		return static_cast<std::uint32_t>(ticket / cellCount);
+	}
+
+	static std::uint64_t bitOf(std::uint32_t generation) noexcept
+	{
+		return std::uint64_t(1) << (generation % outcomeHistory);
+	}
+
+	/**
+	 * @brief Makes the cell's outcome bit of a new task free for it. Called by the pusher owning the cell.
+	 */
+	void startGeneration(Cell &cell, std::size_t ticket) noexcept
+	{
+		const std::uint32_t generation = generationOf(ticket);
+		std::uint64_t outcomes = cell.outcomes.load(std::memory_order_relaxed);
+		std::uint64_t next;
+		do {
+			next = (std::uint64_t(generation) << 32) | (outcomes & outcomeMask & ~bitOf(generation));
+		} while (!cell.outcomes.compare_exchange_weak(outcomes, next, std::memory_order_seq_cst));
+	}
+
+	/**
+	 * @brief Tells how many tasks the cell of a ticket has taken since it.
+	 */
+	static std::uint32_t age(std::uint64_t outcomes, std::uint32_t generation) noexcept
+	{
+		return static_cast<std::uint32_t>(outcomes >> 32) - generation;
+	}
+
+	static void raiseTo(std::atomic<std::size_t> &value, std::size_t desired) noexcept
+	{
+		std::size_t current = value.load(std::memory_order_seq_cst);
+		while (current < desired && !value.compare_exchange_weak(current, desired, std::memory_order_seq_cst)) {
+		}
+	}
+
+	/*
+	 * Each task of a cell has its own outcome bit, so cancelling one never affects another sharing the cell. The
+	 * generation in the same word keeps a late cancel from setting the bit once a newer task has taken it over.
+	 * The running task is also tracked separately, so it keeps its outcome however often its cell is reused.
+	 */
+	void cancel(std::size_t ticket) noexcept
+	{
+		Cell &cell = cells[ticket % cellCount];
+		const std::uint32_t generation = generationOf(ticket);
+		std::uint64_t outcomes = cell.outcomes.load(std::memory_order_seq_cst);
+		while (age(outcomes, generation) < outcomeHistory &&
+		       !cell.outcomes.compare_exchange_weak(outcomes, outcomes | bitOf(generation),
+							    std::memory_order_seq_cst)) {
+		}
+		if (runningTicket.load(std::memory_order_seq_cst) == ticket + 1) {
+			raiseTo(runningCancelledTicket, ticket + 1);
+		}
+	}
+
+	bool isCancelled(std::size_t ticket) const noexcept
+	{
+		if (runningTicket.load(std::memory_order_seq_cst) == ticket + 1) {
+			return runningCancelledTicket.load(std::memory_order_seq_cst) == ticket + 1;
+		}
+		const std::uint32_t generation = generationOf(ticket);
+		const std::uint64_t outcomes = cells[ticket % cellCount].outcomes.load(std::memory_order_acquire);
+		return age(outcomes, generation) >= outcomeHistory || (outcomes & bitOf(generation)) != 0;
+	}
+
+	/**
+	 * @brief Claims the oldest waiting task, or returns null if none is ready.
+	 * The cell stays owned by the caller until release() is called.
+	 */
+	Cell *claim(std::size_t &position)
+	{
+		position = dequeuePosition.load(std::memory_order_relaxed);
+		while (true) {
+			Cell *cell = &cells[position % cellCount];
+			const std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			const auto difference = static_cast<std::ptrdiff_t>(sequence - (position + 1));
+			if (difference == 0) {
+				if (dequeuePosition.compare_exchange_weak(position, position + 1,
+									  std::memory_order_relaxed)) {
+					return cell;
+				}
+			} else if (difference < 0) {
+				return nullptr;
+			} else {
+				position = dequeuePosition.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	void release(Cell *cell, std::size_t position)
+	{
+		cell->task.reset();
+		cell->sequence.store(position + cellCount, std::memory_order_release);
+	}
+
+	bool cancelOldest()
+	{
+		std::size_t position;
+		Cell *cell = claim(position);
+		if (!cell) {
+			return false;
+		}
+		cancel(position);
+		release(cell, position);
+		return true;
+	}
+
+	void wakeWorker()
+	{
+		// Pairs with the fence in workerLoop so that either the worker sees the new task or we see it sleeping
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (sleeping.load(std::memory_order_relaxed)) {
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				sleeping.store(false, std::memory_order_relaxed);
+			}
+			cond.notify_one();
+		}
+	}
+
+	bool hasWaitingTask() const
+	{
+		const std::size_t position = dequeuePosition.load(std::memory_order_relaxed);
+		return cells[position % cellCount].sequence.load(std::memory_order_acquire) == position + 1;
+	}
+
+	/**
+	 * @brief The main loop for the worker thread.
+	 */
+	void workerLoop()
+	{
+		while (true) {
+			std::size_t position;
+			if (Cell *cell = claim(position)) {
+				if (stopped.load(std::memory_order_acquire)) {
+					cancel(position);
+					release(cell, position);
+				} else {
+					runTask(cell, position);
+				}
+				continue;
+			}
+
+			if (stopped.load(std::memory_order_acquire)) {
+				break;
+			}
+
+			std::unique_lock<std::mutex> lock(mtx);
+			sleeping.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (hasWaitingTask() || stopped.load(std::memory_order_relaxed)) {
+				sleeping.store(false, std::memory_order_relaxed);
+				continue;
+			}
+			cond.wait(lock, [this] { return !sleeping.load(std::memory_order_relaxed); });
+		}
+	}
+
+	void runTask(Cell *cell, std::size_t position)
+	{
+		// Move the task out so that its cell can take new tasks while it runs
+		CancellableTask task = std::move(cell->task);
+		runningTicket.store(position + 1, std::memory_order_seq_cst);
+		if (cell->outcomes.load(std::memory_order_seq_cst) & bitOf(generationOf(position))) {
+			raiseTo(runningCancelledTicket, position + 1);
+		}
+		release(cell, position);
+
+		try {
+			task(CancellationToken(this, position));
+		} catch (const std::exception &e) {
+			logger.error("LockFreeThrottledTaskQueue: Task threw an exception: {}", e.what());
+		} catch (...) {
+			logger.error("LockFreeThrottledTaskQueue: Task threw an unknown exception.");
+		}
+	}
+
+	const ILogger &logger;
+	const std::size_t cellCount;
+	std::unique_ptr<Cell[]> cells;
+	alignas(64) std::atomic<std::size_t> enqueuePosition{0};
+	alignas(64) std::atomic<std::size_t> dequeuePosition{0};
+	alignas(64) std::atomic<std::size_t> runningTicket{0}; ///< Ticket + 1 of the running task.
+	std::atomic<std::size_t> runningCancelledTicket{0};
+	std::atomic<bool> stopped{false};
+	std::atomic<bool> sleeping{false};
+	std::mutex mtx;
+	std::condition_variable cond;
+	std::thread worker;
+};
+
+} // namespace BridgeUtils
+} // namespace KaitoTokyo
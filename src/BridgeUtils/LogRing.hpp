@@ -0,0 +1,190 @@
+/*
+Bridge Utils
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace KaitoTokyo {
+namespace BridgeUtils {
+
+/**
+ * @brief A bounded, lock-free multi-producer single-consumer ring of byte messages, e.g. formatted log lines.
+ *
+ * A message occupies as many consecutive fixed-size slots as it needs, reserved with a single compare-and-swap
+ * on the write position. Each slot carries a sequence number telling whether it is free, written or read, as in
+ * Vyukov's bounded queue. Writers never wait: when the ring is full, tryWrite fails and the caller drops the
+ * message.
+ */
+class LogRing {
+public:
+	static constexpr std::size_t slotSize = 128;
+
+	/**
+	 * @param capacityBytes The approximate size of the ring. Rounded up to a power of two number of slots.
+	 */
+	explicit LogRing(std::size_t capacityBytes)
+		: slotCount(roundUpToPowerOfTwo(std::max<std::size_t>(capacityBytes / slotSize, 2))),
+		  mask(slotCount - 1),
+		  slots(std::make_unique<Slot[]>(slotCount))
+	{
+		for (std::size_t i = 0; i < slotCount; ++i) {
+			slots[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	// Forbid copy and move semantics to keep ownership simple.
+	LogRing(const LogRing &) = delete;
+	LogRing &operator=(const LogRing &) = delete;
+	LogRing(LogRing &&) = delete;
+	LogRing &operator=(LogRing &&) = delete;
+
+	/**
+	 * @brief Appends a message with a caller-defined tag, such as its log level. Safe to call from any thread.
+	 * @return False if the ring does not have room for it right now.
+	 */
+	bool tryWrite(std::uint8_t tag, std::string_view message) noexcept
+	{
+		const std::size_t count = slotsFor(message.size());
+		if (count > slotCount) {
+			return false;
+		}
+
+		std::size_t position = writePosition.load(std::memory_order_relaxed);
+		while (true) {
+			// Slots are read in order, so if the last slot needed is free, so are the ones before it
+			const std::size_t last = position + count - 1;
+			const std::size_t sequence = slots[last & mask].sequence.load(std::memory_order_acquire);
+			const auto difference = static_cast<std::ptrdiff_t>(sequence - last);
+			if (difference == 0) {
+				if (writePosition.compare_exchange_weak(position, position + count,
+									std::memory_order_relaxed)) {
+					break;
+				}
+			} else if (difference < 0) {
+				return false;
+			} else {
+				position = writePosition.load(std::memory_order_relaxed);
+			}
+		}
+
+		const Header header{static_cast<std::uint32_t>(message.size()), tag};
+		std::memcpy(slots[position & mask].payload, &header, sizeof(header));
+		std::size_t offset = sizeof(header);
+		std::size_t copied = 0;
+		for (std::size_t i = 0; i < count; ++i) {
+			const std::size_t chunk = std::min(payloadSize - offset, message.size() - copied);
+			std::memcpy(slots[(position + i) & mask].payload + offset, message.data() + copied, chunk);
+			copied += chunk;
+			offset = 0;
+		}
+		// The first slot is published last, so the reader usually finds the whole message at once
+		for (std::size_t i = count; i > 0; --i) {
+			slots[(position + i - 1) & mask].sequence.store(position + i, std::memory_order_release);
+		}
+		return true;
+	}
+
+	/**
+	 * @brief Passes every complete message to consumer(tag, message) in order. Must only be called from one
+	 * thread at a time.
+	 *
+	 * Slots are released before the consumer is called, so writers are not held up by a slow consumer.
+	 * @return The number of messages consumed.
+	 */
+	template<typename Consumer> std::size_t drain(Consumer &&consumer)
+	{
+		std::size_t consumed = 0;
+		while (true) {
+			Slot &first = slots[readPosition & mask];
+			if (first.sequence.load(std::memory_order_acquire) != readPosition + 1) {
+				break;
+			}
+			Header header;
+			std::memcpy(&header, first.payload, sizeof(header));
+			const std::size_t count = slotsFor(header.length);
+			for (std::size_t i = 1; i < count; ++i) {
+				const std::size_t position = readPosition + i;
+				if (slots[position & mask].sequence.load(std::memory_order_acquire) != position + 1) {
+					return consumed; // Still being written
+				}
+			}
+
+			scratch.resize(header.length);
+			std::size_t offset = sizeof(header);
+			std::size_t copied = 0;
+			for (std::size_t i = 0; i < count; ++i) {
+				const std::size_t position = readPosition + i;
+				const std::size_t chunk = std::min(payloadSize - offset, scratch.size() - copied);
+				std::memcpy(&scratch[copied], slots[position & mask].payload + offset, chunk);
+				copied += chunk;
+				offset = 0;
+				slots[position & mask].sequence.store(position + slotCount, std::memory_order_release);
+			}
+			readPosition += count;
+
+			consumer(header.tag, std::string_view(scratch));
+			++consumed;
+		}
+		return consumed;
+	}
+
+private:
+	struct Header {
+		std::uint32_t length;
+		std::uint8_t tag;
+	};
+
+	struct Slot {
+		std::atomic<std::size_t> sequence{0};
+		char payload[slotSize - sizeof(std::atomic<std::size_t>)];
+	};
+
+	static constexpr std::size_t payloadSize = sizeof(Slot::payload);
+
+	static std::size_t roundUpToPowerOfTwo(std::size_t value) noexcept
+	{
+		std::size_t result = 1;
+		while (result < value) {
+			result <<= 1;
+		}
+		return result;
+	}
+
+	static std::size_t slotsFor(std::size_t length) noexcept
+	{
+		return (sizeof(Header) + length + payloadSize - 1) / payloadSize;
+	}
+
+	const std::size_t slotCount;
+	const std::size_t mask;
+	std::unique_ptr<Slot[]> slots;
+	alignas(64) std::atomic<std::size_t> writePosition{0};
+	alignas(64) std::size_t readPosition = 0; ///< Only touched by the consumer, as is scratch.
+	std::string scratch;
+};
+
+} // namespace BridgeUtils
+} // namespace KaitoTokyo
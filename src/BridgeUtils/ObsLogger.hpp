@@ -18,26 +18,115 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
 #include <mutex>
 #include <sstream>
 #include <string_view>
+#include <thread>
 
 #include <util/base.h>
 
 #include "ILogger.hpp"
+#include "LogRing.hpp"
 
 namespace KaitoTokyo {
 namespace BridgeUtils {
 
+/**
+ * @brief Logs to the OBS log with blog.
+ *
+ * In asynchronous mode, log only copies the formatted message into a lock-free ring, and a background thread
+ * passes the messages to blog in batches, so that callers on the audio path never wait for OBS's log file I/O.
+ * The thread sleeps until a message arrives in an empty ring; only waking it takes a lock.
+ * When the ring is full, messages are dropped and counted instead, and the count is logged later on. The thread
+ * also reports the messages held back by rate limiters once their interval has ended.
+ */
 class ObsLogger final : public ILogger {
 public:
-	ObsLogger(const char *_prefix) : prefix(_prefix) {}
-	~ObsLogger() noexcept override = default;
+	/**
+	 * @param _prefix Prepended to every message.
+	 * @param asyncCapacityBytes The size of the ring in asynchronous mode, or 0 to call blog synchronously.
+	 */
+	explicit ObsLogger(const char *_prefix, std::size_t asyncCapacityBytes = 0) : prefix(_prefix)
+	{
+		if (asyncCapacityBytes > 0) {
+			ring = std::make_unique<LogRing>(asyncCapacityBytes);
+			flusher = std::thread(&ObsLogger::flushLoop, this);
+			asynchronous.store(true, std::memory_order_release);
+		}
+	}
+
+	~ObsLogger() noexcept override { shutdown(); }
+
+	/**
+	 * @brief Flushes the ring and stops the background thread. Later messages are logged synchronously.
+	 *
+	 * Call this before the module is unloaded, as joining a thread from a static destructor may deadlock.
+	 */
+	void shutdown() noexcept
+	{
+		if (!flusher.joinable()) {
+			return;
+		}
+		asynchronous.store(false, std::memory_order_relaxed);
+		// Pairs with the fence in requestFlush: a writer that still saw asynchronous set drains the ring itself
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		{
+			std::lock_guard<std::mutex> lock(flushMutex);
+			stopping = true;
+		}
+		flushCond.notify_one();
+		flusher.join();
+		flush(); // Messages written while the thread was finishing
+	}
+
+	/**
+	 * @brief The number of messages dropped because the ring was full.
+	 */
+	std::uint64_t droppedCount() const noexcept { return dropped.load(std::memory_order_relaxed); }
 
 protected:
 	static constexpr size_t MAX_LOG_CHUNK_SIZE = 4000;
+	/// How often the thread looks for ended rate limiter intervals while some are holding messages back.
+	static constexpr std::chrono::milliseconds summaryCheckInterval{250};
 
 	void log(LogLevel level, std::string_view message) const noexcept override
+	{
+		if (asynchronous.load(std::memory_order_acquire)) {
+			if (!ring->tryWrite(static_cast<std::uint8_t>(level), message)) {
+				dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			requestFlush();
+			if (!asynchronous.load(std::memory_order_relaxed)) {
+				flush(); // shutdown may have drained the ring for the last time before this message
+			}
+			return;
+		}
+		std::lock_guard<std::mutex> lock(mtx);
+		write(level, message);
+	}
+
+protected:
+	const char *getPrefix() const noexcept override { return prefix; }
+
+	void onMessagesSuppressed() const noexcept override
+	{
+		if (asynchronous.load(std::memory_order_acquire)) {
+			summariesPending.store(true, std::memory_order_relaxed);
+			requestFlush();
+		}
+	}
+
+private:
+	/**
+	 * @brief Passes a message to blog, split into chunks that blog accepts.
+	 */
+	static void write(LogLevel level, std::string_view message) noexcept
 	{
 		int blogLevel;
 		switch (level) {
@@ -54,12 +143,10 @@ protected:
 			blogLevel = LOG_ERROR;
 			break;
 		default:
-			std::lock_guard<std::mutex> lock(mtx);
 			blog(LOG_ERROR, "[LOGGER FATAL] Unknown log level: %d\n", static_cast<int>(level));
 			return;
 		}
 
-		std::lock_guard<std::mutex> lock(mtx);
 		if (message.length() <= MAX_LOG_CHUNK_SIZE) {
 			blog(blogLevel, "%.*s", static_cast<int>(message.length()), message.data());
 		} else {
@@ -70,12 +157,80 @@ protected:
 		}
 	}
 
-protected:
-	const char *getPrefix() const noexcept override { return prefix; }
+	/**
+	 * @brief Wakes the thread unless it has work pending already. Called after the work has been published.
+	 */
+	void requestFlush() const noexcept
+	{
+		// Pairs with the fence in flushLoop: either the thread sees the work, or this sees pending cleared
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (pending.load(std::memory_order_relaxed) || pending.exchange(true, std::memory_order_relaxed)) {
+			return;
+		}
+		{
+			// The thread checks pending with flushMutex held, so it cannot miss the notification
+			std::lock_guard<std::mutex> lock(flushMutex);
+		}
+		flushCond.notify_one();
+	}
+
+	void flushLoop() noexcept
+	{
+		bool done = false;
+		while (!done) {
+			{
+				std::unique_lock<std::mutex> lock(flushMutex);
+				const auto woken = [this] {
+					return stopping || pending.load(std::memory_order_relaxed);
+				};
+				if (summariesPending.load(std::memory_order_relaxed)) {
+					flushCond.wait_for(lock, summaryCheckInterval, woken);
+				} else {
+					flushCond.wait(lock, woken);
+				}
+				done = stopping;
+			}
+			pending.store(false, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (summariesPending.exchange(false, std::memory_order_relaxed) &&
+			    reportSuppressed(LogRateLimiter::Clock::now())) {
+				summariesPending.store(true, std::memory_order_relaxed);
+			}
+			flush();
+		}
+	}
+
+	/**
+	 * @brief Passes the messages in the ring to blog, followed by the number of messages dropped since the
+	 * last flush, if any.
+	 */
+	void flush() const noexcept
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		ring->drain([](std::uint8_t level, std::string_view message) {
+			write(static_cast<LogLevel>(level), message);
+		});
+		const std::uint64_t drops = dropped.load(std::memory_order_relaxed);
+		if (drops != reportedDrops) {
+			blog(LOG_WARNING, "%s%llu log messages were dropped because the log ring was full", prefix,
+			     static_cast<unsigned long long>(drops - reportedDrops));
+			reportedDrops = drops;
+		}
+	}
 
-private:
 	const char *prefix;
-	mutable std::mutex mtx;
+	mutable std::mutex mtx; ///< Keeps the chunks of one message together in the OBS log.
+
+	std::unique_ptr<LogRing> ring;
+	std::atomic<bool> asynchronous{false};
+	mutable std::atomic<std::uint64_t> dropped{0};
+	mutable std::uint64_t reportedDrops = 0; ///< Guarded by mtx.
+	mutable std::atomic<bool> pending{false};          ///< Messages arrived since the thread last woke up.
+	mutable std::atomic<bool> summariesPending{false}; ///< Rate limiters are holding messages back.
+	mutable std::mutex flushMutex;
+	mutable std::condition_variable flushCond;
+	bool stopping = false; ///< Guarded by flushMutex.
+	std::thread flusher;
 };
 
 } // namespace BridgeUtils
@@ -0,0 +1,193 @@
+/*
+Bridge Utils
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace KaitoTokyo {
+namespace BridgeUtils {
+
+/**
+ * @brief Counts of a Log2Histogram at one point in time.
+ */
+struct Log2HistogramSnapshot {
+	static constexpr std::size_t bucketCount = 32;
+
+	/// Bucket 0 counts zeros, bucket i counts values in [2^(i-1), 2^i). The last bucket also takes larger ones.
+	std::array<std::uint64_t, bucketCount> counts{};
+
+	std::uint64_t total() const noexcept
+	{
+		std::uint64_t sum = 0;
+		for (std::uint64_t count : counts) {
+			sum += count;
+		}
+		return sum;
+	}
+
+	/**
+	 * @brief Returns an upper bound of the given quantile, e.g. 0.99, or 0 if nothing was recorded.
+	 */
+	std::uint64_t percentile(double quantile) const noexcept
+	{
+		const std::uint64_t count = total();
+		if (count == 0) {
+			return 0;
+		}
+		const auto rank = static_cast<std::uint64_t>(quantile * static_cast<double>(count - 1)) + 1;
+		std::uint64_t seen = 0;
+		for (std::size_t i = 0; i < bucketCount; ++i) {
+			seen += counts[i];
+			if (seen >= rank) {
+				return i == 0 ? 0 : (std::uint64_t{1} << i) - 1;
+			}
+		}
+		return (std::uint64_t{1} << (bucketCount - 1)) - 1;
+	}
+};
+
+/**
+ * @brief A histogram with power-of-two buckets that any thread may record into and read without locking.
+ */
+class Log2Histogram {
+public:
+	void record(std::uint64_t value) noexcept
+	{
+		std::size_t bucket = 0;
+		while (value != 0 && bucket < Log2HistogramSnapshot::bucketCount - 1) {
+			value >>= 1;
+			++bucket;
+		}
+		buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+	}
+
+	Log2HistogramSnapshot snapshot() const noexcept
+	{
+		Log2HistogramSnapshot result;
+		for (std::size_t i = 0; i < Log2HistogramSnapshot::bucketCount; ++i) {
+			result.counts[i] = buckets[i].load(std::memory_order_relaxed);
+		}
+		return result;
+	}
+
+private:
+	std::array<std::atomic<std::uint64_t>, Log2HistogramSnapshot::bucketCount> buckets{};
+};
+
+/**
+ * @brief Counters of a task queue at one point in time.
+ */
+struct QueueStatsSnapshot {
+	std::uint64_t pushed = 0;
+	std::uint64_t started = 0;
+	std::uint64_t dropped = 0;   ///< Cancelled and removed because the queue was full.
+	std::uint64_t coalesced = 0; ///< Cancelled and replaced by a task with the same key.
+	std::uint64_t cancelled = 0; ///< Cancelled through its token while waiting, or when the queue stopped.
+	std::uint64_t expired = 0;   ///< Skipped because the deadline had passed before the task could start.
+	std::uint64_t failed = 0;    ///< Threw an exception.
+	std::size_t depth = 0;
+	std::size_t highWaterMark = 0;
+	Log2HistogramSnapshot waitMicroseconds; ///< From push to start.
+	Log2HistogramSnapshot runMicroseconds;
+};
+
+/**
+ * @brief Low-overhead instrumentation of a task queue, written by the queue and readable from any thread.
+ *
+ * All counters are relaxed atomics, so a snapshot is not a consistent cut, only a close approximation.
+ */
+class QueueStats {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	void onPush(std::size_t depthAfterPush) noexcept
+	{
+		pushed.fetch_add(1, std::memory_order_relaxed);
+		setDepth(depthAfterPush);
+	}
+
+	void onDrop() noexcept { dropped.fetch_add(1, std::memory_order_relaxed); }
+	void onCoalesce() noexcept { coalesced.fetch_add(1, std::memory_order_relaxed); }
+	void onCancel() noexcept { cancelled.fetch_add(1, std::memory_order_relaxed); }
+	void onExpire() noexcept { expired.fetch_add(1, std::memory_order_relaxed); }
+	void onFailure() noexcept { failed.fetch_add(1, std::memory_order_relaxed); }
+
+	void onStart(Clock::time_point pushedAt, Clock::time_point startedAt) noexcept
+	{
+		started.fetch_add(1, std::memory_order_relaxed);
+		waitMicroseconds.record(microseconds(startedAt - pushedAt));
+	}
+
+	void onFinish(Clock::time_point startedAt, Clock::time_point finishedAt) noexcept
+	{
+		runMicroseconds.record(microseconds(finishedAt - startedAt));
+	}
+
+	void setDepth(std::size_t newDepth) noexcept
+	{
+		depth.store(newDepth, std::memory_order_relaxed);
+		std::size_t high = highWaterMark.load(std::memory_order_relaxed);
+		while (newDepth > high &&
+		       !highWaterMark.compare_exchange_weak(high, newDepth, std::memory_order_relaxed)) {
+		}
+	}
+
+	QueueStatsSnapshot snapshot() const noexcept
+	{
+		QueueStatsSnapshot result;
+		result.pushed = pushed.load(std::memory_order_relaxed);
+		result.started = started.load(std::memory_order_relaxed);
+		result.dropped = dropped.load(std::memory_order_relaxed);
+		result.coalesced = coalesced.load(std::memory_order_relaxed);
+		result.cancelled = cancelled.load(std::memory_order_relaxed);
+		result.expired = expired.load(std::memory_order_relaxed);
+		result.failed = failed.load(std::memory_order_relaxed);
+		result.depth = depth.load(std::memory_order_relaxed);
+		result.highWaterMark = highWaterMark.load(std::memory_order_relaxed);
+		result.waitMicroseconds = waitMicroseconds.snapshot();
+		result.runMicroseconds = runMicroseconds.snapshot();
+		return result;
+	}
+
+private:
+	static std::uint64_t microseconds(Clock::duration duration) noexcept
+	{
+		const auto count = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+		return count > 0 ? static_cast<std::uint64_t>(count) : 0;
+	}
+
+	std::atomic<std::uint64_t> pushed{0};
+	std::atomic<std::uint64_t> started{0};
+	std::atomic<std::uint64_t> dropped{0};
+	std::atomic<std::uint64_t> coalesced{0};
+	std::atomic<std::uint64_t> cancelled{0};
+	std::atomic<std::uint64_t> expired{0};
+	std::atomic<std::uint64_t> failed{0};
+	std::atomic<std::size_t> depth{0};
+	std::atomic<std::size_t> highWaterMark{0};
+	Log2Histogram waitMicroseconds;
+	Log2Histogram runMicroseconds;
+};
+
+} // namespace BridgeUtils
+} // namespace KaitoTokyo
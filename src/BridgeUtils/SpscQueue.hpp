@@ -0,0 +1,106 @@
+/*
+Bridge Utils
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <utility>
+
+namespace KaitoTokyo {
+namespace BridgeUtils {
+
+/**
+ * @brief A bounded, lock-free single-producer single-consumer queue.
+ *
+ * Exactly one thread may call tryPush and exactly one (possibly different) thread may call tryPop.
+ * Neither side ever blocks, so the queue is safe to drain from real-time threads such as the audio path.
+ */
+template<typename T> class SpscQueue {
+public:
+	/**
+	 * @brief Constructor.
+	 * @param _capacity The maximum number of elements the queue can hold. Must be at least 1.
+	 */
+	explicit SpscQueue(std::size_t _capacity)
+		: capacity(_capacity + 1),
+		  slots(std::make_unique<std::optional<T>[]>(_capacity + 1))
+	{
+		assert(_capacity > 0 && "capacity must be greater than 0");
+	}
+
+	// Forbid copy and move semantics to keep ownership simple.
+	SpscQueue(const SpscQueue &) = delete;
+	SpscQueue &operator=(const SpscQueue &) = delete;
+	SpscQueue(SpscQueue &&) = delete;
+	SpscQueue &operator=(SpscQueue &&) = delete;
+
+	/**
+	 * @brief Pushes an element. Must only be called from the producer thread.
+	 * @return False if the queue is full. The element is left untouched in that case.
+	 */
+	bool tryPush(T &&value)
+	{
+		const std::size_t currentTail = tail.load(std::memory_order_relaxed);
+		const std::size_t nextTail = increment(currentTail);
+		if (nextTail == head.load(std::memory_order_acquire)) {
+			return false;
+		}
+		slots[currentTail].emplace(std::move(value));
+		tail.store(nextTail, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * @brief Pops an element. Must only be called from the consumer thread.
+	 * @return The oldest element, or std::nullopt if the queue is empty.
+	 */
+	std::optional<T> tryPop()
+	{
+		const std::size_t currentHead = head.load(std::memory_order_relaxed);
+		if (currentHead == tail.load(std::memory_order_acquire)) {
+			return std::nullopt;
+		}
+		std::optional<T> value = std::move(slots[currentHead]);
+		slots[currentHead].reset();
+		head.store(increment(currentHead), std::memory_order_release);
+		return value;
+	}
+
+	/**
+	 * @brief Checks whether the queue is empty. The result is only a hint when called concurrently.
+	 */
+	bool empty() const
+	{
+		return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+	}
+
+private:
+	std::size_t increment(std::size_t index) const noexcept { return index + 1 == capacity ? 0 : index + 1; }
+
+	const std::size_t capacity;
+	std::unique_ptr<std::optional<T>[]> slots;
+	alignas(64) std::atomic<std::size_t> head{0};
+	alignas(64) std::atomic<std::size_t> tail{0};
+};
+
+} // namespace BridgeUtils
+} // namespace KaitoTokyo
@@ -0,0 +1,370 @@
+/*
+Bridge Utils
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "CancellationToken.hpp"
+
+namespace KaitoTokyo {
+namespace BridgeUtils {
+
+/**
+ * @brief Thrown when awaited or chained work was cancelled. A task may also throw it to report cancellation.
+ */
+class OperationCancelled : public std::runtime_error {
+public:
+	OperationCancelled() : std::runtime_error("operation cancelled") {}
+};
+
+enum class FutureStatus {
+	Pending,
+	Fulfilled,
+	Failed,    ///< The task threw an exception.
+	Cancelled, ///< The task was cancelled, or discarded without running.
+};
+
+template<typename T> class TaskFuture;
+template<typename T> class TaskPromise;
+
+namespace Detail {
+
+/**
+ * @brief The state shared by a TaskPromise and its TaskFuture, in a single allocation without any mutex.
+ *
+ * The producer publishes the result and the consumer the continuation, each by setting a flag. Whoever sets
+ * the second flag runs the continuation, so it runs exactly once and never waits.
+ */
+template<typename T> class FutureState {
+public:
+	using Storage = std::conditional_t<std::is_void_v<T>, bool, T>;
+
+	void addRef() noexcept { refs.fetch_add(1, std::memory_order_relaxed); }
+
+	void release() noexcept
+	{
+		if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			delete this;
+		}
+	}
+
+	void addPromise() noexcept { promises.fetch_add(1, std::memory_order_relaxed); }
+
+	/**
+	 * @brief Drops one promise handle. When the last one goes without a result, the future is cancelled.
+	 */
+	void releasePromise() noexcept
+	{
+		if (promises.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			cancel();
+		}
+	}
+
+	template<typename... Args> bool fulfill(Args &&...args)
+	{
+		if (claimed.exchange(true, std::memory_order_acq_rel)) {
+			return false;
+		}
+		value.emplace(std::forward<Args>(args)...);
+		publish(FutureStatus::Fulfilled);
+		return true;
+	}
+
+	bool fail(std::exception_ptr exception) noexcept
+	{
+		if (claimed.exchange(true, std::memory_order_acq_rel)) {
+			return false;
+		}
+		error = std::move(exception);
+		publish(FutureStatus::Failed);
+		return true;
+	}
+
+	bool cancel() noexcept
+	{
+		if (claimed.exchange(true, std::memory_order_acq_rel)) {
+			return false;
+		}
+		publish(FutureStatus::Cancelled);
+		return true;
+	}
+
+	FutureStatus status() const noexcept
+	{
+		return (flags.load(std::memory_order_acquire) & ready) ? result : FutureStatus::Pending;
+	}
+
+	void setContinuation(std::function<void()> newContinuation)
+	{
+		continuation = std::move(newContinuation);
+		if (flags.fetch_or(continuationSet, std::memory_order_acq_rel) & ready) {
+			runContinuation();
+		}
+	}
+
+	std::optional<Storage> value;
+	std::exception_ptr error;
+
+private:
+	static constexpr unsigned ready = 1;
+	static constexpr unsigned continuationSet = 2;
+
+	void publish(FutureStatus status) noexcept
+	{
+		result = status;
+		if (flags.fetch_or(ready, std::memory_order_acq_rel) & continuationSet) {
+			runContinuation();
+		}
+	}
+
+	void runContinuation() noexcept
+	{
+		std::function<void()> run = std::move(continuation);
+		continuation = nullptr;
+		run();
+	}
+
+	std::atomic<std::size_t> refs{1};
+	std::atomic<std::size_t> promises{0};
+	std::atomic<bool> claimed{false};
+	std::atomic<unsigned> flags{0};
+	FutureStatus result = FutureStatus::Pending;
+	std::function<void()> continuation;
+};
+
+/**
+ * @brief A copyable owning reference to a FutureState.
+ */
+template<typename T> class StateRef {
+public:
+	explicit StateRef(FutureState<T> *_state) noexcept : state(_state) { state->addRef(); }
+	StateRef(const StateRef &other) noexcept : StateRef(other.state) {}
+	StateRef &operator=(const StateRef &) = delete;
+	~StateRef() { state->release(); }
+
+	FutureState<T> *operator->() const noexcept { return state; }
+
+private:
+	FutureState<T> *const state;
+};
+
+template<typename T, typename F> struct ContinuationResult {
+	using type = std::invoke_result_t<F, T &>;
+};
+
+template<typename F> struct ContinuationResult<void, F> {
+	using type = std::invoke_result_t<F>;
+};
+
+/**
+ * @brief Runs fn with the task's token and completes the promise with its outcome.
+ */
+template<typename T, typename F, typename Token> void completeWith(TaskPromise<T> &promise, F &fn, const Token &token)
+{
+	if (token.isCancelled()) {
+		promise.cancel();
+		return;
+	}
+	try {
+		if constexpr (std::is_void_v<T>) {
+			fn(token);
+			promise.setValue();
+		} else {
+			promise.setValue(fn(token));
+		}
+	} catch (const OperationCancelled &) {
+		promise.cancel();
+	} catch (...) {
+		promise.setException(std::current_exception());
+	}
+}
+
+} // namespace Detail
+
+/**
+ * @brief The producing side of a TaskFuture. Copyable, so that it can be captured in a std::function task.
+ *
+ * When the last copy is destroyed without a result, e.g. because the task carrying it was dropped from a full
+ * queue, the future completes as cancelled.
+ */
+template<typename T> class TaskPromise {
+public:
+	TaskPromise() : state(new Detail::FutureState<T>()) { state->addPromise(); }
+
+	TaskPromise(const TaskPromise &other) noexcept : state(other.state)
+	{
+		state->addRef();
+		state->addPromise();
+	}
+
+	TaskPromise &operator=(const TaskPromise &other) noexcept
+	{
+		TaskPromise copy(other);
+		std::swap(state, copy.state);
+		return *this;
+	}
+
+	~TaskPromise()
+	{
+		state->releasePromise();
+		state->release();
+	}
+
+	TaskFuture<T> getFuture() const noexcept { return TaskFuture<T>(state); }
+
+	/**
+	 * @brief Completes the future with a value. Returns false if it was already completed.
+	 */
+	template<typename... Args> bool setValue(Args &&...args) { return state->fulfill(std::forward<Args>(args)...); }
+
+	bool setException(std::exception_ptr exception) noexcept { return state->fail(std::move(exception)); }
+
+	bool cancel() noexcept { return state->cancel(); }
+
+private:
+	Detail::FutureState<T> *state;
+};
+
+/**
+ * @brief The result of a task that completes later, e.g. from ThrottledTaskQueue::submit.
+ *
+ * Unlike std::future, it has no mutex or condition variable and cannot be waited on; instead, then() chains a
+ * continuation that runs on an executor once the result is there. An executor is anything with
+ * `push(std::function<void(const CancellationToken &)>)`, such as ThrottledTaskQueue, WorkStealingTaskPool or
+ * InlineExecutor.
+ */
+template<typename T> class TaskFuture {
+public:
+	TaskFuture(TaskFuture &&other) noexcept : state(std::exchange(other.state, nullptr)) {}
+
+	TaskFuture &operator=(TaskFuture &&other) noexcept
+	{
+		std::swap(state, other.state);
+		return *this;
+	}
+
+	~TaskFuture()
+	{
+		if (state) {
+			state->release();
+		}
+	}
+
+	TaskFuture(const TaskFuture &) = delete;
+	TaskFuture &operator=(const TaskFuture &) = delete;
+
+	FutureStatus status() const noexcept { return state->status(); }
+
+	bool isReady() const noexcept { return status() != FutureStatus::Pending; }
+
+	/**
+	 * @brief Returns the value of a completed future.
+	 * @throws The task's exception if it failed, or OperationCancelled if it was cancelled.
+	 */
+	std::add_lvalue_reference_t<T> get()
+	{
+		switch (status()) {
+		case FutureStatus::Pending:
+			throw std::logic_error("TaskFuture::get called before completion");
+		case FutureStatus::Failed:
+			std::rethrow_exception(state->error);
+		case FutureStatus::Cancelled:
+			throw OperationCancelled();
+		case FutureStatus::Fulfilled:
+			break;
+		}
+		if constexpr (!std::is_void_v<T>) {
+			return *state->value;
+		}
+	}
+
+	/**
+	 * @brief Runs fn on the executor with the value once this future is fulfilled. Can be called only once.
+	 *
+	 * If this future fails or is cancelled, fn is skipped and the returned future completes the same way. The
+	 * returned future is also cancelled if the continuation's own task is cancelled or discarded.
+	 * @return A future of fn's result.
+	 */
+	template<typename Executor, typename F> auto then(Executor &executor, F fn)
+	{
+		using Result = typename Detail::ContinuationResult<T, F>::type;
+		TaskPromise<Result> next;
+		TaskFuture<Result> nextFuture = next.getFuture();
+
+		// The continuation is stored in the state it refers to; running it breaks the cycle.
+		state->setContinuation([&executor, antecedent = Detail::StateRef<T>(state), next,
+					fn = std::move(fn)]() mutable {
+			switch (antecedent->status()) {
+			case FutureStatus::Failed:
+				next.setException(antecedent->error);
+				return;
+			case FutureStatus::Cancelled:
+				next.cancel();
+				return;
+			default:
+				break;
+			}
+			try {
+				executor.push([antecedent, next, fn](const auto &token) mutable {
+					auto call = [&](const auto &) -> decltype(auto) {
+						if constexpr (std::is_void_v<T>) {
+							return fn();
+						} else {
+							return fn(*antecedent->value);
+						}
+					};
+					Detail::completeWith(next, call, token);
+				});
+			} catch (...) {
+				next.setException(std::current_exception());
+			}
+		});
+		return nextFuture;
+	}
+
+private:
+	template<typename> friend class TaskPromise;
+
+	explicit TaskFuture(Detail::FutureState<T> *_state) noexcept : state(_state) { state->addRef(); }
+
+	Detail::FutureState<T> *state;
+};
+
+/**
+ * @brief An executor that runs tasks immediately on the calling thread.
+ */
+struct InlineExecutor {
+	CancellationToken push(std::function<void(const CancellationToken &)> task)
+	{
+		const CancellationToken token = CancellationSource().token();
+		task(token);
+		return token;
+	}
+};
+
+} // namespace BridgeUtils
+} // namespace KaitoTokyo
@@ -18,19 +18,27 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 
 #pragma once
 
+#include <array>
 #include <atomic>
 #include <cassert>
 #include <condition_variable>
 #include <functional>
+#include <iterator>
+#include <list>
 #include <memory>
 #include <mutex>
-#include <optional>
-#include <queue>
 #include <stdexcept>
+#include <string>
 #include <thread>
+#include <type_traits>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
+#include "CancellationToken.hpp"
 #include "ILogger.hpp"
+#include "QueueStats.hpp"
+#include "TaskFuture.hpp"
 
 namespace KaitoTokyo {
 namespace BridgeUtils {
@@ -40,15 +48,35 @@ namespace BridgeUtils {
  *
  * This class manages a single internal worker thread in an RAII style.
  * The thread is started upon object construction and safely joined upon destruction.
- * If the queue is full when a new task is pushed, the oldest task is cancelled and removed.
+ *
+ * Tasks wait in one lane per Priority, each with its own capacity. If a lane is full when a new task is pushed,
+ * the oldest task of that lane is cancelled and removed, so background work never evicts interactive work.
+ * The worker picks the next lane either strictly by priority or by weighted round robin.
+ *
+ * A task pushed with a coalesce key replaces the pending task with the same key, if any, which is cancelled.
+ * The replacement keeps the pending task's place in line when both have the same priority.
+ *
+ * A task may carry a deadline. If it has passed by the time the task would start, the task is skipped without
+ * being invoked and its token is cancelled, so an overloaded queue sheds stale work instead of running it late.
+ * A task whose token was cancelled while it waited is skipped likewise.
+ *
+ * Producers of many small tasks can push them with pushBatch, and the worker can take up to maxBatchSize tasks
+ * per wakeup, so that one lock and one notification are paid per batch instead of per task. Tasks taken in a
+ * batch can no longer be dropped or coalesced, and a task of a higher priority pushed meanwhile waits for the
+ * batch to finish. Deadlines are checked just before each task starts.
+ *
+ * Depth, wait and run times, and drop counts are recorded in QueueStats, readable from any thread via stats().
+ *
+ * Tasks that are discarded without running are cancelled and destroyed after the queue's lock is released, so
+ * cancellation callbacks and the destructors of their captures may safely push to the queue again.
  */
 class ThrottledTaskQueue {
 public:
 	/**
      * @brief A cancellation token used to safely share the cancellation state.
-     * When set to true, it indicates that the task should be cancelled.
+     * Once cancelled, it indicates that the task should be cancelled.
      */
-	using CancellationToken = std::shared_ptr<std::atomic<bool>>;
+	using CancellationToken = BridgeUtils::CancellationToken;
 
 	/**
      * @brief The type of the function that can be added to the queue as a task.
@@ -56,29 +84,129 @@ public:
      */
 	using CancellableTask = std::function<void(const CancellationToken &)>;
 
+	/**
+	 * @brief Priority classes, from the most to the least latency-critical.
+	 */
+	enum class Priority : std::size_t {
+		Interactive, ///< E.g. publishing a final result.
+		Normal,
+		Background, ///< E.g. exports and other bulk work.
+	};
+	static constexpr std::size_t priorityCount = 3;
+
+	/**
+	 * @brief How the worker chooses between non-empty lanes.
+	 */
+	enum class Scheduling {
+		Strict,   ///< Always the highest priority lane first.
+		Weighted, ///< Smooth weighted round robin, so that lower lanes are never starved.
+	};
+
+	struct LaneConfig {
+		std::size_t capacity;    ///< The maximum number of waiting tasks. Must be at least 1.
+		unsigned int weight = 1; ///< Share of turns under Scheduling::Weighted. Must be at least 1.
+	};
+
+	/**
+	 * @brief Per-push settings.
+	 */
+	struct PushOptions {
+		Priority priority = Priority::Normal;
+
+		/**
+		 * @brief Identifies redundant work, e.g. "partial:<source>". Empty to never coalesce.
+		 */
+		std::string coalesceKey;
+
+		/**
+		 * @brief The latest time the task is still worth starting. No deadline by default.
+		 */
+		QueueStats::Clock::time_point deadline = QueueStats::Clock::time_point::max();
+	};
+
 private:
-	using QueuedTask = std::pair<std::function<void()>, CancellationToken>;
+	struct QueuedTask {
+		std::function<void()> run;
+		CancellationToken token;
+		std::string coalesceKey;
+		QueueStats::Clock::time_point pushedAt;
+		QueueStats::Clock::time_point deadline;
+	};
+
+	/**
+	 * @brief Tasks removed without running. Declared before the lock, so that they are cancelled and destroyed
+	 * after it is released.
+	 */
+	class DiscardedTasks {
+	public:
+		void add(std::function<void()> run, CancellationToken token)
+		{
+			tasks.emplace_back(std::move(run), std::move(token));
+		}
+
+		~DiscardedTasks()
+		{
+			for (auto &task : tasks) {
+				task.second.cancel();
+			}
+		}
+
+	private:
+		std::vector<std::pair<std::function<void()>, CancellationToken>> tasks;
+	};
+
+	struct Lane {
+		LaneConfig config;
+		std::list<QueuedTask> queue; ///< A list so that coalescing can remove tasks from the middle.
+		long long credit = 0;        ///< Current weight of the smooth weighted round robin.
+	};
+
+	using QueuedTaskRef = std::pair<Lane *, std::list<QueuedTask>::iterator>;
 
 	const ILogger &logger;
-	const std::size_t maxQueueSize;
-	std::thread worker;
+	const Scheduling scheduling;
 	std::mutex mtx;
 	std::condition_variable cond;
-	std::queue<QueuedTask> queue;
-	bool stopped = false;
+	std::array<Lane, priorityCount> lanes;
+	std::unordered_map<std::string, QueuedTaskRef> pendingByKey;
+	std::size_t waitingCount = 0;
+	QueueStats queueStats;
+	std::atomic<bool> stopped{false}; ///< Written with the mutex held.
+	const std::size_t maxBatchSize;
+	std::thread worker;
 
 public:
 	/**
      * @brief Constructor. Starts the worker thread.
      * @param _logger The logger to use for internal messages.
-     * @param max_size The maximum number of tasks the queue can hold. Must be at least 1.
+     * @param max_size The maximum number of tasks each lane can hold. Must be at least 1.
      */
 	ThrottledTaskQueue(const ILogger &_logger, std::size_t _maxQueueSize)
+		: ThrottledTaskQueue(_logger,
+				     {LaneConfig{_maxQueueSize}, LaneConfig{_maxQueueSize}, LaneConfig{_maxQueueSize}})
+	{
+	}
+
+	/**
+     * @brief Constructor with per-lane settings. Starts the worker thread.
+     * @param _logger The logger to use for internal messages.
+     * @param laneConfigs Capacity and weight of each lane, indexed by Priority.
+     * @param _scheduling How the worker chooses between lanes.
+     * @param _maxBatchSize The most tasks the worker takes per lock and wakeup. Must be at least 1.
+     */
+	ThrottledTaskQueue(const ILogger &_logger, const std::array<LaneConfig, priorityCount> &laneConfigs,
+			   Scheduling _scheduling = Scheduling::Strict, std::size_t _maxBatchSize = 1)
 		: logger(_logger),
-		  maxQueueSize(_maxQueueSize),
-		  worker(&ThrottledTaskQueue::workerLoop, this)
+		  scheduling(_scheduling),
+		  maxBatchSize(_maxBatchSize)
 	{
-		assert(_maxQueueSize > 0 && "max_size must be greater than 0");
+		assert(maxBatchSize > 0 && "maxBatchSize must be greater than 0");
+		for (std::size_t i = 0; i < priorityCount; ++i) {
+			assert(laneConfigs[i].capacity > 0 && "max_size must be greater than 0");
+			assert(laneConfigs[i].weight > 0 && "weight must be greater than 0");
+			lanes[i].config = laneConfigs[i];
+		}
+		worker = std::thread(&ThrottledTaskQueue::workerLoop, this);
 	}
 
 	/**
@@ -103,33 +231,112 @@ public:
 		}
 	}
 
+	/**
+     * @brief Pushes a cancellable task with the default options, i.e. Priority::Normal.
+     */
+	CancellationToken push(CancellableTask user_task) { return push(std::move(user_task), PushOptions()); }
+
 	/**
      * @brief Pushes a cancellable task to the queue.
      * @param user_task The task to be executed. It receives a cancellation token as an argument.
+     * @param options The priority lane and other settings of the task.
      * @return A token that can be used to cancel the task externally.
      * @throws std::runtime_error if the queue has already been stopped.
      */
-	CancellationToken push(CancellableTask user_task)
+	CancellationToken push(CancellableTask user_task, PushOptions options)
 	{
-		auto token = std::make_shared<std::atomic<bool>>(false);
-
+		const CancellationToken token = CancellationSource().token();
+		DiscardedTasks discarded;
 		{
 			std::lock_guard<std::mutex> lock(mtx);
 			if (stopped) {
 				throw std::runtime_error("push on stopped ThrottledTaskQueue");
 			}
+			enqueue(std::move(user_task), options, token, QueueStats::Clock::now(), discarded);
+		}
+		cond.notify_one();
+		return token;
+	}
 
-			// If the queue is full, cancel and remove the oldest task.
-			while (queue.size() >= maxQueueSize) {
-				if (queue.front().second) {
-					queue.front().second->store(true); // Cancel
-				}
-				queue.pop();
+	/**
+	 * @brief Pushes several tasks with the default options.
+	 */
+	std::vector<CancellationToken> pushBatch(std::vector<CancellableTask> tasks)
+	{
+		return pushBatch(std::move(tasks), PushOptions());
+	}
+
+	/**
+	 * @brief Pushes several tasks with the same options, taking the lock and waking the worker only once.
+	 *
+	 * The tasks are queued in order as if pushed one by one, so with a coalesce key only the last one remains.
+	 * @return The tokens of the tasks, in the same order.
+	 * @throws std::runtime_error if the queue has already been stopped.
+	 */
+	std::vector<CancellationToken> pushBatch(std::vector<CancellableTask> tasks, const PushOptions &options)
+	{
+		std::vector<CancellationToken> tokens;
+		tokens.reserve(tasks.size());
+		for (std::size_t i = 0; i < tasks.size(); ++i) {
+			tokens.push_back(CancellationSource().token());
+		}
+
+		DiscardedTasks discarded;
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			if (stopped) {
+				throw std::runtime_error("push on stopped ThrottledTaskQueue");
+			}
+			const auto now = QueueStats::Clock::now();
+			for (std::size_t i = 0; i < tasks.size(); ++i) {
+				enqueue(std::move(tasks[i]), options, tokens[i], now, discarded);
 			}
-			queue.push({[user_task, token] { user_task(token); }, token});
 		}
 		cond.notify_one();
-		return token;
+		return tokens;
+	}
+
+	/**
+	 * @brief Pushes a task that returns a result, with the default options.
+	 */
+	template<typename F> auto submit(F fn) { return submit(std::move(fn), PushOptions()); }
+
+	/**
+	 * @brief Pushes a task that returns a result, e.g. `queue.submit([](const auto &token) { return 42; })`.
+	 *
+	 * The future completes with fn's return value or exception. It is cancelled instead if the task is cancelled
+	 * before it starts, is discarded without running, or throws OperationCancelled.
+	 * @throws std::runtime_error if the queue has already been stopped.
+	 */
+	template<typename F> auto submit(F fn, PushOptions options)
+	{
+		using Result = std::invoke_result_t<F &, const CancellationToken &>;
+		TaskPromise<Result> promise;
+		TaskFuture<Result> future = promise.getFuture();
+		auto task = [promise, fn = std::move(fn)](const CancellationToken &token) mutable {
+			Detail::completeWith(promise, fn, token);
+		};
+		push(std::move(task), std::move(options));
+		return future;
+	}
+
+	/**
+	 * @brief Returns the counters and histograms of this queue. Safe to call from any thread.
+	 */
+	QueueStatsSnapshot stats() const noexcept { return queueStats.snapshot(); }
+
+	/**
+	 * @brief Logs a summary of stats().
+	 */
+	void logStats() const
+	{
+		const QueueStatsSnapshot snapshot = stats();
+		logger.info("ThrottledTaskQueue: depth {} (high {}), pushed {}, started {}, dropped {}, coalesced {}, "
+			    "cancelled {}, expired {}, failed {}, wait p50 {}us p99 {}us, run p50 {}us p99 {}us",
+			    snapshot.depth, snapshot.highWaterMark, snapshot.pushed, snapshot.started, snapshot.dropped,
+			    snapshot.coalesced, snapshot.cancelled, snapshot.expired, snapshot.failed,
+			    snapshot.waitMicroseconds.percentile(0.5), snapshot.waitMicroseconds.percentile(0.99),
+			    snapshot.runMicroseconds.percentile(0.5), snapshot.runMicroseconds.percentile(0.99));
 	}
 
 private:
@@ -138,39 +345,161 @@ private:
      */
 	void workerLoop()
 	{
-		while (true) {
-			std::optional<std::function<void()>> taskOpt = pop();
-			if (!taskOpt) {
-				break;
+		std::vector<QueuedTask> batch;
+		batch.reserve(maxBatchSize);
+		while (popBatch(batch)) {
+			for (QueuedTask &task : batch) {
+				runTask(task);
 			}
+			batch.clear(); // Destroys the tasks without holding the lock
+		}
+	}
+
+	/**
+     * @brief Runs a popped task unless the queue was stopped, the task was cancelled through its token or its
+     * deadline has passed in the meantime.
+     */
+	void runTask(QueuedTask &task)
+	{
+		if (stopped) {
+			queueStats.onCancel();
+			task.token.cancel();
+			return;
+		}
+		if (task.token.isCancelled()) {
+			queueStats.onCancel();
+			return;
+		}
+		// Only tasks with a deadline pay for reading the clock
+		if (task.deadline != QueueStats::Clock::time_point::max() && task.deadline < QueueStats::Clock::now()) {
+			queueStats.onExpire();
+			task.token.cancel();
+			return;
+		}
 
-			try {
-				(*taskOpt)();
-			} catch (const std::exception &e) {
-				logger.error("ThrottledTaskQueue: Task threw an exception: {}", e.what());
-			} catch (...) {
-				logger.error("ThrottledTaskQueue: Task threw an unknown exception.");
+		const auto startedAt = QueueStats::Clock::now();
+		queueStats.onStart(task.pushedAt, startedAt);
+		try {
+			task.run();
+		} catch (const std::exception &e) {
+			queueStats.onFailure();
+			logger.error("ThrottledTaskQueue: Task threw an exception: {}", e.what());
+		} catch (...) {
+			queueStats.onFailure();
+			logger.error("ThrottledTaskQueue: Task threw an unknown exception.");
+		}
+		queueStats.onFinish(startedAt, QueueStats::Clock::now());
+	}
+
+	/**
+     * @brief Queues a task, discarding the task it coalesces with and the oldest ones of a full lane. Must be
+     * called with the mutex held.
+     */
+	void enqueue(CancellableTask user_task, const PushOptions &options, const CancellationToken &token,
+		     QueueStats::Clock::time_point now, DiscardedTasks &discarded)
+	{
+		Lane &lane = lanes[static_cast<std::size_t>(options.priority)];
+		std::function<void()> run = [user_task = std::move(user_task), token] { user_task(token); };
+
+		if (!options.coalesceKey.empty()) {
+			const auto pending = pendingByKey.find(options.coalesceKey);
+			if (pending != pendingByKey.end()) {
+				auto [pendingLane, pendingTask] = pending->second;
+				queueStats.onCoalesce();
+				if (pendingLane == &lane) {
+					// Take over the pending task's place in line
+					discarded.add(std::move(pendingTask->run), pendingTask->token);
+					pendingTask->run = std::move(run);
+					pendingTask->token = token;
+					pendingTask->pushedAt = now;
+					pendingTask->deadline = options.deadline;
+					queueStats.onPush(waitingCount);
+					return;
+				}
+				discarded.add(std::move(pendingTask->run), pendingTask->token);
+				pendingLane->queue.erase(pendingTask);
+				pendingByKey.erase(pending);
+				--waitingCount;
 			}
 		}
+
+		// If the lane is full, cancel and remove its oldest task.
+		while (lane.queue.size() >= lane.config.capacity) {
+			discarded.add(std::move(lane.queue.front().run), lane.queue.front().token);
+			popFront(lane);
+			queueStats.onDrop();
+		}
+		lane.queue.push_back({std::move(run), token, options.coalesceKey, now, options.deadline});
+		queueStats.onPush(++waitingCount);
+		if (!options.coalesceKey.empty()) {
+			pendingByKey.emplace(options.coalesceKey, QueuedTaskRef{&lane, std::prev(lane.queue.end())});
+		}
 	}
 
 	/**
-     * @brief Pops a task from the queue. Waits if the queue is empty.
-     * @return The task to be executed, or std::nullopt if the queue is stopped and empty.
+     * @brief Moves up to maxBatchSize tasks from the queue into batch, in scheduling order. Waits if the queue
+     * is empty.
+     * @return false if the queue is stopped and empty.
      */
-	std::optional<std::function<void()>> pop()
+	bool popBatch(std::vector<QueuedTask> &batch)
 	{
 		std::unique_lock<std::mutex> lock(mtx);
-		cond.wait(lock, [this] { return !queue.empty() || stopped; });
+		Lane *lane = nullptr;
+		cond.wait(lock, [this, &lane] { return (lane = nextLane()) != nullptr || stopped; });
+		while (lane) {
+			batch.push_back(std::move(lane->queue.front()));
+			popFront(*lane);
+			if (batch.size() >= maxBatchSize) {
+				break;
+			}
+			lane = nextLane();
+		}
+		return !batch.empty();
+	}
 
-		if (stopped && queue.empty()) {
-			return std::nullopt;
+	/**
+     * @brief Removes the first task of a lane, forgetting its coalesce key. Must be called with the mutex held.
+     */
+	void popFront(Lane &lane)
+	{
+		if (!lane.queue.front().coalesceKey.empty()) {
+			pendingByKey.erase(lane.queue.front().coalesceKey);
 		}
+		lane.queue.pop_front();
+		queueStats.setDepth(--waitingCount);
+	}
 
-		auto task_pair = std::move(queue.front());
-		queue.pop();
+	/**
+     * @brief Chooses the lane to take the next task from. Must be called with the mutex held.
+     * @return The lane, or nullptr if all lanes are empty.
+     */
+	Lane *nextLane()
+	{
+		if (scheduling == Scheduling::Strict) {
+			for (Lane &lane : lanes) {
+				if (!lane.queue.empty()) {
+					return &lane;
+				}
+			}
+			return nullptr;
+		}
 
-		return std::move(task_pair.first);
+		Lane *best = nullptr;
+		long long totalWeight = 0;
+		for (Lane &lane : lanes) {
+			if (lane.queue.empty()) {
+				continue;
+			}
+			lane.credit += lane.config.weight;
+			totalWeight += lane.config.weight;
+			if (!best || lane.credit > best->credit) {
+				best = &lane;
+			}
+		}
+		if (best) {
+			best->credit -= totalWeight;
+		}
+		return best;
 	}
 
 	/**
@@ -179,6 +508,7 @@ private:
      */
 	void stop()
 	{
+		DiscardedTasks discarded;
 		{
 			std::lock_guard<std::mutex> lock(mtx);
 			if (stopped) {
@@ -187,11 +517,12 @@ private:
 			stopped = true;
 
 			// Cancel all pending tasks in the queue before shutting down.
-			while (!queue.empty()) {
-				if (queue.front().second) {
-					queue.front().second->store(true);
+			for (Lane &lane : lanes) {
+				while (!lane.queue.empty()) {
+					discarded.add(std::move(lane.queue.front().run), lane.queue.front().token);
+					popFront(lane);
+					queueStats.onCancel();
 				}
-				queue.pop();
 			}
 		}
 		cond.notify_all();
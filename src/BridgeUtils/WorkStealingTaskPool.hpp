@@ -0,0 +1,335 @@
+/*
+Bridge Utils
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "CancellationToken.hpp"
+#include "ILogger.hpp"
+#include "ThrottledTaskQueue.hpp"
+
+namespace KaitoTokyo {
+namespace BridgeUtils {
+
+/**
+ * @brief A pool of worker threads for cancellable tasks, each worker with its own deque.
+ *
+ * A task is queued on one worker: the pushing worker itself when called from a task, otherwise the next worker
+ * in turn. Idle workers steal the newest tasks from busy ones. Tasks pushed with an affinity key always go to,
+ * and stay on, the same worker, so related work such as one recognizer's runs in order on a warm cache.
+ *
+ * Each worker holds at most maxQueueSize waiting tasks. When full, its oldest waiting task is cancelled and
+ * removed, as in ThrottledTaskQueue, whose token and task types are shared. As there, discarded tasks are
+ * destroyed after the lock is released, and tasks cancelled through their token while waiting are skipped.
+ */
+class WorkStealingTaskPool {
+public:
+	using CancellationToken = ThrottledTaskQueue::CancellationToken;
+	using CancellableTask = ThrottledTaskQueue::CancellableTask;
+
+	/**
+	 * @brief Constructor. Starts the worker threads.
+	 * @param _logger The logger to use for internal messages.
+	 * @param _maxQueueSize The maximum number of waiting tasks per worker. Must be at least 1.
+	 * @param workerCount The number of workers, or 0 for one per hardware thread.
+	 */
+	WorkStealingTaskPool(const ILogger &_logger, std::size_t _maxQueueSize, std::size_t workerCount = 0)
+		: logger(_logger),
+		  maxQueueSize(_maxQueueSize)
+	{
+		assert(_maxQueueSize > 0 && "max_size must be greater than 0");
+		if (workerCount == 0) {
+			workerCount = std::max(1u, std::thread::hardware_concurrency());
+		}
+		workers.reserve(workerCount);
+		for (std::size_t i = 0; i < workerCount; ++i) {
+			workers.push_back(std::make_unique<Worker>());
+		}
+		for (std::size_t i = 0; i < workerCount; ++i) {
+			workers[i]->thread = std::thread(&WorkStealingTaskPool::workerLoop, this, i);
+		}
+	}
+
+	/**
+	 * @brief Destructor. Stops the pool and waits for the worker threads to finish.
+	 */
+	~WorkStealingTaskPool() { shutdown(); }
+
+	// Forbid copy and move semantics to keep ownership simple.
+	WorkStealingTaskPool(const WorkStealingTaskPool &) = delete;
+	WorkStealingTaskPool &operator=(const WorkStealingTaskPool &) = delete;
+	WorkStealingTaskPool(WorkStealingTaskPool &&) = delete;
+	WorkStealingTaskPool &operator=(WorkStealingTaskPool &&) = delete;
+
+	/**
+	 * @brief Stops accepting tasks, cancels the waiting ones and waits for the workers to finish.
+	 */
+	void shutdown()
+	{
+		for (auto &worker : workers) {
+			DiscardedItems discarded;
+			std::lock_guard<std::mutex> lock(worker->mtx);
+			stopped.store(true);
+			discardAll(worker->stealable, discarded);
+			discardAll(worker->pinned, discarded);
+		}
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			for (auto &worker : workers) {
+				worker->sleeping = false;
+				worker->cond.notify_one();
+			}
+		}
+		for (auto &worker : workers) {
+			if (worker->thread.joinable()) {
+				worker->thread.join();
+			}
+		}
+	}
+
+	std::size_t workerCount() const noexcept { return workers.size(); }
+
+	/**
+	 * @brief The number of tasks skipped because they were cancelled through their token while waiting.
+	 */
+	std::uint64_t cancelledCount() const noexcept { return skippedCount.load(std::memory_order_relaxed); }
+
+	/**
+	 * @brief Pushes a task that any worker may run.
+	 * @return A token that can be used to cancel the task externally.
+	 * @throws std::runtime_error if the pool has already been stopped.
+	 */
+	CancellationToken push(CancellableTask userTask)
+	{
+		const std::size_t index = currentPool == this ? currentWorker
+							      : nextWorker.fetch_add(1, std::memory_order_relaxed) %
+									workers.size();
+		return enqueue(index, false, std::move(userTask));
+	}
+
+	/**
+	 * @brief Pushes a task that runs on the worker chosen by affinityKey and is never stolen.
+	 * Tasks with the same key run one at a time in push order.
+	 * @return A token that can be used to cancel the task externally.
+	 * @throws std::runtime_error if the pool has already been stopped.
+	 */
+	CancellationToken pushWithAffinity(std::uint64_t affinityKey, CancellableTask userTask)
+	{
+		return enqueue(static_cast<std::size_t>(affinityKey % workers.size()), true, std::move(userTask));
+	}
+
+private:
+	struct Item {
+		std::uint64_t sequence;
+		std::function<void()> run;
+		CancellationToken token;
+	};
+
+	struct Worker {
+		std::mutex mtx;
+		std::deque<Item> stealable;
+		std::deque<Item> pinned;
+		std::atomic<std::size_t> pinnedCount{0};
+		std::condition_variable cond; ///< Waited on with sleepMutex.
+		bool sleeping = false;        ///< Guarded by sleepMutex.
+		std::thread thread;
+	};
+
+	/**
+	 * @brief Tells which lane holds the oldest waiting task. At least one lane must be non-empty.
+	 */
+	static bool oldestIsPinned(const Worker &worker)
+	{
+		return worker.stealable.empty() ||
+		       (!worker.pinned.empty() && worker.pinned.front().sequence < worker.stealable.front().sequence);
+	}
+
+	/**
+	 * @brief Items removed without running. Declared before the lock, so that they are cancelled and destroyed
+	 * after it is released.
+	 */
+	struct DiscardedItems {
+		std::deque<Item> items;
+
+		~DiscardedItems()
+		{
+			for (Item &item : items) {
+				item.token.cancel();
+			}
+		}
+	};
+
+	static void discardAll(std::deque<Item> &items, DiscardedItems &discarded)
+	{
+		for (Item &item : items) {
+			discarded.items.push_back(std::move(item));
+		}
+		items.clear();
+	}
+
+	CancellationToken enqueue(std::size_t index, bool pin, CancellableTask userTask)
+	{
+		const CancellationToken token = CancellationSource().token();
+		Worker &worker = *workers[index];
+		DiscardedItems discarded;
+		{
+			std::lock_guard<std::mutex> lock(worker.mtx);
+			if (stopped.load()) {
+				throw std::runtime_error("push on stopped WorkStealingTaskPool");
+			}
+
+			// If the worker is full, cancel and remove its oldest waiting task.
+			while (worker.stealable.size() + worker.pinned.size() >= maxQueueSize) {
+				const bool fromPinned = oldestIsPinned(worker);
+				std::deque<Item> &items = fromPinned ? worker.pinned : worker.stealable;
+				discarded.items.push_back(std::move(items.front()));
+				items.pop_front();
+				(fromPinned ? worker.pinnedCount : stealableCount).fetch_sub(1);
+			}
+
+			const std::uint64_t sequence = nextSequence.fetch_add(1, std::memory_order_relaxed);
+			auto run = [userTask = std::move(userTask), token] { userTask(token); };
+			(pin ? worker.pinned : worker.stealable).push_back({sequence, std::move(run), token});
+			(pin ? worker.pinnedCount : stealableCount).fetch_add(1);
+		}
+		wake(index, pin);
+		return token;
+	}
+
+	/*
+	 * A worker going to sleep increments sleepers and then checks the counts, while a push increments the
+	 * counts and then checks sleepers. With sequentially consistent operations at least one side notices.
+	 */
+	void wake(std::size_t index, bool pin)
+	{
+		if (sleepers.load() == 0) {
+			return;
+		}
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		Worker *target = workers[index].get();
+		if (!target->sleeping && !pin) {
+			const auto sleeper = std::find_if(workers.begin(), workers.end(),
+							  [](const std::unique_ptr<Worker> &w) { return w->sleeping; });
+			target = sleeper != workers.end() ? sleeper->get() : nullptr;
+		}
+		if (target && target->sleeping) {
+			target->sleeping = false;
+			target->cond.notify_one();
+		}
+	}
+
+	bool popOwn(Worker &worker, Item &item)
+	{
+		std::lock_guard<std::mutex> lock(worker.mtx);
+		if (worker.pinned.empty() && worker.stealable.empty()) {
+			return false;
+		}
+		const bool fromPinned = oldestIsPinned(worker);
+		std::deque<Item> &items = fromPinned ? worker.pinned : worker.stealable;
+		item = std::move(items.front());
+		items.pop_front();
+		(fromPinned ? worker.pinnedCount : stealableCount).fetch_sub(1);
+		return true;
+	}
+
+	bool steal(std::size_t thief, Item &item)
+	{
+		for (std::size_t offset = 1; offset < workers.size() && stealableCount.load() > 0; ++offset) {
+			Worker &victim = *workers[(thief + offset) % workers.size()];
+			std::lock_guard<std::mutex> lock(victim.mtx);
+			if (!victim.stealable.empty()) {
+				// Take the newest task, leaving the oldest ones to the owner
+				item = std::move(victim.stealable.back());
+				victim.stealable.pop_back();
+				stealableCount.fetch_sub(1);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/**
+	 * @brief The main loop for a worker thread.
+	 */
+	void workerLoop(std::size_t index)
+	{
+		currentPool = this;
+		currentWorker = index;
+		Worker &worker = *workers[index];
+
+		while (true) {
+			Item item;
+			if (popOwn(worker, item) || steal(index, item)) {
+				if (item.token.isCancelled()) {
+					skippedCount.fetch_add(1, std::memory_order_relaxed);
+					continue;
+				}
+				try {
+					item.run();
+				} catch (const std::exception &e) {
+					logger.error("WorkStealingTaskPool: Task threw an exception: {}", e.what());
+				} catch (...) {
+					logger.error("WorkStealingTaskPool: Task threw an unknown exception.");
+				}
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			if (stopped.load()) {
+				break;
+			}
+			sleepers.fetch_add(1);
+			worker.sleeping = true;
+			if (stealableCount.load() == 0 && worker.pinnedCount.load() == 0) {
+				worker.cond.wait(lock, [&] { return !worker.sleeping; });
+			}
+			worker.sleeping = false;
+			sleepers.fetch_sub(1);
+		}
+	}
+
+	inline static thread_local const WorkStealingTaskPool *currentPool = nullptr;
+	inline static thread_local std::size_t currentWorker = 0;
+
+	const ILogger &logger;
+	const std::size_t maxQueueSize;
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::atomic<std::size_t> nextWorker{0};
+	std::atomic<std::uint64_t> nextSequence{0};
+	std::atomic<std::size_t> stealableCount{0};
+	std::atomic<std::size_t> sleepers{0};
+	std::atomic<bool> stopped{false};
+	std::atomic<std::uint64_t> skippedCount{0};
+	std::mutex sleepMutex;
+};
+
+} // namespace BridgeUtils
+} // namespace KaitoTokyo
@@ -0,0 +1,213 @@
+/*
+Live Transcribe Fine
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include <ILogger.hpp>
+
+namespace KaitoTokyo {
+namespace LiveTranscribeFine {
+
+/**
+ * @brief How hard the plugin is throttling itself to stay within its CPU budget, from mildest to harshest.
+ */
+enum class CpuBudgetState : int {
+	WithinBudget,
+	PartialsSuspended,  ///< No partial results are built.
+	SnapshotsSuspended, ///< Snapshot requests are ignored as well.
+	SheddingAudio,      ///< Workers also pause once the budget of the window is spent, and stale audio is skipped.
+};
+
+inline const char *toString(CpuBudgetState state) noexcept
+{
+	switch (state) {
+	case CpuBudgetState::WithinBudget:
+		return "within budget";
+	case CpuBudgetState::PartialsSuspended:
+		return "partials suspended";
+	case CpuBudgetState::SnapshotsSuspended:
+		return "snapshots suspended";
+	case CpuBudgetState::SheddingAudio:
+		return "shedding audio";
+	}
+	return "unknown";
+}
+
+struct CpuBudgetSnapshot {
+	CpuBudgetState state = CpuBudgetState::WithinBudget;
+	double budgetCores = 0.0; ///< 0 means unlimited.
+	double usageCores = 0.0;  ///< Measured over the last complete window.
+};
+
+/**
+ * @brief CPU time consumed by the calling thread so far. Blocked time is not counted.
+ */
+inline std::chrono::nanoseconds currentThreadCpuTime() noexcept
+{
+#ifdef _WIN32
+	FILETIME creationTime, exitTime, kernelTime, userTime;
+	if (!GetThreadTimes(GetCurrentThread(), &creationTime, &exitTime, &kernelTime, &userTime)) {
+		return std::chrono::nanoseconds(0);
+	}
+	const auto ticks = [](const FILETIME &time) {
+		return (static_cast<std::uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+	};
+	return std::chrono::nanoseconds((ticks(kernelTime) + ticks(userTime)) * 100);
+#else
+	timespec ts;
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+		return std::chrono::nanoseconds(0);
+	}
+	return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+#endif
+}
+
+/**
+ * @brief Caps the CPU share of the plugin's worker threads.
+ *
+ * Workers report the thread CPU time they spend with addCpuTime and call evaluate regularly. At the end of
+ * each window, usage above the budget tightens the state by one step, and usage well below it relaxes the
+ * state by one step, so a short burst does not flap between states.
+ *
+ * If evaluate is called late, the CPU time is charged to the last window and every whole window before it
+ * counts as idle, relaxing the state one step each. An idle gap therefore neither dilutes a burst that
+ * follows it nor keeps the plugin throttled for longer than the gap warrants.
+ */
+class CpuBudgetGovernor {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	/**
+	 * @param _budgetCores CPU time per wall-clock time allowed, e.g. 2.0 for two cores. 0 disables the cap.
+	 */
+	CpuBudgetGovernor(const BridgeUtils::ILogger &_logger, double _budgetCores,
+			  Clock::duration _window = std::chrono::seconds(1))
+		: logger(_logger),
+		  budgetCores(_budgetCores > 0.0 ? _budgetCores : 0.0),
+		  window(_window),
+		  windowBudget(static_cast<std::int64_t>(budgetCores *
+							 std::chrono::duration<double, std::nano>(_window).count())),
+		  windowStart(Clock::now())
+	{
+	}
+
+	/**
+	 * @brief Adds CPU time spent by a worker. Safe to call from any thread.
+	 */
+	void addCpuTime(std::chrono::nanoseconds cpuTime) noexcept
+	{
+		windowCpuNanoseconds.fetch_add(cpuTime.count(), std::memory_order_relaxed);
+	}
+
+	/**
+	 * @brief Closes the current window if it has elapsed and adjusts the state. Safe to call from any thread.
+	 */
+	void evaluate(Clock::time_point now)
+	{
+		std::unique_lock<std::mutex> lock(mtx, std::try_to_lock);
+		if (!lock.owns_lock() || now - windowStart < window) {
+			return;
+		}
+
+		const Clock::duration elapsed = now - windowStart;
+		const auto idleWindows = elapsed / window - 1;
+		const double lastWindowSeconds = std::chrono::duration<double>(elapsed - idleWindows * window).count();
+		const double cpuSeconds = static_cast<double>(windowCpuNanoseconds.exchange(0)) / 1e9;
+		const double usage = cpuSeconds / lastWindowSeconds;
+		windowStart = now;
+		usageMilliCores.store(static_cast<std::int64_t>(usage * 1000.0), std::memory_order_relaxed);
+
+		if (budgetCores == 0.0) {
+			return;
+		}
+
+		const CpuBudgetState current = state();
+		// Every whole window before the last one was idle
+		constexpr int harshest = static_cast<int>(CpuBudgetState::SheddingAudio);
+		const int idleSteps = static_cast<int>(std::min<std::int64_t>(idleWindows, harshest));
+		int level = std::max(static_cast<int>(current) - idleSteps, 0);
+		if (usage > budgetCores) {
+			level = std::min(level + 1, harshest);
+		} else if (usage < budgetCores * relaxRatio) {
+			level = std::max(level - 1, 0);
+		}
+		const CpuBudgetState next = static_cast<CpuBudgetState>(level);
+		if (next > current) {
+			logger.warn("CPU usage of {:.2f} cores exceeds the budget of {:.2f} cores, now {}", usage,
+				    budgetCores, toString(next));
+		} else if (next < current) {
+			logger.info("CPU usage of {:.2f} cores is back under the budget of {:.2f} cores, now {}", usage,
+				    budgetCores, toString(next));
+		}
+		currentState.store(next, std::memory_order_relaxed);
+	}
+
+	CpuBudgetState state() const noexcept { return currentState.load(std::memory_order_relaxed); }
+
+	/**
+	 * @brief Tells whether workers should pause until the next window, which is only done when shedding audio.
+	 */
+	bool exhausted() const noexcept
+	{
+		return state() == CpuBudgetState::SheddingAudio &&
+		       windowCpuNanoseconds.load(std::memory_order_relaxed) >= windowBudget;
+	}
+
+	Clock::time_point windowEnd()
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		return windowStart + window;
+	}
+
+	CpuBudgetSnapshot snapshot() const noexcept
+	{
+		CpuBudgetSnapshot result;
+		result.state = state();
+		result.budgetCores = budgetCores;
+		result.usageCores = static_cast<double>(usageMilliCores.load(std::memory_order_relaxed)) / 1000.0;
+		return result;
+	}
+
+private:
+	static constexpr double relaxRatio = 0.75;
+
+	const BridgeUtils::ILogger &logger;
+	const double budgetCores;
+	const Clock::duration window;
+	const std::int64_t windowBudget; ///< CPU nanoseconds allowed per window.
+	std::atomic<std::int64_t> windowCpuNanoseconds{0};
+	std::atomic<std::int64_t> usageMilliCores{0};
+	std::atomic<CpuBudgetState> currentState{CpuBudgetState::WithinBudget};
+	std::mutex mtx;
+	Clock::time_point windowStart; ///< Guarded by mtx.
+};
+
+} // namespace LiveTranscribeFine
+} // namespace KaitoTokyo
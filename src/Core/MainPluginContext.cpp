@@ -18,11 +18,15 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "MainPluginContext.h"
 
+#include <algorithm>
 #include <filesystem>
 #include <future>
+#include <optional>
 #include <stdexcept>
 #include <thread>
 
+#include <fmt/format.h>
+
 #include <obs-module.h>
 #include <obs-frontend-api.h>
 
@@ -32,6 +36,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <ILogger.hpp>
 #include <ObsUnique.hpp>
 
+#include "ModelDirectory.hpp"
+
 using namespace KaitoTokyo::BridgeUtils;
 
 namespace KaitoTokyo {
@@ -46,25 +52,73 @@ inline obs_audio_info getOutputAudioInfo()
 	return oai;
 }
 
+std::string formatCpuBudgetStatus(const CpuBudgetSnapshot &cpuBudget)
+{
+	return fmt::format("{}: {:.2f} / {:.2f} ({})", obs_module_text("cpuBudget"), cpuBudget.usageCores,
+			   cpuBudget.budgetCores, toString(cpuBudget.state));
+}
+
+/**
+ * @brief Rewrites the CPU budget line with the governor's current state, since OBS_TEXT_INFO is only drawn once.
+ * @param data The std::weak_ptr<RecognitionScheduler> owned by the properties.
+ */
+bool refreshCpuBudgetStatus(obs_properties_t *props, obs_property_t *, void *data)
+{
+	const auto scheduler = static_cast<std::weak_ptr<RecognitionScheduler> *>(data)->lock();
+	if (!scheduler) {
+		return false;
+	}
+	obs_property_set_description(obs_properties_get(props, "cpuBudgetStatus"),
+				     formatCpuBudgetStatus(scheduler->cpuBudget()).c_str());
+	return true;
+}
+
 } // anonymous namespace
 
 MainPluginContext::MainPluginContext(obs_data_t *const settings, obs_source_t *const _source,
-				     const BridgeUtils::ILogger &_logger,
-				     std::shared_future<std::string> _latestVersionFuture)
+				     const BridgeUtils::ILogger &_logger, const PluginConfig &_pluginConfig,
+				     std::shared_ptr<const WebSocket::StaticAssetCache> _overlayAssets,
+				     std::shared_future<std::string> _latestVersionFuture,
+				     std::shared_ptr<RecognitionScheduler> _recognitionScheduler)
 	: source{_source},
 	  logger(_logger),
-	  latestVersionFuture(_latestVersionFuture)
+	  pluginConfig(_pluginConfig),
+	  overlayAssets(std::move(_overlayAssets)),
+	  latestVersionFuture(_latestVersionFuture),
+	  recognitionScheduler(std::move(_recognitionScheduler))
 {
+	if (!recognitionScheduler) {
+		throw std::invalid_argument("recognitionScheduler must not be null");
+	}
 	update(settings);
 }
 
-void MainPluginContext::shutdown() noexcept {}
+void MainPluginContext::shutdown() noexcept
+{
+	// Stop decoding first, since results are published from the recognition workers
+	recognitionContext.reset();
+	replaceSink(webSocketServer);
+#ifndef _WIN32
+	replaceSink(transcriptRing);
+	replaceSink(oscSink);
+#endif
+}
 
 MainPluginContext::~MainPluginContext() noexcept {}
 
 void MainPluginContext::getDefaults(obs_data_t *data)
 {
 	obs_data_set_default_string(data, "voskModelPath", "");
+	obs_data_set_default_int(data, "webSocketPort", 0);
+	obs_data_set_default_string(data, "unixSocketPath", "");
+	obs_data_set_default_bool(data, "unixSocketLengthPrefixed", false);
+	obs_data_set_default_string(data, "webSocketTlsCertFile", "");
+	obs_data_set_default_string(data, "webSocketTlsKeyFile", "");
+	obs_data_set_default_bool(data, "webSocketControlEnabled", false);
+	obs_data_set_default_string(data, "controlModelsDirectory", "");
+	obs_data_set_default_string(data, "sharedMemoryName", "");
+	obs_data_set_default_string(data, "oscTarget", "");
+	obs_data_set_default_string(data, "oscKeywords", "");
 }
 
 obs_properties_t *MainPluginContext::getProperties()
@@ -73,6 +127,30 @@ obs_properties_t *MainPluginContext::getProperties()
 
 	obs_properties_add_path(props, "voskModelPath", obs_module_text("voskModelPath"), OBS_PATH_DIRECTORY, nullptr,
 				nullptr);
+	obs_properties_add_int(props, "webSocketPort", obs_module_text("webSocketPort"), 0, 65535, 1);
+	obs_properties_add_text(props, "unixSocketPath", obs_module_text("unixSocketPath"), OBS_TEXT_DEFAULT);
+	obs_properties_add_bool(props, "unixSocketLengthPrefixed", obs_module_text("unixSocketLengthPrefixed"));
+	obs_properties_add_path(props, "webSocketTlsCertFile", obs_module_text("webSocketTlsCertFile"), OBS_PATH_FILE,
+				"PEM (*.pem *.crt);;All Files (*.*)", nullptr);
+	obs_properties_add_path(props, "webSocketTlsKeyFile", obs_module_text("webSocketTlsKeyFile"), OBS_PATH_FILE,
+				"PEM (*.pem *.key);;All Files (*.*)", nullptr);
+	obs_properties_add_bool(props, "webSocketControlEnabled", obs_module_text("webSocketControlEnabled"));
+	obs_properties_add_path(props, "controlModelsDirectory", obs_module_text("controlModelsDirectory"),
+				OBS_PATH_DIRECTORY, nullptr, nullptr);
+#ifndef _WIN32
+	obs_properties_add_text(props, "sharedMemoryName", obs_module_text("sharedMemoryName"), OBS_TEXT_DEFAULT);
+	obs_properties_add_text(props, "oscTarget", obs_module_text("oscTarget"), OBS_TEXT_DEFAULT);
+	obs_properties_add_text(props, "oscKeywords", obs_module_text("oscKeywords"), OBS_TEXT_DEFAULT);
+#endif
+
+	obs_properties_add_text(props, "cpuBudgetStatus",
+				formatCpuBudgetStatus(recognitionScheduler->cpuBudget()).c_str(), OBS_TEXT_INFO);
+	// The properties may outlive this filter, so the button only holds on to the scheduler weakly
+	auto *scheduler = new std::weak_ptr<RecognitionScheduler>(recognitionScheduler);
+	obs_properties_set_param(props, scheduler,
+				 [](void *param) { delete static_cast<std::weak_ptr<RecognitionScheduler> *>(param); });
+	obs_properties_add_button2(props, "cpuBudgetRefresh", obs_module_text("cpuBudgetRefresh"),
+				   refreshCpuBudgetStatus, scheduler);
 
 	return props;
 }
@@ -81,6 +159,82 @@ void MainPluginContext::update(obs_data_t *settings)
 {
 	bool contextNeedsUpdate = false;
 
+	const int newWebSocketPort = static_cast<int>(obs_data_get_int(settings, "webSocketPort"));
+	const std::string newUnixSocketPath = obs_data_get_string(settings, "unixSocketPath");
+	const bool newUnixSocketLengthPrefixed = obs_data_get_bool(settings, "unixSocketLengthPrefixed");
+	const std::string newWebSocketTlsCertFile = obs_data_get_string(settings, "webSocketTlsCertFile");
+	const std::string newWebSocketTlsKeyFile = obs_data_get_string(settings, "webSocketTlsKeyFile");
+	const bool newWebSocketControlEnabled = obs_data_get_bool(settings, "webSocketControlEnabled");
+	if (pluginProperty.webSocketPort != newWebSocketPort || pluginProperty.unixSocketPath != newUnixSocketPath ||
+	    pluginProperty.unixSocketLengthPrefixed != newUnixSocketLengthPrefixed ||
+	    pluginProperty.webSocketTlsCertFile != newWebSocketTlsCertFile ||
+	    pluginProperty.webSocketTlsKeyFile != newWebSocketTlsKeyFile ||
+	    pluginProperty.webSocketControlEnabled != newWebSocketControlEnabled) {
+		pluginProperty.webSocketPort = newWebSocketPort;
+		pluginProperty.unixSocketPath = newUnixSocketPath;
+		pluginProperty.unixSocketLengthPrefixed = newUnixSocketLengthPrefixed;
+		pluginProperty.webSocketTlsCertFile = newWebSocketTlsCertFile;
+		pluginProperty.webSocketTlsKeyFile = newWebSocketTlsKeyFile;
+		pluginProperty.webSocketControlEnabled = newWebSocketControlEnabled;
+		// The old server must be gone before the new one binds the same port
+		replaceSink(webSocketServer);
+		if (newWebSocketPort > 0) {
+			WebSocket::BroadcastWebSocketServerOptions options;
+			options.idleTimeoutSeconds =
+				static_cast<unsigned short>(std::clamp(pluginConfig.webSocketIdleTimeoutSeconds, 0, 960));
+			options.sendPingsAutomatically = pluginConfig.webSocketSendPingsAutomatically;
+			options.staticAssets = overlayAssets;
+			options.unixSocketPath = newUnixSocketPath;
+			options.unixSocketFraming = newUnixSocketLengthPrefixed ? WebSocket::UnixSocketFraming::LengthPrefixed
+									       : WebSocket::UnixSocketFraming::WebSocket;
+			options.tls.certFile = newWebSocketTlsCertFile;
+			options.tls.keyFile = newWebSocketTlsKeyFile;
+			// Control commands can pause recognition or load models, so clients only get them on request
+			auto server = WebSocket::BroadcastWebSocketServer::create(
+				logger, newWebSocketPort, newWebSocketControlEnabled ? &controlCommandQueue : nullptr,
+				options);
+			if (server->start()) {
+				replaceSink(webSocketServer, std::move(server));
+			} else {
+				logger.error("Failed to start WebSocket server on port {}", newWebSocketPort);
+			}
+		}
+	}
+
+	pluginProperty.controlModelsDirectory = obs_data_get_string(settings, "controlModelsDirectory");
+
+#ifndef _WIN32
+	const std::string newSharedMemoryName = obs_data_get_string(settings, "sharedMemoryName");
+	if (pluginProperty.sharedMemoryName != newSharedMemoryName) {
+		pluginProperty.sharedMemoryName = newSharedMemoryName;
+		// The old writer unlinks its name when destroyed, so it must go before the new one is created
+		replaceSink(transcriptRing);
+		if (!newSharedMemoryName.empty()) {
+			try {
+				replaceSink(transcriptRing,
+					    std::make_unique<TranscriptRing::TranscriptRingWriter>(newSharedMemoryName));
+				logger.info("Publishing transcripts to shared memory {}", newSharedMemoryName);
+			} catch (const std::exception &e) {
+				logger.error("Failed to create shared-memory transcript ring: {}", e.what());
+			}
+		}
+	}
+
+	const std::string newOscTarget = obs_data_get_string(settings, "oscTarget");
+	const std::string newOscKeywords = obs_data_get_string(settings, "oscKeywords");
+	if (pluginProperty.oscTarget != newOscTarget || pluginProperty.oscKeywords != newOscKeywords) {
+		pluginProperty.oscTarget = newOscTarget;
+		pluginProperty.oscKeywords = newOscKeywords;
+		replaceSink(oscSink);
+		if (!newOscTarget.empty()) {
+			auto sink = std::make_unique<Osc::OscSink>(logger, newOscTarget, newOscKeywords);
+			if (sink->start()) {
+				replaceSink(oscSink, std::move(sink));
+			}
+		}
+	}
+#endif
+
 	const char *newVoskModelPath = obs_data_get_string(settings, "voskModelPath");
 	if (!std::filesystem::exists(newVoskModelPath)) {
 		logger.warn("Vosk model path does not exist: {}", newVoskModelPath);
@@ -95,24 +249,122 @@ void MainPluginContext::update(obs_data_t *settings)
 
 	if (!recognitionContext || contextNeedsUpdate) {
 		float sampleRate = static_cast<float>(getOutputAudioInfo().samples_per_sec);
-		recognitionContext = std::make_unique<RecognitionContext>(logger, newVoskModelPath, sampleRate);
+		recognitionContext = std::make_unique<RecognitionContext>(
+			logger, *recognitionScheduler, obs_source_get_name(source), newVoskModelPath, sampleRate,
+			[this](std::string_view resultJson, bool isFinal) { publishResult(resultJson, isFinal); });
+		recognitionContext->setPartialRate(partialRate.load(std::memory_order_relaxed));
 	}
 }
 
 obs_audio_data *MainPluginContext::filterAudio(obs_audio_data *audio)
 try {
-	if (recognitionContext) {
+	processControlCommands();
+
+	if (recognitionContext && !recognitionPaused.load(std::memory_order_relaxed)) {
 		return recognitionContext->filterAudio(audio);
 	} else {
 		return audio;
 	}
 } catch (const std::exception &e) {
-	logger.error("Failed to filter audio: {}", e.what());
+	BRIDGE_UTILS_LOG_RATE_LIMITED(logger, Error, "Failed to filter audio: {}", e.what());
 	return audio;
 } catch (...) {
-	logger.error("Failed to filter audio: unknown error");
+	BRIDGE_UTILS_LOG_RATE_LIMITED(logger, Error, "Failed to filter audio: unknown error");
 	return audio;
 }
 
+void MainPluginContext::processControlCommands()
+{
+	using WebSocket::ControlCommandType;
+
+	while (auto command = controlCommandQueue.tryPop()) {
+		switch (command->type) {
+		case ControlCommandType::Pause:
+			logger.info("Recognition paused by control command");
+			recognitionPaused.store(true, std::memory_order_relaxed);
+			break;
+		case ControlCommandType::Resume:
+			logger.info("Recognition resumed by control command");
+			recognitionPaused.store(false, std::memory_order_relaxed);
+			break;
+		case ControlCommandType::SwitchModel:
+			switchModel(command->argument);
+			break;
+		case ControlCommandType::RequestSnapshot:
+			if (recognitionContext) {
+				recognitionContext->publishSnapshot();
+			}
+			break;
+		case ControlCommandType::SetPartialRate:
+			partialRate.store(command->partialRate, std::memory_order_relaxed);
+			if (recognitionContext) {
+				recognitionContext->setPartialRate(command->partialRate);
+			}
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+void MainPluginContext::switchModel(const std::string &voskModelPath)
+{
+	struct SwitchModelTask {
+		std::weak_ptr<MainPluginContext> self;
+		std::string voskModelPath;
+	};
+
+	// Loading a model takes seconds, so hand it over to the UI thread through the regular settings path.
+	// Clients may only pick models from the configured directory, which is checked there as well.
+	obs_queue_task(
+		OBS_TASK_UI,
+		[](void *param) {
+			std::unique_ptr<SwitchModelTask> task(static_cast<SwitchModelTask *>(param));
+			auto self = task->self.lock();
+			if (!self) {
+				return;
+			}
+			const std::optional<std::filesystem::path> modelPath = resolveModelInDirectory(
+				self->pluginProperty.controlModelsDirectory, task->voskModelPath);
+			if (!modelPath) {
+				self->logger.warn("Ignoring model '{}' requested by a client, as it is not in '{}'",
+						  task->voskModelPath, self->pluginProperty.controlModelsDirectory);
+				return;
+			}
+			unique_obs_data_t settings(obs_source_get_settings(self->source));
+			obs_data_set_string(settings.get(), "voskModelPath", modelPath->string().c_str());
+			obs_source_update(self->source, settings.get());
+		},
+		new SwitchModelTask{weak_from_this(), voskModelPath}, false);
+}
+
+void MainPluginContext::publishResult(std::string_view resultJson, bool isFinal)
+{
+	std::lock_guard<std::mutex> lock(sinkMutex);
+	if (webSocketServer) {
+		webSocketServer->publish(isFinal ? WebSocket::BroadcastWebSocketServer::finalTopic
+						 : WebSocket::BroadcastWebSocketServer::partialTopic,
+					 std::string(resultJson));
+	}
+#ifndef _WIN32
+	if (transcriptRing &&
+	    !transcriptRing->publish(isFinal ? TRANSCRIPT_RING_TOPIC_FINAL : TRANSCRIPT_RING_TOPIC_PARTIAL, resultJson)) {
+		BRIDGE_UTILS_LOG_RATE_LIMITED(logger, Warn,
+					      "Result of {} bytes exceeds the shared-memory slot size of {} bytes",
+					      resultJson.size(), transcriptRing->maxMessageSize());
+	}
+	if (oscSink && (isFinal || oscSink->hasKeywords())) {
+		const WebSocket::TranscriptMessage message(isFinal ? WebSocket::FinalTopicBit : WebSocket::PartialTopicBit,
+							   std::string(resultJson));
+		const std::string_view text = message.representation(WebSocket::MessageFormat::Text);
+		if (isFinal) {
+			oscSink->publishFinal(text);
+		} else {
+			oscSink->publishPartial(text);
+		}
+	}
+#endif
+}
+
 } // namespace LiveTranscribeFine
 } // namespace KaitoTokyo
@@ -24,15 +24,28 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #ifdef __cplusplus
 
+#include <atomic>
 #include <future>
 #include <memory>
+#include <mutex>
+#include <string_view>
 
 #include <vosk_api.h>
 
+#include <BroadcastWebSocketServer.hpp>
+#include <ControlCommand.hpp>
 #include <ILogger.hpp>
+#include <StaticAssetCache.hpp>
 
+#ifndef _WIN32
+#include <OscSink.hpp>
+#include <TranscriptRingWriter.hpp>
+#endif
+
+#include "PluginConfig.hpp"
 #include "PluginProperty.hpp"
 #include "RecognitionContext.hpp"
+#include "RecognitionScheduler.hpp"
 
 namespace KaitoTokyo {
 namespace LiveTranscribeFine {
@@ -43,15 +56,37 @@ public:
 	const BridgeUtils::ILogger &logger;
 
 private:
+	const PluginConfig pluginConfig;
+	const std::shared_ptr<const WebSocket::StaticAssetCache> overlayAssets;
 	std::shared_future<std::string> latestVersionFuture;
 
 	PluginProperty pluginProperty;
 
+	const std::shared_ptr<RecognitionScheduler> recognitionScheduler;
 	std::unique_ptr<RecognitionContext> recognitionContext = nullptr;
 
+	WebSocket::ControlCommandQueue controlCommandQueue{64};
+
+	// The result sinks are replaced on the UI thread while the recognition workers publish to them. publishResult
+	// holds sinkMutex for as long as it uses them, so a sink swapped out under the lock can be destroyed safely.
+	std::mutex sinkMutex;
+	std::unique_ptr<WebSocket::BroadcastWebSocketServer> webSocketServer = nullptr;
+#ifndef _WIN32
+	std::unique_ptr<TranscriptRing::TranscriptRingWriter> transcriptRing = nullptr;
+	std::unique_ptr<Osc::OscSink> oscSink = nullptr;
+#endif
+
+	// Set from the audio thread, where control commands are drained. update() reads partialRate on the UI thread
+	// to carry it over to a new RecognitionContext.
+	std::atomic<bool> recognitionPaused{false};
+	std::atomic<double> partialRate{10.0};
+
 public:
 	MainPluginContext(obs_data_t *const settings, obs_source_t *const source, const BridgeUtils::ILogger &logger,
-			  std::shared_future<std::string> latestVersionFuture);
+			  const PluginConfig &pluginConfig,
+			  std::shared_ptr<const WebSocket::StaticAssetCache> overlayAssets,
+			  std::shared_future<std::string> latestVersionFuture,
+			  std::shared_ptr<RecognitionScheduler> recognitionScheduler);
 
 	void shutdown() noexcept;
 	~MainPluginContext() noexcept;
@@ -62,6 +97,24 @@ public:
 	void update(obs_data_t *settings);
 
 	obs_audio_data *filterAudio(obs_audio_data *audio);
+
+private:
+	void processControlCommands();
+	void switchModel(const std::string &voskModelPath);
+	void publishResult(std::string_view resultJson, bool isFinal);
+
+	/**
+	 * @brief Installs next, or nothing, as a result sink and destroys the previous one once no worker is publishing
+	 * to it.
+	 */
+	template<typename Sink> void replaceSink(std::unique_ptr<Sink> &sink, std::unique_ptr<Sink> next = nullptr)
+	{
+		{
+			std::lock_guard<std::mutex> lock(sinkMutex);
+			sink.swap(next);
+		}
+		// next now holds the previous sink, which is stopped and destroyed outside the lock
+	}
 };
 
 } // namespace LiveTranscribeFine
@@ -71,6 +124,7 @@ extern "C" {
 #endif // __cplusplus
 
 bool main_plugin_context_module_load(void);
+void main_plugin_context_module_unload(void);
 
 const char *main_plugin_context_get_name(void *type_data);
 void *main_plugin_context_create(obs_data_t *settings, obs_source_t *source);
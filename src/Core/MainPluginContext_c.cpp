@@ -18,11 +18,16 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "MainPluginContext.h"
 
+#include <algorithm>
+#include <cmath>
 #include <stdexcept>
+#include <thread>
 
 #include <obs-module.h>
 
 #include <ObsLogger.hpp>
+#include <ObsUnique.hpp>
+#include <StaticAssetCache.hpp>
 #include <UpdateChecker.hpp>
 
 #include "PluginConfig.hpp"
@@ -32,24 +37,67 @@ using namespace KaitoTokyo::LiveTranscribeFine;
 
 namespace {
 
+PluginConfig pluginConfig;
+std::shared_ptr<const KaitoTokyo::WebSocket::StaticAssetCache> overlayAssets;
 std::shared_future<std::string> latestVersionFuture;
+std::shared_ptr<RecognitionScheduler> recognitionScheduler;
 
-inline const ILogger &logger()
+// Large enough for a burst of a few thousand lines while OBS is busy writing its log file
+constexpr std::size_t logRingBytes = 256 * 1024;
+
+ObsLogger &obsLogger()
 {
-	static const ObsLogger instance("[" PLUGIN_NAME "] ");
+	static ObsLogger instance("[" PLUGIN_NAME "] ", logRingBytes);
 	return instance;
 }
 
+inline const ILogger &logger()
+{
+	return obsLogger();
+}
+
+std::shared_ptr<const KaitoTokyo::WebSocket::StaticAssetCache> loadOverlayAssets()
+try {
+	unique_bfree_char_t overlayPath = unique_obs_module_file("overlay");
+	if (!overlayPath) {
+		logger().warn("Caption overlay assets were not found");
+		return nullptr;
+	}
+	auto assets = std::make_shared<const KaitoTokyo::WebSocket::StaticAssetCache>(
+		KaitoTokyo::WebSocket::StaticAssetCache::loadDirectory(overlayPath.get(), "/overlay/"));
+	logger().info("Loaded {} caption overlay assets", assets->size());
+	return assets;
+} catch (const std::exception &e) {
+	logger().logException(e, "Failed to load caption overlay assets");
+	return nullptr;
+}
+
+std::size_t recognitionWorkerCount()
+{
+	if (pluginConfig.recognitionWorkerCount > 0) {
+		return static_cast<std::size_t>(pluginConfig.recognitionWorkerCount);
+	}
+	std::size_t workerCount = std::max(1u, std::thread::hardware_concurrency() / 2);
+	if (pluginConfig.cpuBudgetCores > 0.0) {
+		// More threads than cores in the budget would only contend with each other
+		workerCount = std::min(workerCount, static_cast<std::size_t>(std::ceil(pluginConfig.cpuBudgetCores)));
+	}
+	return workerCount;
+}
+
 } // namespace
 
 bool main_plugin_context_module_load()
 try {
 	curl_global_init(CURL_GLOBAL_DEFAULT);
-	latestVersionFuture =
-		std::async(std::launch::async, [] {
-			PluginConfig pluginConfig(PluginConfig::load());
-			return KaitoTokyo::UpdateChecker::fetchLatestVersion(pluginConfig.latestVersionURL);
-		}).share();
+	pluginConfig = PluginConfig::load();
+	obsLogger().setMinimumLevel(pluginConfig.logLevel);
+	overlayAssets = loadOverlayAssets();
+	recognitionScheduler = std::make_shared<RecognitionScheduler>(logger(), recognitionWorkerCount(),
+								      pluginConfig.cpuBudgetCores);
+	latestVersionFuture = std::async(std::launch::async, [latestVersionURL = pluginConfig.latestVersionURL] {
+				      return KaitoTokyo::UpdateChecker::fetchLatestVersion(latestVersionURL);
+			      }).share();
 	return true;
 } catch (const std::exception &e) {
 	logger().logException(e, "Failed to load main plugin context");
@@ -59,6 +107,13 @@ try {
 	return false;
 }
 
+void main_plugin_context_module_unload()
+{
+	// Filters hold their own reference, so the workers stop once the last one is destroyed
+	recognitionScheduler.reset();
+	obsLogger().shutdown();
+}
+
 const char *main_plugin_context_get_name(void *)
 {
 	return obs_module_text("pluginName");
@@ -66,7 +121,8 @@ const char *main_plugin_context_get_name(void *)
 
 void *main_plugin_context_create(obs_data_t *settings, obs_source_t *source)
 try {
-	auto self = std::make_shared<MainPluginContext>(settings, source, logger(), latestVersionFuture);
+	auto self = std::make_shared<MainPluginContext>(settings, source, logger(), pluginConfig, overlayAssets,
+							latestVersionFuture, recognitionScheduler);
 	return new std::shared_ptr<MainPluginContext>(self);
 } catch (const std::exception &e) {
 	logger().logException(e, "Failed to create main plugin context");
@@ -0,0 +1,64 @@
+/*
+Live Transcribe Fine
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <string_view>
+#include <system_error>
+
+namespace KaitoTokyo {
+namespace LiveTranscribeFine {
+
+/**
+ * @brief Resolves a model path requested by a control command, which must name a directory inside
+ * modelsDirectory.
+ *
+ * Relative paths are taken relative to modelsDirectory. Both paths are canonicalized first, so neither ".."
+ * nor a symbolic link can lead outside of it.
+ * @return The canonical model path, or std::nullopt if it is outside modelsDirectory or not a directory, or if
+ * no modelsDirectory is configured.
+ */
+inline std::optional<std::filesystem::path> resolveModelInDirectory(const std::filesystem::path &modelsDirectory,
+								    std::string_view requested)
+{
+	if (modelsDirectory.empty() || requested.empty()) {
+		return std::nullopt;
+	}
+	std::error_code ec;
+	const std::filesystem::path root = std::filesystem::canonical(modelsDirectory, ec);
+	if (ec) {
+		return std::nullopt;
+	}
+	const std::filesystem::path model = std::filesystem::canonical(root / std::filesystem::path(requested), ec);
+	if (ec || !std::filesystem::is_directory(model, ec) || model == root) {
+		return std::nullopt;
+	}
+	// model lies inside root if root is a prefix of it, component by component
+	auto modelPart = model.begin();
+	for (auto rootPart = root.begin(); rootPart != root.end(); ++rootPart, ++modelPart) {
+		if (modelPart == model.end() || *modelPart != *rootPart) {
+			return std::nullopt;
+		}
+	}
+	return model;
+}
+
+} // namespace LiveTranscribeFine
+} // namespace KaitoTokyo
@@ -19,9 +19,11 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #pragma once
 
 #include <string>
+#include <string_view>
 
 #include <obs-module.h>
 
+#include "../BridgeUtils/ILogger.hpp"
 #include "../BridgeUtils/ObsUnique.hpp"
 
 namespace KaitoTokyo {
@@ -30,6 +32,19 @@ namespace LiveTranscribeFine {
 struct PluginConfig {
 	std::string latestVersionURL = "https://kaito-tokyo.github.io/live-transcribe-fine/metadata/latest-version.txt";
 
+	// Seconds of client silence before a WebSocket connection is reaped. 0 keeps dead connections forever.
+	int webSocketIdleTimeoutSeconds = 120;
+	bool webSocketSendPingsAutomatically = true;
+
+	// Threads decoding audio for all filters together. 0 uses half of the hardware threads, within the CPU budget.
+	int recognitionWorkerCount = 0;
+
+	// CPU cores all recognition work may use together, so that it never starves the encoder. 0 is unlimited.
+	double cpuBudgetCores = 2.0;
+
+	// "debug", "info", "warn" or "error". Messages below it are discarded before being formatted.
+	BridgeUtils::ILogger::LogLevel logLevel = BridgeUtils::ILogger::LogLevel::Info;
+
 	static PluginConfig load()
 	{
 		using namespace KaitoTokyo::BridgeUtils;
@@ -47,8 +62,47 @@ struct PluginConfig {
 			pluginConfig.latestVersionURL = str;
 		}
 
+		if (obs_data_has_user_value(data.get(), "webSocketIdleTimeoutSeconds")) {
+			pluginConfig.webSocketIdleTimeoutSeconds =
+				static_cast<int>(obs_data_get_int(data.get(), "webSocketIdleTimeoutSeconds"));
+		}
+
+		if (obs_data_has_user_value(data.get(), "webSocketSendPingsAutomatically")) {
+			pluginConfig.webSocketSendPingsAutomatically =
+				obs_data_get_bool(data.get(), "webSocketSendPingsAutomatically");
+		}
+
+		if (obs_data_has_user_value(data.get(), "recognitionWorkerCount")) {
+			pluginConfig.recognitionWorkerCount =
+				static_cast<int>(obs_data_get_int(data.get(), "recognitionWorkerCount"));
+		}
+
+		if (obs_data_has_user_value(data.get(), "cpuBudgetCores")) {
+			pluginConfig.cpuBudgetCores = obs_data_get_double(data.get(), "cpuBudgetCores");
+		}
+
+		if (const char *str = obs_data_get_string(data.get(), "logLevel")) {
+			pluginConfig.logLevel = parseLogLevel(str, pluginConfig.logLevel);
+		}
+
 		return pluginConfig;
 	}
+
+	static BridgeUtils::ILogger::LogLevel parseLogLevel(std::string_view name,
+							    BridgeUtils::ILogger::LogLevel fallback) noexcept
+	{
+		using LogLevel = BridgeUtils::ILogger::LogLevel;
+		if (name == "debug") {
+			return LogLevel::Debug;
+		} else if (name == "info") {
+			return LogLevel::Info;
+		} else if (name == "warn") {
+			return LogLevel::Warn;
+		} else if (name == "error") {
+			return LogLevel::Error;
+		}
+		return fallback;
+	}
 };
 
 } // namespace LiveTranscribeFine
@@ -20,4 +20,14 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 struct PluginProperty {
 	std::string voskModelPath = "";
+	int webSocketPort = 0;
+	std::string unixSocketPath = "";
+	bool unixSocketLengthPrefixed = false;
+	std::string webSocketTlsCertFile = "";
+	std::string webSocketTlsKeyFile = "";
+	bool webSocketControlEnabled = false;
+	std::string controlModelsDirectory = "";
+	std::string sharedMemoryName = "";
+	std::string oscTarget = "";
+	std::string oscKeywords = "";
 };
@@ -18,28 +18,69 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include <ILogger.hpp>
 #include <ObsUnique.hpp>
 
 #include <vosk_api.h>
 
+#include "RecognitionScheduler.hpp"
+
 namespace KaitoTokyo {
 namespace LiveTranscribeFine {
 
 using UniqueVoskModel = std::unique_ptr<VoskModel, decltype(&vosk_model_free)>;
 using UniqueVoskRecognizer = std::unique_ptr<VoskRecognizer, decltype(&vosk_recognizer_free)>;
 
+/**
+ * @brief One Vosk recognizer fed from an audio filter.
+ *
+ * filterAudio only converts the audio and hands it to a RecognitionScheduler stream, so the OBS audio thread
+ * never waits for Vosk. Decoding, partial results and snapshots all happen on a scheduler worker.
+ */
 class RecognitionContext {
+public:
+	/**
+	 * @brief Receives a Vosk result JSON. isFinal is false for partial results and snapshots.
+	 * Called on a recognition worker thread.
+	 */
+	using ResultCallback = std::function<void(std::string_view resultJson, bool isFinal)>;
+
 private:
 	const BridgeUtils::ILogger &logger;
+	RecognitionScheduler &scheduler;
+	const ResultCallback onResult;
 	UniqueVoskModel voskModel;
 	UniqueVoskRecognizer voskRecognizer;
 
+	// Written from any thread, read by the worker. 0 disables partial results.
+	std::atomic<std::int64_t> partialIntervalNanoseconds{100'000'000};
+	std::atomic<bool> snapshotRequested{false};
+
+	// Only touched by the worker servicing the stream.
+	std::chrono::steady_clock::time_point lastPartialAt{};
+
+	// Only touched from the audio thread.
+	std::vector<std::int16_t> pcmBuffer;
+
+	// Registered last, so that the worker only ever sees a fully constructed context.
+	std::shared_ptr<RecognitionScheduler::Stream> stream;
+
 public:
-	RecognitionContext(const BridgeUtils::ILogger &_logger, const char *voskModelPath, float sampleRate)
+	RecognitionContext(const BridgeUtils::ILogger &_logger, RecognitionScheduler &_scheduler,
+			   std::string streamName, const char *voskModelPath, float sampleRate,
+			   ResultCallback _onResult)
 		: logger(_logger),
+		  scheduler(_scheduler),
+		  onResult(std::move(_onResult)),
 		  voskModel(
 			  [voskModelPath]() {
 				  VoskModel *voskModel = vosk_model_new(voskModelPath);
@@ -58,50 +99,95 @@ public:
 				  }
 				  return voskRecognizer;
 			  }(),
-			  vosk_recognizer_free)
+			  vosk_recognizer_free),
+		  stream(scheduler.addStream(std::move(streamName), sampleRate,
+					     [this](const std::int16_t *samples, std::size_t sampleCount) {
+						     decode(samples, sampleCount);
+					     }))
 	{
 	}
 
+	~RecognitionContext() noexcept { scheduler.removeStream(stream); }
+
+	RecognitionContext(const RecognitionContext &) = delete;
+	RecognitionContext &operator=(const RecognitionContext &) = delete;
+	RecognitionContext(RecognitionContext &&) = delete;
+	RecognitionContext &operator=(RecognitionContext &&) = delete;
+
 	obs_audio_data *filterAudio(obs_audio_data *audio)
 	{
 		if (!audio) {
-			logger.error("Invalid audio data");
+			BRIDGE_UTILS_LOG_RATE_LIMITED(logger, Error, "Invalid audio data");
 			return nullptr;
 		}
 
-		if (!voskModel) {
-			logger.error("Vosk model is not initialized");
-			return audio;
-		}
-
-		if (!voskRecognizer) {
-			logger.error("Vosk recognizer is not initialized");
-			return audio;
-		}
-
-		int sampleCount = audio->frames;
+		const std::size_t sampleCount = audio->frames;
 		const float *pcm_float = reinterpret_cast<const float *>(audio->data[0]);
-		std::vector<int16_t> pcm_int16(sampleCount);
-		for (int i = 0; i < sampleCount; ++i) {
+		pcmBuffer.resize(sampleCount);
+		for (std::size_t i = 0; i < sampleCount; ++i) {
 			float sample = pcm_float[i];
 			if (sample > 1.0f)
 				sample = 1.0f;
 			if (sample < -1.0f)
 				sample = -1.0f;
-			pcm_int16[i] = static_cast<int16_t>(sample * 32767.0f);
+			pcmBuffer[i] = static_cast<int16_t>(sample * 32767.0f);
 		}
 
-		int accept_result =
-			vosk_recognizer_accept_waveform_s(voskRecognizer.get(), pcm_int16.data(), sampleCount);
-		const char *result_json = nullptr;
-		if (accept_result) {
-			result_json = vosk_recognizer_result(voskRecognizer.get());
-			logger.info("Vosk transcription result: {}", result_json);
-		} else {
-			result_json = vosk_recognizer_partial_result(voskRecognizer.get());
-		}
+		stream->write(pcmBuffer.data(), sampleCount);
 		return audio;
 	}
+
+	/**
+	 * @brief Limits how many partial results are produced per second.
+	 * @param partialRate Partial results per second. 0 disables partial results.
+	 */
+	void setPartialRate(double partialRate)
+	{
+		partialIntervalNanoseconds.store(partialRate > 0.0 ? static_cast<std::int64_t>(1e9 / partialRate) : 0);
+	}
+
+	/**
+	 * @brief Publishes the current partial result soon, regardless of the partial rate.
+	 */
+	void publishSnapshot()
+	{
+		snapshotRequested.store(true);
+		stream->requestService();
+	}
+
+	/**
+	 * @brief How far recognition is behind real time.
+	 */
+	double lagSeconds() const noexcept { return stream->lagSeconds(); }
+
+private:
+	void decode(const std::int16_t *samples, std::size_t sampleCount)
+	{
+		// Partial results and snapshots are optional, so they are the first to go when over the CPU budget
+		const CpuBudgetState budgetState = scheduler.cpuBudgetState();
+
+		if (sampleCount > 0) {
+			int accept_result = vosk_recognizer_accept_waveform_s(voskRecognizer.get(), samples,
+									     static_cast<int>(sampleCount));
+			if (accept_result) {
+				const char *result_json = vosk_recognizer_result(voskRecognizer.get());
+				logger.info("Vosk transcription result: {}", result_json);
+				onResult(result_json, true);
+			} else if (const std::int64_t interval = partialIntervalNanoseconds.load();
+				   interval > 0 && budgetState < CpuBudgetState::PartialsSuspended) {
+				// Building a partial result is costly, so only do it as often as consumers asked for.
+				const auto now = std::chrono::steady_clock::now();
+				if (now - lastPartialAt >= std::chrono::nanoseconds(interval)) {
+					lastPartialAt = now;
+					onResult(vosk_recognizer_partial_result(voskRecognizer.get()), false);
+				}
+			}
+		}
+
+		if (snapshotRequested.exchange(false) && budgetState < CpuBudgetState::SnapshotsSuspended) {
+			onResult(vosk_recognizer_partial_result(voskRecognizer.get()), false);
+		}
+	}
 };
 
 } // namespace LiveTranscribeFine
@@ -0,0 +1,406 @@
+/*
+Live Transcribe Fine
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <ILogger.hpp>
+
+#include "CpuBudgetGovernor.hpp"
+
+namespace KaitoTokyo {
+namespace LiveTranscribeFine {
+
+/**
+ * @brief Decodes the audio of all recognition contexts on one fixed pool of worker threads.
+ *
+ * Each context owns a Stream, a lock-free ring that the audio thread fills. Streams with pending audio wait in
+ * a run queue and are serviced in deficit round robin: every turn grants a stream one quantum of audio time,
+ * so a busy microphone cannot starve the others however many filters there are. A stream is only ever
+ * serviced by one worker at a time, so its consumer may use a non-thread-safe recognizer.
+ *
+ * When a stream's backlog exceeds the lag threshold, i.e. it falls behind real time, a warning is logged.
+ *
+ * The workers report their thread CPU time to a CpuBudgetGovernor. Consumers read cpuBudgetState() to drop
+ * optional work, and at the harshest state the workers pause once the budget is spent and skip stale audio.
+ * While throttled, idle workers still close the governor's windows on time so that the state relaxes.
+ */
+class RecognitionScheduler {
+public:
+	/**
+	 * @brief Receives a slice of audio on a worker thread. Called with no samples when a service was requested.
+	 */
+	using Consumer = std::function<void(const std::int16_t *samples, std::size_t sampleCount)>;
+
+	class Stream {
+	public:
+		/**
+		 * @brief Appends audio and schedules the stream. Must only be called from one producer thread.
+		 * @return False if the ring was full and some samples were dropped.
+		 */
+		bool write(const std::int16_t *samples, std::size_t sampleCount)
+		{
+			const std::size_t writePosition = writeCount.load(std::memory_order_relaxed);
+			const std::size_t used = writePosition - readCount.load(std::memory_order_acquire);
+			const std::size_t accepted = std::min(sampleCount, capacity - used);
+			const std::size_t offset = writePosition % capacity;
+			const std::size_t first = std::min(accepted, capacity - offset);
+			std::memcpy(buffer.get() + offset, samples, first * sizeof(std::int16_t));
+			std::memcpy(buffer.get(), samples + first, (accepted - first) * sizeof(std::int16_t));
+			writeCount.store(writePosition + accepted, std::memory_order_release);
+
+			if (accepted < sampleCount) {
+				dropped.fetch_add(sampleCount - accepted, std::memory_order_relaxed);
+			}
+			scheduler.schedule(self.lock());
+			return accepted == sampleCount;
+		}
+
+		/**
+		 * @brief Asks for the consumer to be called soon even if no audio is pending.
+		 */
+		void requestService()
+		{
+			serviceRequested.store(true, std::memory_order_release);
+			scheduler.schedule(self.lock());
+		}
+
+		/**
+		 * @brief How far decoding is behind real time. Safe to call from any thread.
+		 */
+		double lagSeconds() const noexcept { return static_cast<double>(pending()) / sampleRate; }
+
+		std::uint64_t droppedSamples() const noexcept { return dropped.load(std::memory_order_relaxed); }
+
+		const std::string &name() const noexcept { return streamName; }
+
+	private:
+		friend class RecognitionScheduler;
+
+		Stream(RecognitionScheduler &_scheduler, std::string _name, double _sampleRate, Consumer _consumer)
+			: scheduler(_scheduler),
+			  streamName(std::move(_name)),
+			  sampleRate(_sampleRate),
+			  quantum(static_cast<std::size_t>(std::max(
+				  1.0, _sampleRate * std::chrono::duration<double>(_scheduler.quantum).count()))),
+			  capacity(static_cast<std::size_t>(std::max(1.0, _sampleRate * ringSeconds))),
+			  buffer(std::make_unique<std::int16_t[]>(capacity)),
+			  consumer(std::move(_consumer))
+		{
+		}
+
+		std::size_t pending() const noexcept
+		{
+			return writeCount.load(std::memory_order_acquire) - readCount.load(std::memory_order_acquire);
+		}
+
+		std::size_t read(std::int16_t *samples, std::size_t maxCount)
+		{
+			const std::size_t readPosition = readCount.load(std::memory_order_relaxed);
+			const std::size_t count =
+				std::min(maxCount, writeCount.load(std::memory_order_acquire) - readPosition);
+			const std::size_t offset = readPosition % capacity;
+			const std::size_t first = std::min(count, capacity - offset);
+			std::memcpy(samples, buffer.get() + offset, first * sizeof(std::int16_t));
+			std::memcpy(samples + first, buffer.get(), (count - first) * sizeof(std::int16_t));
+			readCount.store(readPosition + count, std::memory_order_release);
+			return count;
+		}
+
+		static constexpr double ringSeconds = 10.0;
+
+		RecognitionScheduler &scheduler;
+		std::weak_ptr<Stream> self;
+		const std::string streamName;
+		const double sampleRate;
+		const std::size_t quantum; ///< Samples granted per turn.
+		const std::size_t capacity;
+		const std::unique_ptr<std::int16_t[]> buffer;
+		const Consumer consumer;
+
+		alignas(64) std::atomic<std::size_t> writeCount{0};
+		std::atomic<std::uint64_t> dropped{0};
+		alignas(64) std::atomic<std::size_t> readCount{0};
+		std::atomic<bool> queued{false}; ///< In the run queue or being serviced.
+		std::atomic<bool> serviceRequested{false};
+		std::atomic<bool> closed{false};
+
+		// Only touched by the worker servicing the stream.
+		std::mutex servicing;
+		std::size_t deficit = 0;
+		bool lagging = false;
+	};
+
+	/**
+	 * @brief Constructor. Starts the worker threads.
+	 * @param workerCount The number of decode threads. At least 1.
+	 * @param cpuBudgetCores The CPU share the workers may use together, e.g. 2.0 for two cores. 0 is unlimited.
+	 * @param _quantum Audio time granted to a stream per turn.
+	 * @param _lagThresholdSeconds Backlog above which a stream is reported as falling behind.
+	 */
+	RecognitionScheduler(const BridgeUtils::ILogger &_logger, std::size_t workerCount, double cpuBudgetCores = 0.0,
+			     std::chrono::milliseconds _quantum = std::chrono::milliseconds(100),
+			     double _lagThresholdSeconds = 1.0)
+		: logger(_logger),
+		  quantum(_quantum),
+		  lagThresholdSeconds(_lagThresholdSeconds),
+		  governor(_logger, cpuBudgetCores)
+	{
+		workerCount = std::max<std::size_t>(workerCount, 1);
+		for (std::size_t i = 0; i < workerCount; ++i) {
+			workers.emplace_back(&RecognitionScheduler::workerLoop, this);
+		}
+		logger.info("Recognition scheduler started with {} workers and a CPU budget of {:.2f} cores",
+			    workerCount, cpuBudgetCores);
+	}
+
+	~RecognitionScheduler()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			stopped = true;
+		}
+		cond.notify_all();
+		for (std::thread &worker : workers) {
+			worker.join();
+		}
+	}
+
+	RecognitionScheduler(const RecognitionScheduler &) = delete;
+	RecognitionScheduler &operator=(const RecognitionScheduler &) = delete;
+	RecognitionScheduler(RecognitionScheduler &&) = delete;
+	RecognitionScheduler &operator=(RecognitionScheduler &&) = delete;
+
+	std::size_t workerCount() const noexcept { return workers.size(); }
+
+	CpuBudgetState cpuBudgetState() const noexcept { return governor.state(); }
+
+	CpuBudgetSnapshot cpuBudget() const noexcept { return governor.snapshot(); }
+
+	/**
+	 * @brief Registers a stream. It must be removed with removeStream before the consumer becomes invalid.
+	 */
+	std::shared_ptr<Stream> addStream(std::string name, double sampleRate, Consumer consumer)
+	{
+		std::shared_ptr<Stream> stream(new Stream(*this, std::move(name), sampleRate, std::move(consumer)));
+		stream->self = stream;
+		return stream;
+	}
+
+	/**
+	 * @brief Stops servicing a stream, waiting for a slice in progress to finish.
+	 * The consumer is never called again afterwards, and audio still pending is discarded.
+	 */
+	void removeStream(const std::shared_ptr<Stream> &stream)
+	{
+		if (!stream) {
+			return;
+		}
+		stream->closed.store(true);
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			runQueue.erase(std::remove(runQueue.begin(), runQueue.end(), stream), runQueue.end());
+		}
+		std::lock_guard<std::mutex> lock(stream->servicing);
+		discardPending(*stream);
+	}
+
+private:
+	void schedule(std::shared_ptr<Stream> stream)
+	{
+		if (!stream || stream->closed.load() || stream->queued.exchange(true, std::memory_order_acq_rel)) {
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			runQueue.push_back(std::move(stream));
+		}
+		cond.notify_one();
+	}
+
+	void workerLoop()
+	{
+		std::vector<std::int16_t> samples(4096);
+		std::chrono::nanoseconds cpuTime = currentThreadCpuTime();
+		while (true) {
+			std::shared_ptr<Stream> stream;
+			{
+				std::unique_lock<std::mutex> lock(mtx);
+				while (!stopped && runQueue.empty()) {
+					if (governor.state() == CpuBudgetState::WithinBudget) {
+						cond.wait(lock);
+						continue;
+					}
+					// Nobody services a stream while idle, so close the governor's windows here
+					// and let the state relax without waiting for audio
+					if (cond.wait_until(lock, governor.windowEnd()) == std::cv_status::timeout) {
+						lock.unlock();
+						governor.evaluate(CpuBudgetGovernor::Clock::now());
+						lock.lock();
+					}
+				}
+				if (stopped) {
+					return;
+				}
+				if (governor.exhausted()) {
+					cond.wait_until(lock, governor.windowEnd(), [this] { return stopped; });
+					lock.unlock();
+					governor.evaluate(CpuBudgetGovernor::Clock::now());
+					continue;
+				}
+				stream = std::move(runQueue.front());
+				runQueue.pop_front();
+			}
+
+			const bool hasMore = service(*stream, samples);
+
+			const std::chrono::nanoseconds newCpuTime = currentThreadCpuTime();
+			governor.addCpuTime(newCpuTime - cpuTime);
+			cpuTime = newCpuTime;
+			governor.evaluate(CpuBudgetGovernor::Clock::now());
+
+			if (hasMore) {
+				std::lock_guard<std::mutex> lock(mtx);
+				runQueue.push_back(std::move(stream));
+				continue;
+			}
+
+			// Leave the run queue, unless audio arrived while we were deciding to.
+			// Closed streams never return.
+			stream->queued.store(false, std::memory_order_seq_cst);
+			if (!stream->closed.load() && (stream->pending() > 0 || stream->serviceRequested.load())) {
+				schedule(std::move(stream));
+			}
+		}
+	}
+
+	/**
+	 * @brief Gives a stream its turn. Returns true if it still has audio pending afterwards.
+	 */
+	bool service(Stream &stream, std::vector<std::int16_t> &samples)
+	{
+		std::lock_guard<std::mutex> lock(stream.servicing);
+		if (stream.closed.load()) {
+			discardPending(stream);
+			return false;
+		}
+
+		if (governor.state() == CpuBudgetState::SheddingAudio) {
+			skipStaleAudio(stream);
+		}
+
+		stream.deficit += stream.quantum;
+		bool consumed = false;
+		while (stream.deficit > 0) {
+			const std::size_t count = stream.read(samples.data(), std::min(stream.deficit, samples.size()));
+			if (count == 0) {
+				break;
+			}
+			stream.deficit -= count;
+			consumed = true;
+			consume(stream, samples.data(), count);
+		}
+		if (stream.serviceRequested.exchange(false) && !consumed) {
+			consume(stream, nullptr, 0);
+		}
+
+		const bool hasMore = stream.pending() > 0;
+		if (!hasMore) {
+			// An idle stream must not bank credit for later bursts
+			stream.deficit = 0;
+		}
+		reportLag(stream);
+		return hasMore;
+	}
+
+	/**
+	 * @brief Drops all pending audio and service requests of a closed stream. Called with its servicing lock held.
+	 */
+	static void discardPending(Stream &stream) noexcept
+	{
+		stream.readCount.store(stream.writeCount.load(std::memory_order_acquire), std::memory_order_release);
+		stream.serviceRequested.store(false, std::memory_order_relaxed);
+		stream.deficit = 0;
+	}
+
+	/**
+	 * @brief Drops the oldest audio so that the backlog is no longer than the lag threshold.
+	 */
+	void skipStaleAudio(Stream &stream)
+	{
+		const auto keep = static_cast<std::size_t>(lagThresholdSeconds * stream.sampleRate);
+		const std::size_t pending = stream.pending();
+		if (pending > keep) {
+			stream.readCount.fetch_add(pending - keep, std::memory_order_release);
+			stream.dropped.fetch_add(pending - keep, std::memory_order_relaxed);
+		}
+	}
+
+	void consume(Stream &stream, const std::int16_t *samples, std::size_t count)
+	{
+		try {
+			stream.consumer(samples, count);
+		} catch (const std::exception &e) {
+			BRIDGE_UTILS_LOG_RATE_LIMITED(logger, Error, "Recognition of {} failed: {}", stream.name(),
+						      e.what());
+		} catch (...) {
+			BRIDGE_UTILS_LOG_RATE_LIMITED(logger, Error, "Recognition of {} failed: unknown error",
+						      stream.name());
+		}
+	}
+
+	void reportLag(Stream &stream)
+	{
+		const double lag = stream.lagSeconds();
+		if (!stream.lagging && lag > lagThresholdSeconds) {
+			stream.lagging = true;
+			logger.warn("Recognition of {} is {:.1f}s behind real time ({} samples dropped so far)",
+				    stream.name(), lag, stream.droppedSamples());
+		} else if (stream.lagging && lag < lagThresholdSeconds / 2) {
+			stream.lagging = false;
+			logger.info("Recognition of {} caught up with real time", stream.name());
+		}
+	}
+
+	const BridgeUtils::ILogger &logger;
+	const std::chrono::milliseconds quantum;
+	const double lagThresholdSeconds;
+	CpuBudgetGovernor governor;
+	std::mutex mtx;
+	std::condition_variable cond;
+	std::deque<std::shared_ptr<Stream>> runQueue;
+	bool stopped = false;
+	std::vector<std::thread> workers;
+};
+
+} // namespace LiveTranscribeFine
+} // namespace KaitoTokyo
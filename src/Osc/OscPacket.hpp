@@ -0,0 +1,79 @@
+/*
+OSC Sink
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+
+namespace KaitoTokyo {
+namespace Osc {
+
+/**
+ * @brief A single OSC 1.0 message encoded into a fixed-size datagram buffer.
+ *
+ * Packets never allocate, so they can be built on the audio thread and handed over by value.
+ */
+struct OscPacket {
+	/// Largest UDP payload that fits into a 1500-byte Ethernet frame without IP fragmentation.
+	static constexpr std::size_t capacity = 1472;
+
+	std::array<char, capacity> data;
+	std::size_t size = 0;
+
+	/**
+	 * @brief Encodes a message with a single string argument, i.e. type tag ",s".
+	 *
+	 * The argument is truncated at a UTF-8 character boundary if the message would not fit.
+	 * @param address The OSC address pattern, e.g. "/transcript/final". Must be short.
+	 */
+	static OscPacket withString(std::string_view address, std::string_view argument) noexcept
+	{
+		OscPacket packet;
+		packet.appendString(address);
+		packet.appendString(",s");
+
+		const std::size_t room = capacity - packet.size;
+		// A string takes its bytes, a terminating NUL and padding to a multiple of four
+		std::size_t length = std::min(argument.size(), (room & ~std::size_t{3}) - 1);
+		if (length < argument.size()) {
+			while (length > 0 && (static_cast<unsigned char>(argument[length]) & 0xc0) == 0x80) {
+				--length;
+			}
+		}
+		packet.appendString(argument.substr(0, length));
+		return packet;
+	}
+
+	std::string_view view() const noexcept { return {data.data(), size}; }
+
+private:
+	void appendString(std::string_view text) noexcept
+	{
+		const std::size_t padded = (text.size() + 4) & ~std::size_t{3};
+		std::memcpy(data.data() + size, text.data(), text.size());
+		std::memset(data.data() + size + text.size(), 0, padded - text.size());
+		size += padded;
+	}
+};
+
+} // namespace Osc
+} // namespace KaitoTokyo
@@ -0,0 +1,434 @@
+/*
+OSC Sink
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef _WIN32
+
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string_view>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <ILogger.hpp>
+#include <SpscQueue.hpp>
+
+#include "OscPacket.hpp"
+
+namespace KaitoTokyo {
+namespace Osc {
+
+/**
+ * @brief Finds configured keywords in recognized text, firing each at most once per utterance.
+ *
+ * Keywords are matched case-insensitively (ASCII) as whole words. Partial results fire as soon as
+ * a keyword appears, so triggers do not wait for the utterance to be finalized.
+ */
+class KeywordSpotter {
+public:
+	/**
+	 * @param keywords Comma-separated keywords, e.g. "cue, blackout".
+	 */
+	explicit KeywordSpotter(std::string_view keywords)
+	{
+		while (!keywords.empty()) {
+			const std::size_t comma = keywords.find(',');
+			std::string keyword = lower(trim(keywords.substr(0, comma)));
+			if (!keyword.empty()) {
+				keywords_.push_back(std::move(keyword));
+			}
+			keywords = comma == std::string_view::npos ? std::string_view{} : keywords.substr(comma + 1);
+		}
+		fired_.assign(keywords_.size(), false);
+	}
+
+	bool empty() const noexcept { return keywords_.empty(); }
+
+	/**
+	 * @brief Calls onKeyword for every keyword in the text that has not fired in this utterance yet.
+	 * @param endOfUtterance True for final results; the next call starts a new utterance.
+	 */
+	template<typename Callback> void scan(std::string_view text, bool endOfUtterance, Callback &&onKeyword)
+	{
+		for (std::size_t i = 0; i < keywords_.size(); ++i) {
+			if (!fired_[i] && containsWord(text, keywords_[i])) {
+				fired_[i] = true;
+				onKeyword(keywords_[i]);
+			}
+		}
+		if (endOfUtterance) {
+			fired_.assign(keywords_.size(), false);
+		}
+	}
+
+private:
+	std::vector<std::string> keywords_;
+	std::vector<bool> fired_;
+
+	static std::string_view trim(std::string_view text) noexcept
+	{
+		const std::size_t first = text.find_first_not_of(" \t");
+		if (first == std::string_view::npos) {
+			return {};
+		}
+		return text.substr(first, text.find_last_not_of(" \t") - first + 1);
+	}
+
+	static std::string lower(std::string_view text)
+	{
+		std::string result(text);
+		for (char &c : result) {
+			c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+		}
+		return result;
+	}
+
+	static bool isWordByte(char c) noexcept
+	{
+		const auto byte = static_cast<unsigned char>(c);
+		return byte >= 0x80 || std::isalnum(byte);
+	}
+
+	static bool containsWord(std::string_view text, std::string_view keyword) noexcept
+	{
+		for (std::size_t pos = 0; pos + keyword.size() <= text.size(); ++pos) {
+			std::size_t i = 0;
+			while (i < keyword.size() &&
+			       std::tolower(static_cast<unsigned char>(text[pos + i])) ==
+				       static_cast<unsigned char>(keyword[i])) {
+				++i;
+			}
+			if (i == keyword.size() && (pos == 0 || !isWordByte(text[pos - 1])) &&
+			    (pos + i == text.size() || !isWordByte(text[pos + i]))) {
+				return true;
+			}
+		}
+		return false;
+	}
+};
+
+/**
+ * @class OscSink
+ * @brief Sends finalized segments and keyword triggers as OSC messages over UDP.
+ *
+ * Messages:
+ *  - /transcript/final ,s <text>   for every final result
+ *  - /transcript/keyword ,s <word> when a configured keyword is recognized
+ *
+ * The destination may be a unicast or multicast address. The results thread only encodes
+ * messages into preallocated packets and hands them over through a lock-free queue; a dedicated
+ * sender thread transmits everything that accumulated with one non-blocking sendmmsg call.
+ * The sender is only woken up through its pipe when it is actually sleeping.
+ *
+ * @note publishPartial and publishFinal must be called from a single thread. Only available on POSIX systems.
+ */
+class OscSink {
+public:
+	static constexpr const char *finalAddress = "/transcript/final";
+	static constexpr const char *keywordAddress = "/transcript/keyword";
+
+	/**
+     * @brief Constructor. Does not open the socket yet.
+     * @param logger Reference to the logger implementation.
+     * @param target Destination as "host:port", "[ipv6]:port" or a multicast group such as "239.0.0.1:9000".
+     * @param keywords Comma-separated keywords that trigger /transcript/keyword.
+     */
+	OscSink(const BridgeUtils::ILogger &logger, std::string target, std::string_view keywords)
+		: logger_(logger),
+		  target_(std::move(target)),
+		  keywordSpotter_(keywords)
+	{
+	}
+
+	~OscSink() { stop(); }
+
+	OscSink(const OscSink &) = delete;
+	OscSink &operator=(const OscSink &) = delete;
+	OscSink(OscSink &&) = delete;
+	OscSink &operator=(OscSink &&) = delete;
+
+	/**
+     * @brief Resolves the target, opens the socket and starts the sender thread.
+     * @return True if the sink is ready to send.
+     */
+	bool start()
+	{
+		std::string host = target_;
+		std::string port;
+		const std::size_t colon = target_.rfind(':');
+		if (colon != std::string::npos) {
+			host = target_.substr(0, colon);
+			port = target_.substr(colon + 1);
+		}
+		if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+			host = host.substr(1, host.size() - 2);
+		}
+		if (host.empty() || port.empty()) {
+			logger_.error("Invalid OSC target '{}', expected host:port", target_);
+			return false;
+		}
+
+		addrinfo hints{};
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_DGRAM;
+		hints.ai_flags = AI_NUMERICSERV;
+		addrinfo *result = nullptr;
+		if (const int error = ::getaddrinfo(host.c_str(), port.c_str(), &hints, &result); error != 0) {
+			logger_.error("Failed to resolve OSC target '{}': {}", target_, ::gai_strerror(error));
+			return false;
+		}
+		std::memcpy(&address_, result->ai_addr, result->ai_addrlen);
+		addressLength_ = result->ai_addrlen;
+		fd_ = ::socket(result->ai_family, SOCK_DGRAM, 0);
+		::freeaddrinfo(result);
+		if (fd_ < 0) {
+			logger_.error("Failed to create OSC socket: {}", std::strerror(errno));
+			return false;
+		}
+		setNonBlocking(fd_);
+		configureMulticast();
+
+		int pipeFds[2];
+		if (::pipe(pipeFds) != 0) {
+			logger_.error("Failed to create wake-up pipe for OSC sink: {}", std::strerror(errno));
+			closeFds();
+			return false;
+		}
+		wakeReadFd_ = pipeFds[0];
+		wakeWriteFd_ = pipeFds[1];
+		setNonBlocking(wakeReadFd_);
+		setNonBlocking(wakeWriteFd_);
+
+		running_ = true;
+		thread_ = std::thread(&OscSink::sendLoop, this);
+		logger_.info("Sending OSC to '{}'{}.", target_, keywordSpotter_.empty() ? "" : " with keyword triggers");
+		return true;
+	}
+
+	/**
+     * @brief Stops the sender thread after it has sent what is already queued.
+     */
+	void stop()
+	{
+		if (!running_.exchange(false)) {
+			return;
+		}
+		wake();
+		if (thread_.joinable()) {
+			thread_.join();
+		}
+		closeFds();
+		logger_.info("OSC sink for '{}' stopped after {} datagrams ({} dropped).", target_, sent_.load(),
+			     dropped_.load());
+	}
+
+	/**
+     * @brief Fires keyword triggers found in a partial result.
+     */
+	void publishPartial(std::string_view text)
+	{
+		keywordSpotter_.scan(text, false, [this](std::string_view keyword) {
+			enqueue(OscPacket::withString(keywordAddress, keyword));
+		});
+		notify();
+	}
+
+	/**
+     * @brief Sends a final result, preceded by any keyword triggers not fired by its partials.
+     */
+	void publishFinal(std::string_view text)
+	{
+		keywordSpotter_.scan(text, true, [this](std::string_view keyword) {
+			enqueue(OscPacket::withString(keywordAddress, keyword));
+		});
+		if (!text.empty()) {
+			enqueue(OscPacket::withString(finalAddress, text));
+		}
+		notify();
+	}
+
+	bool hasKeywords() const noexcept { return !keywordSpotter_.empty(); }
+	std::uint64_t sent() const noexcept { return sent_; }
+	std::uint64_t dropped() const noexcept { return dropped_; }
+
+private:
+	static constexpr std::size_t queueCapacity = 256;
+	static constexpr std::size_t maxBatch = 32;
+
+	static void setNonBlocking(int fd) { ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL, 0) | O_NONBLOCK); }
+
+	void configureMulticast()
+	{
+		// Keep multicast datagrams on the local link instead of relying on the system default hop limit.
+		if (address_.ss_family == AF_INET) {
+			const auto &ipv4 = reinterpret_cast<const sockaddr_in &>(address_);
+			if (IN_MULTICAST(ntohl(ipv4.sin_addr.s_addr))) {
+				const unsigned char ttl = 1;
+				::setsockopt(fd_, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+			}
+		} else if (address_.ss_family == AF_INET6) {
+			const auto &ipv6 = reinterpret_cast<const sockaddr_in6 &>(address_);
+			if (IN6_IS_ADDR_MULTICAST(&ipv6.sin6_addr)) {
+				const int hops = 1;
+				::setsockopt(fd_, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &hops, sizeof(hops));
+			}
+		}
+	}
+
+	void enqueue(OscPacket &&packet)
+	{
+		if (!queue_.tryPush(std::move(packet))) {
+			++dropped_;
+		}
+	}
+
+	void notify()
+	{
+		// Pairs with the fence in sendLoop: either the sender sees the new packets or we see it sleeping.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (sleeping_.load(std::memory_order_relaxed) && sleeping_.exchange(false)) {
+			wake();
+		}
+	}
+
+	void wake()
+	{
+		const char byte = 0;
+		// A full pipe already guarantees a pending wake-up, so the result can be ignored.
+		[[maybe_unused]] ssize_t result = ::write(wakeWriteFd_, &byte, 1);
+	}
+
+	void closeFds()
+	{
+		for (int *fd : {&fd_, &wakeReadFd_, &wakeWriteFd_}) {
+			if (*fd >= 0) {
+				::close(*fd);
+				*fd = -1;
+			}
+		}
+	}
+
+	void sendLoop()
+	{
+		while (true) {
+			std::size_t count = 0;
+			while (count < maxBatch) {
+				std::optional<OscPacket> packet = queue_.tryPop();
+				if (!packet) {
+					break;
+				}
+				batch_[count++] = *packet;
+			}
+			if (count > 0) {
+				sendBatch(count);
+				continue;
+			}
+			if (!running_) {
+				break;
+			}
+
+			sleeping_.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (queue_.empty() && running_) {
+				pollfd wakeFd{wakeReadFd_, POLLIN, 0};
+				::poll(&wakeFd, 1, -1);
+				char drain[64];
+				while (::read(wakeReadFd_, drain, sizeof(drain)) > 0) {
+				}
+			}
+			sleeping_.store(false, std::memory_order_relaxed);
+		}
+	}
+
+	void sendBatch(std::size_t count)
+	{
+		std::size_t offset = 0;
+#ifdef __linux__
+		std::array<mmsghdr, maxBatch> messages{};
+		std::array<iovec, maxBatch> iov{};
+		for (std::size_t i = 0; i < count; ++i) {
+			iov[i] = {batch_[i].data.data(), batch_[i].size};
+			messages[i].msg_hdr.msg_name = &address_;
+			messages[i].msg_hdr.msg_namelen = addressLength_;
+			messages[i].msg_hdr.msg_iov = &iov[i];
+			messages[i].msg_hdr.msg_iovlen = 1;
+		}
+		while (offset < count) {
+			const int result = ::sendmmsg(fd_, messages.data() + offset, static_cast<unsigned int>(count - offset),
+						      MSG_DONTWAIT);
+			if (result < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				break;
+			}
+			offset += static_cast<std::size_t>(result);
+		}
+#else
+		for (; offset < count; ++offset) {
+			if (::sendto(fd_, batch_[offset].data.data(), batch_[offset].size, 0,
+				     reinterpret_cast<const sockaddr *>(&address_), addressLength_) < 0) {
+				break;
+			}
+		}
+#endif
+		sent_ += offset;
+		if (offset < count) {
+			// UDP gives no delivery guarantee anyway; a full socket buffer means the packets are stale.
+			dropped_ += count - offset;
+		}
+	}
+
+	const BridgeUtils::ILogger &logger_;
+	const std::string target_;
+	KeywordSpotter keywordSpotter_; ///< Producer thread only.
+
+	sockaddr_storage address_{};
+	socklen_t addressLength_ = 0;
+	int fd_ = -1;
+	int wakeReadFd_ = -1;
+	int wakeWriteFd_ = -1;
+
+	std::atomic<bool> running_{false};
+	std::atomic<bool> sleeping_{false};
+	std::thread thread_;
+	BridgeUtils::SpscQueue<OscPacket> queue_{queueCapacity};
+	std::array<OscPacket, maxBatch> batch_; ///< Sender thread only.
+
+	std::atomic<std::uint64_t> sent_{0};
+	std::atomic<std::uint64_t> dropped_{0};
+};
+
+} // namespace Osc
+} // namespace KaitoTokyo
+
+#endif // _WIN32
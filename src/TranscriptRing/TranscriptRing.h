@@ -0,0 +1,156 @@
+/*
+Transcript Ring
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file TranscriptRing.h
+ * @brief Shared-memory layout and C reader API of the transcript ring.
+ *
+ * The plugin is the single writer of a POSIX shared-memory object holding a fixed number of
+ * fixed-size slots. Every slot is guarded by a sequence lock, so any number of readers can copy
+ * messages out without taking locks or making system calls. The writer never waits for readers;
+ * a reader that falls more than a ring behind skips ahead and counts the messages it lost.
+ *
+ * A reader that has consumed everything can block in transcript_ring_wait(), which sleeps on a
+ * futex in the shared header on Linux and polls elsewhere. The writer only issues a wake-up
+ * system call while somebody is actually sleeping.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TRANSCRIPT_RING_MAGIC 0x474e5254u /* "TRNG" */
+#define TRANSCRIPT_RING_VERSION 1u
+
+/** @brief Topic of a message, matching the topics of the WebSocket server. */
+enum transcript_ring_topic {
+	TRANSCRIPT_RING_TOPIC_FINAL = 1,
+	TRANSCRIPT_RING_TOPIC_PARTIAL = 2,
+};
+
+/** @brief Results of transcript_ring_read() and transcript_ring_wait(). */
+enum transcript_ring_status {
+	TRANSCRIPT_RING_OK = 0,
+	TRANSCRIPT_RING_EMPTY = 1,
+	TRANSCRIPT_RING_TIMEOUT = 2,
+	TRANSCRIPT_RING_BUFFER_TOO_SMALL = -1,
+	TRANSCRIPT_RING_CLOSED = -2,
+};
+
+/*
+ * Shared layout. All fields written after initialization are accessed with the __atomic
+ * builtins from both the C reader and the C++ writer, so plain integer types are used here to
+ * keep the layout identical between the two languages.
+ */
+
+/** @brief Header at offset 0 of the shared-memory object. */
+struct transcript_ring_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t slot_count;   /**< Number of slots, a power of two. */
+	uint32_t slot_payload; /**< Payload capacity of a slot in bytes. */
+	uint32_t closed;       /**< Set to 1 when the writer goes away. */
+	uint32_t reserved0;
+	uint64_t reserved1;
+
+	uint64_t write_seq __attribute__((aligned(64))); /**< Sequence number of the next message. */
+
+	uint32_t futex_word __attribute__((aligned(64))); /**< Bumped on every publish. */
+	uint32_t waiters;                                 /**< Readers sleeping on futex_word. */
+};
+
+/** @brief A slot, followed immediately by slot_payload bytes of payload. */
+struct transcript_ring_slot {
+	uint64_t lock; /**< Sequence lock: odd while the writer is inside the slot. */
+	uint64_t seq;  /**< Sequence number of the message held in the slot. */
+	uint32_t topic;
+	uint32_t length;
+	uint64_t timestamp_ns; /**< CLOCK_REALTIME of the publish. */
+};
+
+/** @brief Distance in bytes between two consecutive slots. */
+static inline size_t transcript_ring_slot_stride(uint32_t slot_payload)
+{
+	return (sizeof(struct transcript_ring_slot) + slot_payload + 63u) & ~(size_t)63u;
+}
+
+/** @brief Offset of the first slot from the start of the shared-memory object. */
+static inline size_t transcript_ring_slots_offset(void)
+{
+	return (sizeof(struct transcript_ring_header) + 63u) & ~(size_t)63u;
+}
+
+/** @brief Total size of a ring with the given geometry. */
+static inline size_t transcript_ring_mapping_size(uint32_t slot_count, uint32_t slot_payload)
+{
+	return transcript_ring_slots_offset() + (size_t)slot_count * transcript_ring_slot_stride(slot_payload);
+}
+
+/** @brief Metadata of a message returned by transcript_ring_read(). */
+struct transcript_ring_message {
+	uint64_t seq;
+	uint64_t timestamp_ns;
+	uint32_t topic;
+	uint32_t length; /**< Payload length, also set when the buffer was too small. */
+};
+
+typedef struct transcript_ring_reader transcript_ring_reader;
+
+/**
+ * @brief Maps an existing ring read-only.
+ *
+ * The reader starts at the newest message, so it only sees messages published after it opened.
+ * @param name The shared-memory object name, e.g. "/live-transcribe-fine".
+ * @return The reader, or NULL with errno set.
+ */
+transcript_ring_reader *transcript_ring_open(const char *name);
+
+/** @brief Unmaps the ring and frees the reader. Accepts NULL. */
+void transcript_ring_close(transcript_ring_reader *reader);
+
+/**
+ * @brief Copies the next message into the buffer without blocking or making system calls.
+ *
+ * On TRANSCRIPT_RING_BUFFER_TOO_SMALL the message is left unread and message->length tells the
+ * required size.
+ * @return TRANSCRIPT_RING_OK, TRANSCRIPT_RING_EMPTY, TRANSCRIPT_RING_BUFFER_TOO_SMALL or TRANSCRIPT_RING_CLOSED.
+ */
+int transcript_ring_read(transcript_ring_reader *reader, void *buffer, size_t capacity,
+			 struct transcript_ring_message *message);
+
+/**
+ * @brief Blocks until a message is available, the writer closes the ring or the timeout expires.
+ * @param timeout_ms The timeout in milliseconds, or a negative value to wait forever.
+ * @return TRANSCRIPT_RING_OK, TRANSCRIPT_RING_TIMEOUT or TRANSCRIPT_RING_CLOSED.
+ */
+int transcript_ring_wait(transcript_ring_reader *reader, int timeout_ms);
+
+/** @brief Number of messages this reader skipped because the writer lapped it. */
+uint64_t transcript_ring_lost(const transcript_ring_reader *reader);
+
+/** @brief Payload capacity of a slot, i.e. the largest message the ring can carry. */
+uint32_t transcript_ring_max_message_size(const transcript_ring_reader *reader);
+
+#ifdef __cplusplus
+}
+#endif
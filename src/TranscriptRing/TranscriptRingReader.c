@@ -0,0 +1,232 @@
+/*
+Transcript Ring
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE /* syscall() */
+#endif
+
+#include "TranscriptRing.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+struct transcript_ring_reader {
+	unsigned char *base;
+	size_t mapping_size;
+	struct transcript_ring_header *header;
+	uint32_t slot_count;
+	uint32_t slot_payload;
+	size_t slot_stride;
+	uint64_t next_seq;
+	uint64_t lost;
+};
+
+static struct transcript_ring_slot *slot_at(const transcript_ring_reader *reader, uint64_t seq)
+{
+	const size_t index = (size_t)(seq & (reader->slot_count - 1));
+	return (struct transcript_ring_slot *)(reader->base + transcript_ring_slots_offset() +
+					       index * reader->slot_stride);
+}
+
+static int64_t monotonic_ms(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+transcript_ring_reader *transcript_ring_open(const char *name)
+{
+	/* Readers need write access to register themselves as futex waiters. */
+	const int fd = shm_open(name, O_RDWR, 0);
+	if (fd < 0) {
+		return NULL;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		const int saved = errno;
+		close(fd);
+		errno = saved;
+		return NULL;
+	}
+	if ((size_t)st.st_size < transcript_ring_slots_offset()) {
+		close(fd);
+		errno = EINVAL;
+		return NULL;
+	}
+
+	const size_t mapping_size = (size_t)st.st_size;
+	void *base = mmap(NULL, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	const int saved = errno;
+	close(fd);
+	if (base == MAP_FAILED) {
+		errno = saved;
+		return NULL;
+	}
+
+	struct transcript_ring_header *header = (struct transcript_ring_header *)base;
+	/* The writer stores magic last, after the geometry is in place. */
+	if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != TRANSCRIPT_RING_MAGIC ||
+	    header->version != TRANSCRIPT_RING_VERSION || header->slot_count == 0 ||
+	    (header->slot_count & (header->slot_count - 1)) != 0 ||
+	    transcript_ring_mapping_size(header->slot_count, header->slot_payload) > mapping_size) {
+		munmap(base, mapping_size);
+		errno = EINVAL;
+		return NULL;
+	}
+
+	transcript_ring_reader *reader = calloc(1, sizeof(*reader));
+	if (!reader) {
+		munmap(base, mapping_size);
+		errno = ENOMEM;
+		return NULL;
+	}
+	reader->base = (unsigned char *)base;
+	reader->mapping_size = mapping_size;
+	reader->header = header;
+	reader->slot_count = header->slot_count;
+	reader->slot_payload = header->slot_payload;
+	reader->slot_stride = transcript_ring_slot_stride(header->slot_payload);
+	reader->next_seq = __atomic_load_n(&header->write_seq, __ATOMIC_ACQUIRE);
+	return reader;
+}
+
+void transcript_ring_close(transcript_ring_reader *reader)
+{
+	if (!reader) {
+		return;
+	}
+	munmap(reader->base, reader->mapping_size);
+	free(reader);
+}
+
+int transcript_ring_read(transcript_ring_reader *reader, void *buffer, size_t capacity,
+			 struct transcript_ring_message *message)
+{
+	struct transcript_ring_header *header = reader->header;
+
+	for (;;) {
+		const uint64_t head = __atomic_load_n(&header->write_seq, __ATOMIC_ACQUIRE);
+		if (reader->next_seq == head) {
+			return __atomic_load_n(&header->closed, __ATOMIC_ACQUIRE) ? TRANSCRIPT_RING_CLOSED
+										    : TRANSCRIPT_RING_EMPTY;
+		}
+		if (head - reader->next_seq > reader->slot_count) {
+			/* Lapped: the oldest message still in the ring is head - slot_count. */
+			reader->lost += head - reader->next_seq - reader->slot_count;
+			reader->next_seq = head - reader->slot_count;
+		}
+
+		struct transcript_ring_slot *slot = slot_at(reader, reader->next_seq);
+		const uint64_t begin = __atomic_load_n(&slot->lock, __ATOMIC_ACQUIRE);
+		if (begin & 1u) {
+			/* The writer is overwriting this very slot, so the message is about to be lost. */
+			continue;
+		}
+
+		const uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+		const uint32_t topic = __atomic_load_n(&slot->topic, __ATOMIC_RELAXED);
+		const uint32_t length = __atomic_load_n(&slot->length, __ATOMIC_RELAXED);
+		const uint64_t timestamp_ns = __atomic_load_n(&slot->timestamp_ns, __ATOMIC_RELAXED);
+		const int fits = length <= capacity && length <= reader->slot_payload;
+		if (fits) {
+			memcpy(buffer, (const unsigned char *)(slot + 1), length);
+		}
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&slot->lock, __ATOMIC_RELAXED) != begin || seq != reader->next_seq) {
+			/* Torn or already replaced by a newer message; re-evaluate against the head. */
+			continue;
+		}
+
+		message->seq = seq;
+		message->timestamp_ns = timestamp_ns;
+		message->topic = topic;
+		message->length = length;
+		if (!fits) {
+			return TRANSCRIPT_RING_BUFFER_TOO_SMALL;
+		}
+		reader->next_seq++;
+		return TRANSCRIPT_RING_OK;
+	}
+}
+
+int transcript_ring_wait(transcript_ring_reader *reader, int timeout_ms)
+{
+	struct transcript_ring_header *header = reader->header;
+	const int64_t deadline = timeout_ms < 0 ? 0 : monotonic_ms() + timeout_ms;
+
+	for (;;) {
+		const uint32_t observed = __atomic_load_n(&header->futex_word, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&header->write_seq, __ATOMIC_ACQUIRE) != reader->next_seq) {
+			return TRANSCRIPT_RING_OK;
+		}
+		if (__atomic_load_n(&header->closed, __ATOMIC_ACQUIRE)) {
+			return TRANSCRIPT_RING_CLOSED;
+		}
+
+		int64_t remaining = -1;
+		if (timeout_ms >= 0) {
+			remaining = deadline - monotonic_ms();
+			if (remaining <= 0) {
+				return TRANSCRIPT_RING_TIMEOUT;
+			}
+		}
+
+#ifdef __linux__
+		struct timespec timeout;
+		timeout.tv_sec = (time_t)(remaining / 1000);
+		timeout.tv_nsec = (long)(remaining % 1000) * 1000000;
+
+		/*
+		 * The writer bumps futex_word before checking waiters, and we register before the kernel
+		 * compares futex_word with observed, so a publish racing with us is never missed.
+		 */
+		__atomic_fetch_add(&header->waiters, 1, __ATOMIC_SEQ_CST);
+		syscall(SYS_futex, &header->futex_word, FUTEX_WAIT, observed, remaining < 0 ? NULL : &timeout, NULL,
+			0);
+		__atomic_fetch_sub(&header->waiters, 1, __ATOMIC_SEQ_CST);
+#else
+		(void)observed;
+		struct timespec interval = {0, 1000000};
+		nanosleep(&interval, NULL);
+#endif
+	}
+}
+
+uint64_t transcript_ring_lost(const transcript_ring_reader *reader)
+{
+	return reader->lost;
+}
+
+uint32_t transcript_ring_max_message_size(const transcript_ring_reader *reader)
+{
+	return reader->slot_payload;
+}
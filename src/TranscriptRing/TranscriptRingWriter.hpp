@@ -0,0 +1,187 @@
+/*
+Transcript Ring
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef _WIN32
+
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+#include <string>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#include "TranscriptRing.h"
+
+namespace KaitoTokyo {
+namespace TranscriptRing {
+
+/**
+ * @brief The single writer of a shared-memory transcript ring.
+ *
+ * publish() only copies into the mapping and updates a few atomics. It never blocks on readers
+ * and only makes a system call when a reader is sleeping in transcript_ring_wait(). It must be
+ * called from one thread at a time.
+ */
+class TranscriptRingWriter {
+public:
+	/**
+	 * @brief Creates the shared-memory object and initializes the ring.
+	 *
+	 * A leftover object of the same name, e.g. from a crashed process, is replaced.
+	 * @param name The POSIX shared-memory object name, starting with '/'.
+	 * @param slotCount Number of slots, a power of two.
+	 * @param slotPayload Largest message in bytes.
+	 * @throws std::invalid_argument if the geometry is invalid.
+	 * @throws std::system_error if the object cannot be created or mapped.
+	 */
+	explicit TranscriptRingWriter(std::string name, std::uint32_t slotCount = 256,
+				      std::uint32_t slotPayload = 16 * 1024)
+		: name_(std::move(name)),
+		  slotCount_(slotCount),
+		  slotStride_(transcript_ring_slot_stride(slotPayload)),
+		  slotPayload_(slotPayload),
+		  mappingSize_(transcript_ring_mapping_size(slotCount, slotPayload))
+	{
+		if (name_.size() < 2 || name_.front() != '/' || name_.find('/', 1) != std::string::npos) {
+			throw std::invalid_argument("Shared memory name must be of the form /name: " + name_);
+		}
+		if (slotCount == 0 || (slotCount & (slotCount - 1)) != 0) {
+			throw std::invalid_argument("Transcript ring slot count must be a power of two");
+		}
+
+		int fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+		if (fd < 0 && errno == EEXIST) {
+			shm_unlink(name_.c_str());
+			fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+		}
+		if (fd < 0) {
+			throw std::system_error(errno, std::generic_category(), "shm_open failed for " + name_);
+		}
+		if (ftruncate(fd, static_cast<off_t>(mappingSize_)) != 0) {
+			const int error = errno;
+			close(fd);
+			shm_unlink(name_.c_str());
+			throw std::system_error(error, std::generic_category(), "ftruncate failed for " + name_);
+		}
+		void *base = mmap(nullptr, mappingSize_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		const int error = errno;
+		close(fd);
+		if (base == MAP_FAILED) {
+			shm_unlink(name_.c_str());
+			throw std::system_error(error, std::generic_category(), "mmap failed for " + name_);
+		}
+
+		base_ = static_cast<unsigned char *>(base);
+		header_ = reinterpret_cast<transcript_ring_header *>(base_);
+		// ftruncate zero-filled everything; publish the geometry before the magic readers check for.
+		header_->version = TRANSCRIPT_RING_VERSION;
+		header_->slot_count = slotCount_;
+		header_->slot_payload = slotPayload_;
+		__atomic_store_n(&header_->magic, TRANSCRIPT_RING_MAGIC, __ATOMIC_RELEASE);
+	}
+
+	TranscriptRingWriter(const TranscriptRingWriter &) = delete;
+	TranscriptRingWriter &operator=(const TranscriptRingWriter &) = delete;
+
+	/**
+	 * @brief Marks the ring closed, wakes all readers and removes the name.
+	 *
+	 * Readers that still have the ring mapped can drain the remaining messages.
+	 */
+	~TranscriptRingWriter() noexcept
+	{
+		__atomic_store_n(&header_->closed, 1u, __ATOMIC_RELEASE);
+		notify();
+		munmap(base_, mappingSize_);
+		shm_unlink(name_.c_str());
+	}
+
+	/**
+	 * @brief Publishes a message, overwriting the oldest one when the ring is full.
+	 * @return false if the payload does not fit into a slot; the message is not published then.
+	 */
+	bool publish(transcript_ring_topic topic, std::string_view payload) noexcept
+	{
+		if (payload.size() > slotPayload_) {
+			return false;
+		}
+
+		const std::uint64_t seq = __atomic_load_n(&header_->write_seq, __ATOMIC_RELAXED);
+		auto *slot = reinterpret_cast<transcript_ring_slot *>(base_ + transcript_ring_slots_offset() +
+								       (seq & (slotCount_ - 1)) * slotStride_);
+		const std::uint64_t lock = __atomic_load_n(&slot->lock, __ATOMIC_RELAXED);
+		const auto timestampNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+						 std::chrono::system_clock::now().time_since_epoch())
+						 .count();
+
+		__atomic_store_n(&slot->lock, lock + 1, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+		__atomic_store_n(&slot->seq, seq, __ATOMIC_RELAXED);
+		__atomic_store_n(&slot->topic, static_cast<std::uint32_t>(topic), __ATOMIC_RELAXED);
+		__atomic_store_n(&slot->length, static_cast<std::uint32_t>(payload.size()), __ATOMIC_RELAXED);
+		__atomic_store_n(&slot->timestamp_ns, static_cast<std::uint64_t>(timestampNs), __ATOMIC_RELAXED);
+		std::memcpy(slot + 1, payload.data(), payload.size());
+		__atomic_store_n(&slot->lock, lock + 2, __ATOMIC_RELEASE);
+
+		__atomic_store_n(&header_->write_seq, seq + 1, __ATOMIC_RELEASE);
+		notify();
+		return true;
+	}
+
+	const std::string &name() const noexcept { return name_; }
+	std::uint32_t maxMessageSize() const noexcept { return slotPayload_; }
+
+private:
+	const std::string name_;
+	const std::uint32_t slotCount_;
+	const std::size_t slotStride_;
+	const std::uint32_t slotPayload_;
+	const std::size_t mappingSize_;
+	unsigned char *base_ = nullptr;
+	transcript_ring_header *header_ = nullptr;
+
+	void notify() noexcept
+	{
+		// Pairs with the waiters registration in transcript_ring_wait(); see the comment there.
+		__atomic_fetch_add(&header_->futex_word, 1u, __ATOMIC_SEQ_CST);
+#ifdef __linux__
+		if (__atomic_load_n(&header_->waiters, __ATOMIC_SEQ_CST) != 0) {
+			syscall(SYS_futex, &header_->futex_word, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+		}
+#endif
+	}
+};
+
+} // namespace TranscriptRing
+} // namespace KaitoTokyo
+
+#endif // _WIN32
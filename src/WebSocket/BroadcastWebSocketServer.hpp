@@ -19,12 +19,19 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable> // For startup synchronization
-#include <future>             // For std::promise, std::future
+#include <cstdint>
+#include <filesystem>
+#include <future> // For std::promise, std::future
+#include <iterator>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <string_view>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include <libusockets.h> // Include libusockets for us_listen_socket_close
 #include <uwebsockets/App.h>
@@ -32,77 +39,216 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <ILogger.hpp>
 
+#include "ConnectionStats.hpp"
+#include "ControlCommand.hpp"
+#include "ServerSentEvents.hpp"
+#include "StaticAssetCache.hpp"
+#include "TlsSessionResumption.hpp"
+#include "TranscriptMessage.hpp"
+#include "UnixFramedServer.hpp"
+
 namespace KaitoTokyo {
 namespace WebSocket {
 
 /**
- * @class BroadcastWebSocketServer
+ * @brief Protocols offered on the Unix domain socket.
+ */
+enum class UnixSocketFraming {
+	WebSocket,      ///< Same HTTP/WebSocket/SSE endpoints as the TCP port.
+	LengthPrefixed, ///< Raw frames as described in UnixFramedServer. Not available on Windows.
+};
+
+/**
+ * @brief Tunables for BroadcastWebSocketServer.
+ */
+struct BroadcastWebSocketServerOptions {
+	/**
+	 * @brief Seconds without any inbound frame (including pongs) before a client is closed. 0 disables.
+	 * uWS requires either 0 or at least 8; smaller values are raised to 8.
+	 */
+	unsigned short idleTimeoutSeconds = 120;
+
+	/**
+	 * @brief Whether the server pings idle clients so that live clients answer and stay connected.
+	 * Only meaningful together with a non-zero idleTimeoutSeconds.
+	 */
+	bool sendPingsAutomatically = true;
+
+	/**
+	 * @brief Assets served under /overlay/ (e.g. the caption overlay page), or nullptr to serve none.
+	 */
+	std::shared_ptr<const StaticAssetCache> staticAssets;
+
+	/**
+	 * @brief Path of an additional Unix domain socket for consumers on the same host. Empty disables it.
+	 */
+	std::string unixSocketPath;
+
+	/**
+	 * @brief Protocol spoken on unixSocketPath.
+	 */
+	UnixSocketFraming unixSocketFraming = UnixSocketFraming::WebSocket;
+
+	/**
+	 * @brief Serves wss:// (and https://) instead of plain ws:// when a certificate is configured.
+	 */
+	TlsOptions tls;
+};
+
+/**
+ * @brief Interface of the broadcast server, independent of whether it serves TLS.
+ * Use create() to obtain the plain or TLS implementation.
+ */
+class BroadcastWebSocketServer {
+public:
+	virtual ~BroadcastWebSocketServer() = default;
+
+	virtual bool start() = 0;
+	virtual void stop() = 0;
+	virtual void broadcast(const std::string &message) = 0;
+	virtual void publish(std::string_view topic, const std::string &message) = 0;
+	virtual void logStats() = 0;
+	virtual bool isListening() const = 0;
+
+	static constexpr const char *broadcastTopic = "broadcast"; ///< Topic name used for broadcasting messages.
+	static constexpr const char *finalTopic = "final";         ///< Topic name used for finalized results.
+	static constexpr const char *partialTopic = "partial";     ///< Topic name used for partial results.
+
+	static constexpr unsigned int maxBackpressure = 1 * 1024 * 1024; ///< Per-client buffered bytes before dropping.
+
+	/**
+	 * @brief Creates a server that serves TLS if options.tls is enabled. See BasicBroadcastWebSocketServer.
+	 */
+	static std::unique_ptr<BroadcastWebSocketServer> create(const BridgeUtils::ILogger &logger, int port,
+								 ControlCommandQueue *controlCommandQueue = nullptr,
+								 BroadcastWebSocketServerOptions options = {});
+};
+
+/**
+ * @class BasicBroadcastWebSocketServer
  * @brief A simplified WebSocket server dedicated to broadcasting messages to all connected clients.
  *
  * This server runs its uWebSockets event loop in a separate thread and provides
- * a thread-safe method (`broadcast`) to send messages to all subscribed clients.
+ * thread-safe methods (`broadcast` and `publish`) to send messages to all subscribed clients.
  * It manages its own uWS::App instance internally within the server thread.
  *
+ * Clients may send text control commands (see ControlCommand). Subscription changes are applied
+ * on the event loop directly; every other command is forwarded to the owner through a lock-free
+ * ControlCommandQueue so that control traffic never takes a lock shared with the audio path. Those commands
+ * are only accepted if the owner passed a queue, and only from loopback or Unix socket connections, since
+ * the port listens on every interface.
+ *
+ * Each connection carries a fixed-size PerSocketData with its traffic counters. Messages are fanned out
+ * by the server itself rather than by uWS topics so that every send result can be accounted per client.
+ * The counters are served as JSON on GET /stats and can be written to the log with logStats().
+ *
+ * The same topics are also streamed as Server-Sent Events on GET /events?topics=final,partial for
+ * consumers that cannot speak WebSocket. SSE clients are subject to the same maxBackpressure drop policy.
+ *
+ * Clients choose a MessageFormat with the "format" command or the SSE "format" query parameter. Every
+ * published message is a TranscriptMessage that serializes each format at most once and shares it
+ * between all clients; cache hits and misses are reported on GET /stats.
+ *
+ * When static assets are configured, they are served from memory under /overlay/ with precompressed
+ * gzip/brotli variants and ETags, so browser-source reloads usually end with a 304.
+ *
+ * Local consumers can skip the TCP loopback stack through an optional Unix domain socket, which either
+ * serves the same endpoints or, in LengthPrefixed mode, streams raw frames through UnixFramedServer.
+ *
+ * With SSL set, the server runs a uWS::SSLApp with TLS session resumption (see configureTlsSessionResumption),
+ * so reconnecting overlays skip the full handshake. This requires a build with WEBSOCKET_TLS.
+ *
  * @note This class is non-copyable and non-movable.
  */
-class BroadcastWebSocketServer {
+template<bool SSL> class BasicBroadcastWebSocketServer final : public BroadcastWebSocketServer {
 public:
 	/**
-     * @brief Constructs the BroadcastWebSocketServer. Does not start the server thread yet.
+     * @brief Constructs the server. Does not start the server thread yet.
      * @param logger Reference to the logger implementation.
      * @param port The port number the server will attempt to listen on.
+     * @param controlCommandQueue Queue receiving control commands from clients, or nullptr to reject them.
+     *        It must outlive the server.
+     * @param options Connection tunables such as the idle timeout.
      */
-	BroadcastWebSocketServer(const BridgeUtils::ILogger &logger, int port)
+	BasicBroadcastWebSocketServer(const BridgeUtils::ILogger &logger, int port,
+				      ControlCommandQueue *controlCommandQueue = nullptr,
+				      BroadcastWebSocketServerOptions options = {})
 		: logger_(logger),
 		  port_(port),
+		  controlCommandQueue_(controlCommandQueue),
+		  options_(sanitizeOptions(logger, options)),
 		  running_(false),
 		  listen_success_(false),
 		  listen_socket_(nullptr),
 		  app_(nullptr),
 		  eventLoop_(nullptr)
 	{
-		logger_.info("Initializing BroadcastWebSocketServer for port {}.", port_);
+		logger_.info(
+			"Initializing BroadcastWebSocketServer for port {} (TLS {}, idle timeout {}s, automatic pings {}).",
+			port_, SSL, options_.idleTimeoutSeconds, options_.sendPingsAutomatically);
 	}
 
 	/**
      * @brief Destructor. Ensures the server thread is stopped safely.
      */
-	~BroadcastWebSocketServer()
+	~BasicBroadcastWebSocketServer() override
 	{
 		logger_.info("Destroying BroadcastWebSocketServer for port {}.", port_);
 		stop(); // Ensure stop is called upon destruction
 	}
 
 	// Delete copy constructor and assignment operator
-	BroadcastWebSocketServer(const BroadcastWebSocketServer &) = delete;
-	BroadcastWebSocketServer &operator=(const BroadcastWebSocketServer &) = delete;
+	BasicBroadcastWebSocketServer(const BasicBroadcastWebSocketServer &) = delete;
+	BasicBroadcastWebSocketServer &operator=(const BasicBroadcastWebSocketServer &) = delete;
 
 	// Delete move constructor and assignment operator
-	BroadcastWebSocketServer(BroadcastWebSocketServer &&) = delete;
-	BroadcastWebSocketServer &operator=(BroadcastWebSocketServer &&) = delete;
+	BasicBroadcastWebSocketServer(BasicBroadcastWebSocketServer &&) = delete;
+	BasicBroadcastWebSocketServer &operator=(BasicBroadcastWebSocketServer &&) = delete;
 
 	/**
      * @brief Starts the server thread which initializes and runs the uWebSockets app.
      * This method blocks until the listen operation completes (either successfully or with failure).
      * @return True if the server started listening successfully, false otherwise.
      */
-	bool start()
+	bool start() override
 	{
 		// Prevent starting if already running
 		if (running_) {
 			logger_.warn("Server on port {} is already running or starting.", port_);
 			return listen_success_;
 		}
+#ifndef WEBSOCKET_TLS
+		if constexpr (SSL) {
+			// uSockets without TLS would silently fall back to plain TCP, so refuse instead
+			logger_.error("TLS was requested for port {} but this build has no TLS support.", port_);
+			return false;
+		}
+#endif
 
 		std::promise<bool> listen_promise;
 		std::future<bool> listen_future = listen_promise.get_future();
 
 		running_ = true; // Set running flag before creating the thread
+		startUnixFramedServer();
 		serverThread_ = std::thread([this, p = std::move(listen_promise)]() mutable {
 			// Initialize thread-local event loop for this thread
 			uWS::Loop::get();
 
-			uWS::App app;                    // uWS::App instance on the server thread's stack
+			AppType app(socketContextOptions()); // uWS app instance on the server thread's stack
+			if (app.constructorFailed()) {
+				logger_.error(
+					"Failed to create the TLS context for port {}. Check the certificate and key.",
+					port_);
+				running_ = false;
+				p.set_value(false);
+				return;
+			}
+#ifdef WEBSOCKET_TLS
+			if constexpr (SSL) {
+				configureTlsSessionResumption(static_cast<SSL_CTX *>(app.getNativeHandle()),
+							      options_.tls);
+			}
+#endif
 			uWS::Loop *loop = app.getLoop(); // Get the loop associated with this app
 
 			{ // Scope for locking the mutex
@@ -112,22 +258,30 @@ public:
 			}
 
 			// Configure WebSocket behavior
-			uWS::App::WebSocketBehavior<void> behavior;
+			typename AppType::template WebSocketBehavior<PerSocketData> behavior;
 			behavior.compression = uWS::DISABLED;         // Compression often less effective for broadcast
 			behavior.maxPayloadLength = 16 * 1024 * 1024; // 16MB limit
-			behavior.idleTimeout = 0;                     // Disable idle timeout
-			behavior.maxBackpressure = 1 * 1024 * 1024;   // 1MB backpressure limit
+			behavior.idleTimeout = options_.idleTimeoutSeconds; // Evict half-open clients
+			behavior.maxBackpressure = maxBackpressure;         // 1MB backpressure limit
 			behavior.closeOnBackpressureLimit =
-				false;                           // Don't close on limit, just drop messages implicitly
-			behavior.resetIdleTimeoutOnSend = false; // Not relevant with idleTimeout = 0
-			behavior.sendPingsAutomatically = false; // Not relevant with idleTimeout = 0
+				false; // Don't close on limit, just drop messages implicitly
+			// Only inbound traffic proves a client is alive; our own broadcasts must not keep it around
+			behavior.resetIdleTimeoutOnSend = false;
+			behavior.sendPingsAutomatically = options_.sendPingsAutomatically; // Live clients answer with pongs
 
 			// Handler for new WebSocket connections
 			behavior.open = [this](auto *ws) {
 				if (ws) {
-					ws->subscribe(broadcastTopic); // Subscribe client to the broadcast topic
-					logger_.info("WebSocket client connected (port {}) and subscribed to '{}'.",
-						     port_, broadcastTopic);
+					// Subscribe client to the broadcast topic and both result topics
+					PerSocketData *data = ws->getUserData();
+					data->id = ++nextClientId_;
+					data->connectedAt = std::chrono::system_clock::now();
+					data->subscriptions = DefaultTopics;
+					data->controlAllowed = isLocalPeerAddress(ws->getRemoteAddress());
+					clients_.add(ws);
+					++stats_.totalConnections;
+					logger_.info("WebSocket client #{} connected (port {}) and subscribed to '{}'.",
+						     data->id, port_, broadcastTopic);
 				} else {
 					logger_.warn("WebSocket open handler called with null ws pointer (port {}).",
 						     port_);
@@ -137,12 +291,20 @@ public:
 			// Handler for WebSocket disconnections
 			behavior.close = [this](auto *ws, int code, std::string_view message) {
 				// ws pointer is valid for logging/identification but not I/O here
-				logger_.info("WebSocket client disconnected (port {}) with code {}.", port_, code);
+				const PerSocketData *data = ws->getUserData();
+				clients_.remove(ws);
+				logger_.info(
+					"WebSocket client #{} disconnected (port {}) with code {} after sending {} bytes ({} messages dropped).",
+					data->id, port_, code, data->bytesSent, data->messagesDropped);
 			};
 
-			// Handler for incoming messages (typically ignored in broadcast-only server)
+			// Handler for incoming messages (control commands, see ControlCommand)
 			behavior.message = [this](auto *ws, std::string_view message, uWS::OpCode opCode) {
-				// logger_.debug("Received message on broadcast server (port {}), ignoring.", port_);
+				if (opCode != uWS::OpCode::TEXT) {
+					ws->send("error control commands must be text frames", uWS::OpCode::TEXT);
+					return;
+				}
+				handleControlMessage(ws, message);
 			};
 
 			// Handler for when backpressure has drained (optional)
@@ -151,7 +313,28 @@ public:
 			};
 
 			// Register the WebSocket behavior for all paths
-			app.ws<void>("/*", std::move(behavior)); // Move behavior struct into the app
+			app.template ws<PerSocketData>("/*", std::move(behavior)); // Move behavior struct into the app
+
+			// Per-connection and aggregated statistics as JSON
+			app.get("/stats", [this](auto *res, auto *req) {
+				res->writeHeader("Content-Type", "application/json")
+					->writeHeader("Cache-Control", "no-store")
+					->end(formatStatsJson());
+			});
+
+			// Server-Sent Events stream of the same topics
+			app.get("/events", [this](auto *res, auto *req) {
+				openSseStream(res, req->getQuery("topics"), req->getQuery("format"));
+			});
+
+			// Built-in caption overlay and other static assets
+			app.get("/overlay", [](auto *res, auto *req) {
+				res->writeStatus("301 Moved Permanently")->writeHeader("Location", "/overlay/")->end();
+			});
+			app.get("/overlay/*", [this](auto *res, auto *req) {
+				serveStaticAsset(res, req->getUrl(), req->getHeader("accept-encoding"),
+						 req->getHeader("if-none-match"));
+			});
 
 			bool success = false;
 			// Attempt to listen on the specified port
@@ -165,7 +348,7 @@ public:
 					// We might have successfully acquired a token, but stop() was called.
 					// We must close this token immediately.
 					if (token) {
-						us_listen_socket_close(0, token);
+						us_listen_socket_close(SSL, token);
 					}
 					listen_socket_ = nullptr; // Ensure it's null
 					// app_ and eventLoop_ were likely already nulled by stop(),
@@ -187,7 +370,8 @@ public:
 				try {
 					p.set_value(success); // Set the promise value
 					if (success) {
-						logger_.info("BroadcastWebSocketServer listening on port {}.", port_);
+						logger_.info("BroadcastWebSocketServer listening on port {}{}.", port_,
+							     SSL ? " (TLS)" : "");
 					} else {
 						// Log error if we failed normally, or if stop() was called during init
 						logger_.error(
@@ -203,6 +387,18 @@ public:
 
 			// Only run the event loop if listen was successful
 			if (success) {
+				// Keep idle SSE streams alive; uWS closes HTTP responses that stay silent for ~10 seconds
+				sseKeepAliveTimer_ = us_create_timer(reinterpret_cast<us_loop_t *>(loop), 0,
+								     sizeof(BasicBroadcastWebSocketServer *));
+				*static_cast<BasicBroadcastWebSocketServer **>(us_timer_ext(sseKeepAliveTimer_)) = this;
+				us_timer_set(sseKeepAliveTimer_, onSseKeepAliveTimer, sseKeepAliveIntervalMs,
+					     sseKeepAliveIntervalMs);
+
+				if (!options_.unixSocketPath.empty() &&
+				    options_.unixSocketFraming == UnixSocketFraming::WebSocket) {
+					listenUnixSocket(app);
+				}
+
 				// This call blocks until the loop is stopped (e.g., by app.close())
 				app.run();
 				logger_.info("Event loop finished for port {}.", port_);
@@ -234,6 +430,9 @@ public:
 			if (serverThread_.joinable()) {
 				serverThread_.join();
 			}
+#ifndef _WIN32
+			unixFramedServer_.reset();
+#endif
 			logger_.error("Server thread exited prematurely due to listen failure on port {}.", port_);
 		}
 
@@ -245,7 +444,7 @@ public:
      * This method is thread-safe and idempotent (calling it multiple times has no effect after the first call).
      * It defers the actual closing operations to the server's event loop thread.
      */
-	void stop()
+	void stop() override
 	{
 		// Use atomic exchange to ensure stop logic runs only once
 		if (running_.exchange(false)) { // If running was true, set it to false and proceed
@@ -253,7 +452,7 @@ public:
 
 			us_listen_socket_t *tokenToClose = nullptr;
 			uWS::Loop *loopToDefer = nullptr;
-			uWS::App *appToClose = nullptr;
+			AppType *appToClose = nullptr;
 
 			{ // Scope for mutex lock
 				std::lock_guard<std::mutex> lock(appMutex_);
@@ -272,10 +471,20 @@ public:
 				// Defer the closing operations to the event loop thread
 				loopToDefer->defer([this, token = tokenToClose, app = appToClose]() {
 					logger_.debug("Closing listen socket and app on port {} (deferred)...", port_);
+					logStatsOnLoop();
+					// The keep-alive timer would otherwise keep the event loop running
+					if (sseKeepAliveTimer_) {
+						us_timer_close(sseKeepAliveTimer_);
+						sseKeepAliveTimer_ = nullptr;
+					}
 					// Close the listen socket if it was successfully opened
 					if (token) {
-						// The first argument '0' indicates non-SSL context for uWS::App
-						us_listen_socket_close(0, token);
+						us_listen_socket_close(SSL, token);
+					}
+					if (unixListenSocket_) {
+						us_listen_socket_close(SSL, unixListenSocket_);
+						unixListenSocket_ = nullptr;
+						removeUnixSocketFile();
 					}
 					// Close the uWS::App instance, which stops the event loop
 					if (app) {
@@ -313,6 +522,9 @@ public:
 					port_);
 			}
 
+#ifndef _WIN32
+			unixFramedServer_.reset();
+#endif
 			logger_.info("BroadcastWebSocketServer stopped for port {}.", port_);
 			listen_success_ = false; // Update listening status
 		} else {
@@ -335,10 +547,10 @@ public:
      * This method is thread-safe. It defers the actual publish operation to the server's event loop thread.
      * @param message The message content to broadcast.
      */
-	void broadcast(const std::string &message)
+	void broadcast(const std::string &message) override
 	{
 		uWS::Loop *loopToDefer = nullptr;
-		uWS::App *appToPublish = nullptr;
+		AppType *appToPublish = nullptr;
 
 		{ // Scope for mutex lock
 			std::lock_guard<std::mutex> lock(appMutex_);
@@ -349,14 +561,15 @@ public:
 
 		// Check if the server loop is available and the server is marked as running
 		if (loopToDefer && running_) {
-			// Copy the message to ensure its lifetime until the deferred lambda executes
-			std::string msg_copy = message;
+			// Copy the message once; every transport shares it until the last one is done
+			auto msg = std::make_shared<const TranscriptMessage>(BroadcastTopicBit, message);
+			publishToUnixFramedServer(msg);
 			// Defer the publish operation to the event loop thread
-			loopToDefer->defer([this, app = appToPublish, msg = std::move(msg_copy)]() {
+			loopToDefer->defer([this, app = appToPublish, msg = std::move(msg)]() {
 				// Double-check pointers and running state inside the deferred lambda,
 				// as the server might have been stopped between the defer call and its execution.
 				if (app && running_) {
-					app->publish(broadcastTopic, msg, uWS::OpCode::TEXT);
+					fanOut(*msg);
 					// Avoid logging every broadcast message in production unless necessary
 					// logger_.debug("Broadcasted message (deferred): {}", msg);
 				} else {
@@ -375,22 +588,451 @@ public:
 		}
 	}
 
+	/**
+     * @brief Publishes a text message to all clients subscribed to the given topic.
+     * This method is thread-safe. It defers the actual publish operation to the server's event loop thread.
+     * @param topic One of the topics clients can subscribe to (e.g. finalTopic or partialTopic).
+     * @param message The message content to publish.
+     */
+	void publish(std::string_view topic, const std::string &message) override
+	{
+		uWS::Loop *loopToDefer = nullptr;
+		AppType *appToPublish = nullptr;
+
+		{ // Scope for mutex lock
+			std::lock_guard<std::mutex> lock(appMutex_);
+			loopToDefer = eventLoop_;
+			appToPublish = app_;
+		}
+
+		if (loopToDefer && running_) {
+			const std::uint32_t bit = topicBit(topic);
+			auto msg = std::make_shared<const TranscriptMessage>(bit, message);
+			publishToUnixFramedServer(msg);
+			loopToDefer->defer([this, app = appToPublish, msg = std::move(msg)]() {
+				if (app && running_) {
+					fanOut(*msg);
+				}
+			});
+		}
+	}
+
+	/**
+     * @brief Writes aggregated and per-client statistics to the logger.
+     * This method is thread-safe. The statistics are collected and logged on the event loop thread.
+     */
+	void logStats() override
+	{
+		uWS::Loop *loopToDefer = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(appMutex_);
+			loopToDefer = eventLoop_;
+		}
+
+		if (loopToDefer && running_) {
+			loopToDefer->defer([this]() { logStatsOnLoop(); });
+		}
+	}
+
 	/**
       * @brief Checks if the server is currently listening on its port.
       * @return True if the server successfully started listening, false otherwise.
       */
-	bool isListening() const
+	bool isListening() const override
 	{
 		// Read the atomic boolean flag
 		return listen_success_;
 	}
 
 private:
+	using AppType = uWS::TemplatedApp<SSL>;
+	using ClientWebSocket = uWS::WebSocket<SSL, true, PerSocketData>;
+	using HttpResponse = uWS::HttpResponse<SSL>;
+
+	/**
+     * @brief An open Server-Sent Events stream. Lives in sseClients_ until the client goes away.
+     */
+	struct SseClient {
+		HttpResponse *res;
+		PerSocketData data;
+	};
+
+	static constexpr int sseKeepAliveIntervalMs = 5000;
+
+	/**
+     * @brief Certificate settings for the TLS context. Empty for plain servers.
+     */
+	uWS::SocketContextOptions socketContextOptions() const
+	{
+		uWS::SocketContextOptions socketOptions{};
+		if constexpr (SSL) {
+			socketOptions.cert_file_name = options_.tls.certFile.c_str();
+			socketOptions.key_file_name = options_.tls.keyFile.c_str();
+			if (!options_.tls.passphrase.empty()) {
+				socketOptions.passphrase = options_.tls.passphrase.c_str();
+			}
+		}
+		return socketOptions;
+	}
+
+	static BroadcastWebSocketServerOptions sanitizeOptions(const BridgeUtils::ILogger &logger,
+							       BroadcastWebSocketServerOptions options)
+	{
+		if (options.idleTimeoutSeconds > 0 && options.idleTimeoutSeconds < 8) {
+			logger.warn("WebSocket idle timeout of {} seconds is too short, using 8 seconds instead.",
+				    options.idleTimeoutSeconds);
+			options.idleTimeoutSeconds = 8;
+		}
+		if (options.idleTimeoutSeconds == 0 && options.sendPingsAutomatically) {
+			logger.warn("WebSocket automatic pings have no effect without an idle timeout.");
+		}
+		return options;
+	}
+
+	/**
+     * @brief Sends a message to every client subscribed to one of its topic bits. Runs on the event loop thread.
+     * Each client gets the representation it asked for; every representation is serialized at most once.
+     */
+	void fanOut(const TranscriptMessage &transcript)
+	{
+		const std::uint32_t topicBits = transcript.topicBits();
+		for (SseClient &client : sseClients_) {
+			if (client.data.subscriptions & topicBits) {
+				sendSseEvent(client, topicBits, transcript.representation(client.data.format));
+			}
+		}
+
+		for (ClientWebSocket *ws : clients_) {
+			PerSocketData *data = ws->getUserData();
+			if (!(data->subscriptions & topicBits)) {
+				continue;
+			}
+			const std::string_view message = transcript.representation(data->format);
+			// BACKPRESSURE still queues the message; DROPPED means maxBackpressure was exceeded.
+			if (ws->send(message, uWS::OpCode::TEXT) == ClientWebSocket::SendStatus::DROPPED) {
+				++data->messagesDropped;
+				++stats_.totalMessagesDropped;
+			} else {
+				data->bytesSent += message.size();
+				++data->messagesSent;
+				stats_.totalBytesSent += message.size();
+				++stats_.totalMessagesSent;
+			}
+		}
+
+		stats_.serializationHits += transcript.hits();
+		stats_.serializationMisses += transcript.misses();
+	}
+
+	/**
+     * @brief Starts a Server-Sent Events stream. Runs on the event loop thread.
+     * @param topics Comma-separated topic names, or std::nullopt for the default topics.
+     * @param format A MessageFormat name, or std::nullopt for JSON.
+     */
+	void openSseStream(HttpResponse *res, std::optional<std::string_view> topics,
+			   std::optional<std::string_view> format)
+	{
+		const std::optional<MessageFormat> messageFormat =
+			format ? parseMessageFormat(*format) : std::optional<MessageFormat>{MessageFormat::Json};
+		if (!messageFormat) {
+			res->writeStatus("400 Bad Request")->end("unknown format: " + std::string(*format));
+			return;
+		}
+
+		std::uint32_t subscriptions = topics ? NoTopic : DefaultTopics;
+		for (std::string_view rest = topics.value_or(std::string_view{}); !rest.empty();) {
+			const std::size_t comma = rest.find(',');
+			const std::string_view name = rest.substr(0, comma);
+			const std::uint32_t bit = topicBit(name);
+			if (bit == NoTopic) {
+				res->writeStatus("400 Bad Request")->end("unknown topic: " + std::string(name));
+				return;
+			}
+			subscriptions |= bit;
+			rest = comma == std::string_view::npos ? std::string_view{} : rest.substr(comma + 1);
+		}
+
+		SseClient client{res, {}};
+		client.data.id = ++nextClientId_;
+		client.data.connectedAt = std::chrono::system_clock::now();
+		client.data.subscriptions = subscriptions;
+		client.data.format = *messageFormat;
+		sseClients_.push_back(client);
+		++stats_.totalConnections;
+
+		res->onAborted([this, res]() {
+			for (std::size_t i = 0; i < sseClients_.size(); ++i) {
+				if (sseClients_[i].res == res) {
+					logger_.info("SSE client #{} disconnected (port {}) after sending {} bytes.",
+						     sseClients_[i].data.id, port_, sseClients_[i].data.bytesSent);
+					sseClients_[i] = sseClients_.back();
+					sseClients_.pop_back();
+					break;
+				}
+			}
+		});
+		res->writeHeader("Content-Type", "text/event-stream")
+			->writeHeader("Cache-Control", "no-cache")
+			->writeHeader("Access-Control-Allow-Origin", "*")
+			->write(":ok\n\n");
+		logger_.info("SSE client #{} connected (port {}).", client.data.id, port_);
+	}
+
+	/**
+     * @brief Writes one payload as an SSE event, see writeSseEvent. Runs on the event loop thread.
+     */
+	void sendSseEvent(SseClient &client, std::uint32_t topicBits, std::string_view message)
+	{
+		if (client.res->getBufferedAmount() >= maxBackpressure) {
+			++client.data.messagesDropped;
+			++stats_.totalMessagesDropped;
+			return;
+		}
+
+		std::size_t written = 0;
+		client.res->cork([&]() {
+			written = writeSseEvent([&](std::string_view part) { client.res->write(part); }, topicBits,
+						message);
+		});
+		client.data.bytesSent += written;
+		++client.data.messagesSent;
+		stats_.totalBytesSent += written;
+		++stats_.totalMessagesSent;
+	}
+
+	/**
+     * @brief Serves a static asset from memory. Runs on the event loop thread.
+     */
+	void serveStaticAsset(HttpResponse *res, std::string_view url, std::string_view acceptEncoding,
+			      std::string_view ifNoneMatch)
+	{
+		const StaticAsset *asset = options_.staticAssets ? options_.staticAssets->find(url) : nullptr;
+		if (!asset) {
+			res->writeStatus("404 Not Found")->end("Not Found");
+			return;
+		}
+
+		const ContentEncoding encoding = asset->effectiveEncoding(StaticAssetCache::negotiate(acceptEncoding));
+		const std::string &etag = asset->etag(encoding);
+		if (!ifNoneMatch.empty() && ifNoneMatch.find(etag) != std::string_view::npos) {
+			res->writeStatus("304 Not Modified")
+				->writeHeader("Cache-Control", "no-cache")
+				->writeHeader("Vary", "Accept-Encoding")
+				->writeHeader("ETag", etag)
+				->end();
+			return;
+		}
+
+		res->writeHeader("Cache-Control", "no-cache")
+			->writeHeader("Vary", "Accept-Encoding")
+			->writeHeader("Content-Type", asset->contentType)
+			->writeHeader("ETag", etag);
+		if (const char *contentEncoding = StaticAssetCache::contentEncodingHeader(encoding)) {
+			res->writeHeader("Content-Encoding", contentEncoding);
+		}
+		res->end(asset->body(encoding));
+	}
+
+	/**
+     * @brief Starts the length-prefixed Unix socket server if configured. Failure is logged but not fatal.
+     */
+	void startUnixFramedServer()
+	{
+		if (options_.unixSocketPath.empty() || options_.unixSocketFraming != UnixSocketFraming::LengthPrefixed) {
+			return;
+		}
+#ifndef _WIN32
+		unixFramedServer_ = std::make_unique<UnixFramedServer>(logger_, options_.unixSocketPath);
+		if (!unixFramedServer_->start()) {
+			unixFramedServer_.reset();
+		}
+#else
+		logger_.warn("Length-prefixed Unix socket framing is not supported on this platform.");
+#endif
+	}
+
+	void publishToUnixFramedServer(const std::shared_ptr<const TranscriptMessage> &message)
+	{
+#ifndef _WIN32
+		if (unixFramedServer_) {
+			// Raw frames always carry the source payload, shared without a copy
+			unixFramedServer_->publish(message->topicBits(),
+						   std::shared_ptr<const std::string>(message, &message->source()));
+		}
+#endif
+	}
+
+	/**
+     * @brief Additionally listens on the Unix domain socket path. Runs on the event loop thread.
+     */
+	void listenUnixSocket(AppType &app)
+	{
+		removeUnixSocketFile(); // A stale socket file from a crashed session would make bind fail
+		app.listen(
+			0,
+			[this](auto *token) {
+				unixListenSocket_ = token;
+				if (token) {
+					logger_.info("BroadcastWebSocketServer also listening on Unix socket '{}'.",
+						     options_.unixSocketPath);
+				} else {
+					logger_.error("Failed to listen on Unix socket '{}'.", options_.unixSocketPath);
+				}
+			},
+			options_.unixSocketPath);
+	}
+
+	void removeUnixSocketFile() const
+	{
+		std::error_code ec;
+		if (std::filesystem::is_socket(options_.unixSocketPath, ec)) {
+			std::filesystem::remove(options_.unixSocketPath, ec);
+		}
+	}
+
+	static void onSseKeepAliveTimer(us_timer_t *timer)
+	{
+		auto *self = *static_cast<BasicBroadcastWebSocketServer **>(us_timer_ext(timer));
+		for (SseClient &client : self->sseClients_) {
+			// A stream this far behind is not idle, and must not buffer beyond the limit
+			if (client.res->getBufferedAmount() < maxBackpressure) {
+				client.res->write(sseKeepAliveComment);
+			}
+		}
+	}
+
+	/**
+     * @brief Writes the statistics to the logger. Runs on the event loop thread.
+     */
+	void logStatsOnLoop() const
+	{
+		logger_.info(
+			"WebSocket server stats (port {}): {} clients, {} connections total, {} bytes / {} messages sent, {} messages dropped, serialization cache {} hits / {} misses.",
+			port_, clients_.size(), stats_.totalConnections, stats_.totalBytesSent, stats_.totalMessagesSent,
+			stats_.totalMessagesDropped, stats_.serializationHits, stats_.serializationMisses);
+		for (ClientWebSocket *ws : clients_) {
+			const PerSocketData *data = ws->getUserData();
+			logger_.info(
+				"  client #{}: {} bytes / {} messages sent, {} dropped, {} bytes buffered, subscriptions {:#x}.",
+				data->id, data->bytesSent, data->messagesSent, data->messagesDropped,
+				ws->getBufferedAmount(), data->subscriptions);
+		}
+		for (const SseClient &client : sseClients_) {
+			logger_.info(
+				"  SSE client #{}: {} bytes / {} messages sent, {} dropped, {} bytes buffered, subscriptions {:#x}.",
+				client.data.id, client.data.bytesSent, client.data.messagesSent,
+				client.data.messagesDropped, client.res->getBufferedAmount(), client.data.subscriptions);
+		}
+	}
+
+	/**
+     * @brief Builds the JSON document served on GET /stats. Runs on the event loop thread.
+     */
+	std::string formatStatsJson() const
+	{
+		std::vector<ConnectionView> webSockets;
+		webSockets.reserve(clients_.size());
+		for (ClientWebSocket *ws : clients_) {
+			webSockets.push_back({ws->getUserData(), ws->getBufferedAmount()});
+		}
+		std::vector<ConnectionView> sseStreams;
+		sseStreams.reserve(sseClients_.size());
+		for (const SseClient &client : sseClients_) {
+			sseStreams.push_back({&client.data, client.res->getBufferedAmount()});
+		}
+		return formatServerStatsJson(stats_, webSockets, sseStreams, std::chrono::system_clock::now());
+	}
+
+	/**
+     * @brief Handles a control command received from a client. Runs on the event loop thread.
+     * Replies "ok <command>" on success and "error <reason>" otherwise.
+     */
+	template<typename WebSocketT> void handleControlMessage(WebSocketT *ws, std::string_view message)
+	{
+		try {
+			dispatchControlCommand(ws, ControlCommand::parse(message));
+		} catch (const std::invalid_argument &e) {
+			ws->send(std::string("error ") + e.what(), uWS::OpCode::TEXT);
+		}
+	}
+
+	template<typename WebSocketT> void dispatchControlCommand(WebSocketT *ws, ControlCommand command)
+	{
+		const std::string name = commandName(command.type);
+		switch (command.type) {
+		case ControlCommandType::Subscribe:
+		case ControlCommandType::Unsubscribe: {
+			const std::uint32_t bit = topicBit(command.argument);
+			if (bit == NoTopic) {
+				ws->send("error unknown topic: " + command.argument, uWS::OpCode::TEXT);
+				return;
+			}
+			if (command.type == ControlCommandType::Subscribe) {
+				ws->getUserData()->subscriptions |= bit;
+			} else {
+				ws->getUserData()->subscriptions &= ~bit;
+			}
+			break;
+		}
+		case ControlCommandType::SetFormat: {
+			const std::optional<MessageFormat> format = parseMessageFormat(command.argument);
+			if (!format) {
+				ws->send("error unknown format: " + command.argument, uWS::OpCode::TEXT);
+				return;
+			}
+			ws->getUserData()->format = *format;
+			break;
+		}
+		default:
+			if (!controlCommandQueue_) {
+				ws->send("error control commands are disabled", uWS::OpCode::TEXT);
+				return;
+			}
+			if (!ws->getUserData()->controlAllowed) {
+				ws->send("error control commands are only accepted from this machine",
+					 uWS::OpCode::TEXT);
+				return;
+			}
+			if (!controlCommandQueue_->tryPush(std::move(command))) {
+				logger_.warn("Control command queue is full (port {}). Dropping command.", port_);
+				ws->send("error busy", uWS::OpCode::TEXT);
+				return;
+			}
+			break;
+		}
+		ws->send("ok " + name, uWS::OpCode::TEXT);
+	}
+
+	static const char *commandName(ControlCommandType type) noexcept
+	{
+		switch (type) {
+		case ControlCommandType::Pause:
+			return "pause";
+		case ControlCommandType::Resume:
+			return "resume";
+		case ControlCommandType::SwitchModel:
+			return "model";
+		case ControlCommandType::RequestSnapshot:
+			return "snapshot";
+		case ControlCommandType::SetPartialRate:
+			return "partial-rate";
+		case ControlCommandType::Subscribe:
+			return "subscribe";
+		case ControlCommandType::Unsubscribe:
+			return "unsubscribe";
+		case ControlCommandType::SetFormat:
+			return "format";
+		}
+		return "unknown";
+	}
+
 	// Dependencies
 	const BridgeUtils::ILogger &logger_; ///< Reference to the logging interface.
 
 	// Configuration
 	const int port_; ///< Port number to listen on.
+	ControlCommandQueue *const controlCommandQueue_; ///< Destination of forwarded control commands (may be null).
+	const BroadcastWebSocketServerOptions options_;  ///< Connection tunables.
 
 	// Threading and State
 	std::thread serverThread_;  ///< The thread running the uWebSockets event loop.
@@ -399,16 +1041,37 @@ private:
 
 	// uWebSockets Objects (valid only within the server thread or under mutex protection)
 	us_listen_socket_t *listen_socket_; ///< Raw pointer to the underlying listen socket (managed by uSockets).
-	uWS::App *app_;                     ///< Pointer to the uWS::App instance (lives on serverThread_ stack).
+	AppType *app_;                      ///< Pointer to the uWS app instance (lives on serverThread_ stack).
 	uWS::Loop *eventLoop_;              ///< Pointer to the event loop running on serverThread_.
 
+	// Connection registry and statistics (event loop thread only)
+	ConnectionRegistry<ClientWebSocket> clients_; ///< Currently connected clients.
+	std::vector<SseClient> sseClients_;           ///< Currently open Server-Sent Events streams.
+	us_timer_t *sseKeepAliveTimer_ = nullptr; ///< Periodically writes SSE comments to keep streams open.
+	us_listen_socket_t *unixListenSocket_ = nullptr; ///< Listen socket on options_.unixSocketPath, if any.
+
+#ifndef _WIN32
+	std::unique_ptr<UnixFramedServer> unixFramedServer_; ///< Length-prefixed transport, if configured.
+#endif
+	std::uint64_t nextClientId_ = 0;         ///< Last assigned client id.
+	ServerStats stats_;                      ///< Counters aggregated over all connections.
+
 	// Synchronization
 	std::mutex
 		appMutex_; ///< Mutex protecting access to app_, eventLoop_, and listen_socket_ pointers from different threads.
-
-	// Constants
-	static constexpr const char *broadcastTopic = "broadcast"; ///< Topic name used for broadcasting messages.
 };
 
+inline std::unique_ptr<BroadcastWebSocketServer>
+BroadcastWebSocketServer::create(const BridgeUtils::ILogger &logger, int port, ControlCommandQueue *controlCommandQueue,
+				 BroadcastWebSocketServerOptions options)
+{
+	if (options.tls.enabled()) {
+		return std::make_unique<BasicBroadcastWebSocketServer<true>>(logger, port, controlCommandQueue,
+									    std::move(options));
+	}
+	return std::make_unique<BasicBroadcastWebSocketServer<false>>(logger, port, controlCommandQueue,
+								     std::move(options));
+}
+
 } // namespace WebSocket
 } // namespace KaitoTokyo
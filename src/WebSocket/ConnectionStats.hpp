@@ -0,0 +1,242 @@
+/*
+WebSocket
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <optional>
+#include <string_view>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+
+namespace KaitoTokyo {
+namespace WebSocket {
+
+/**
+ * @brief Bit flags for the topics a client can subscribe to.
+ */
+enum TopicMask : std::uint32_t {
+	NoTopic = 0,
+	BroadcastTopicBit = 1u << 0,
+	FinalTopicBit = 1u << 1,
+	PartialTopicBit = 1u << 2,
+	DefaultTopics = BroadcastTopicBit | FinalTopicBit | PartialTopicBit,
+};
+
+/**
+ * @brief Maps a topic name to its bit, or NoTopic if the name is unknown.
+ */
+inline std::uint32_t topicBit(std::string_view topic) noexcept
+{
+	if (topic == "broadcast") {
+		return BroadcastTopicBit;
+	} else if (topic == "final") {
+		return FinalTopicBit;
+	} else if (topic == "partial") {
+		return PartialTopicBit;
+	}
+	return NoTopic;
+}
+
+/**
+ * @brief Representations a client can ask to receive messages in.
+ */
+enum class MessageFormat : std::uint8_t {
+	Json,    ///< The Vosk result JSON as produced by the recognizer, including word timings if enabled.
+	Compact, ///< Single-line {"type":"final"|"partial","text":"..."} without any other fields.
+	Text,    ///< The recognized text only, as plain UTF-8.
+};
+
+inline constexpr std::size_t messageFormatCount = 3;
+
+/**
+ * @brief Maps a format name ("json", "compact" or "text") to the format.
+ */
+inline std::optional<MessageFormat> parseMessageFormat(std::string_view name) noexcept
+{
+	if (name == "json") {
+		return MessageFormat::Json;
+	} else if (name == "compact") {
+		return MessageFormat::Compact;
+	} else if (name == "text") {
+		return MessageFormat::Text;
+	}
+	return std::nullopt;
+}
+
+inline const char *messageFormatName(MessageFormat format) noexcept
+{
+	switch (format) {
+	case MessageFormat::Compact:
+		return "compact";
+	case MessageFormat::Text:
+		return "text";
+	default:
+		return "json";
+	}
+}
+
+/**
+ * @brief Per-connection state stored inline in each uWS socket.
+ *
+ * It has a fixed size and is only ever touched on the event loop thread, so updating the
+ * counters on every message needs neither allocation nor atomics.
+ */
+struct PerSocketData {
+	std::uint64_t id = 0;
+	std::chrono::system_clock::time_point connectedAt{};
+	std::uint64_t bytesSent = 0;
+	std::uint64_t messagesSent = 0;
+	std::uint64_t messagesDropped = 0;
+	std::uint32_t subscriptions = NoTopic;
+	MessageFormat format = MessageFormat::Json;
+	bool controlAllowed = false;   ///< Connected from this machine, so it may send control commands.
+	std::size_t registryIndex = 0; ///< Position in the server's client registry, for O(1) removal.
+};
+
+/**
+ * @brief Counters aggregated over the whole lifetime of a server, including closed connections.
+ */
+struct ServerStats {
+	std::uint64_t totalConnections = 0;
+	std::uint64_t totalBytesSent = 0;
+	std::uint64_t totalMessagesSent = 0;
+	std::uint64_t totalMessagesDropped = 0;
+	std::uint64_t serializationHits = 0;   ///< Representations served from a message's cache.
+	std::uint64_t serializationMisses = 0; ///< Representations serialized on first demand.
+};
+
+/**
+ * @brief Appends the JSON representation of a single connection to the buffer.
+ */
+inline void formatConnectionStats(fmt::memory_buffer &buffer, const PerSocketData &data,
+				  std::size_t bufferedAmount, std::chrono::system_clock::time_point now)
+{
+	const auto connectedSeconds = std::chrono::duration_cast<std::chrono::seconds>(now - data.connectedAt).count();
+	const auto connectedAtMs =
+		std::chrono::duration_cast<std::chrono::milliseconds>(data.connectedAt.time_since_epoch()).count();
+	fmt::format_to(
+		std::back_inserter(buffer),
+		R"({{"id":{},"connectedAt":{},"connectedSeconds":{},"bytesSent":{},"messagesSent":{},"messagesDropped":{},"bufferedAmount":{},"format":"{}","subscriptions":[)",
+		data.id, connectedAtMs, connectedSeconds, data.bytesSent, data.messagesSent, data.messagesDropped,
+		bufferedAmount, messageFormatName(data.format));
+	const char *separator = "";
+	for (const auto &[bit, name] : {std::pair{BroadcastTopicBit, "broadcast"}, std::pair{FinalTopicBit, "final"},
+					std::pair{PartialTopicBit, "partial"}}) {
+		if (data.subscriptions & bit) {
+			fmt::format_to(std::back_inserter(buffer), R"({}"{}")", separator, name);
+			separator = ",";
+		}
+	}
+	fmt::format_to(std::back_inserter(buffer), "]}}");
+}
+
+/**
+ * @brief A connection as reported on GET /stats.
+ */
+struct ConnectionView {
+	const PerSocketData *data;
+	std::size_t bufferedAmount;
+};
+
+/**
+ * @brief Builds the JSON document served on GET /stats from the server's counters and its open connections.
+ */
+inline std::string formatServerStatsJson(const ServerStats &stats, const std::vector<ConnectionView> &webSockets,
+					 const std::vector<ConnectionView> &sseStreams,
+					 std::chrono::system_clock::time_point now)
+{
+	std::uint64_t bufferedAmount = 0;
+	for (const std::vector<ConnectionView> *connections : {&webSockets, &sseStreams}) {
+		for (const ConnectionView &connection : *connections) {
+			bufferedAmount += connection.bufferedAmount;
+		}
+	}
+
+	fmt::memory_buffer buffer;
+	fmt::format_to(
+		std::back_inserter(buffer),
+		R"({{"clients":{},"sseClients":{},"totalConnections":{},"totalBytesSent":{},"totalMessagesSent":{},"totalMessagesDropped":{},"serializationHits":{},"serializationMisses":{},"bufferedAmount":{},"connections":[)",
+		webSockets.size(), sseStreams.size(), stats.totalConnections, stats.totalBytesSent,
+		stats.totalMessagesSent, stats.totalMessagesDropped, stats.serializationHits, stats.serializationMisses,
+		bufferedAmount);
+	for (std::size_t i = 0; i < webSockets.size(); ++i) {
+		if (i > 0) {
+			buffer.push_back(',');
+		}
+		formatConnectionStats(buffer, *webSockets[i].data, webSockets[i].bufferedAmount, now);
+	}
+	fmt::format_to(std::back_inserter(buffer), R"(],"sseConnections":[)");
+	for (std::size_t i = 0; i < sseStreams.size(); ++i) {
+		if (i > 0) {
+			buffer.push_back(',');
+		}
+		formatConnectionStats(buffer, *sseStreams[i].data, sseStreams[i].bufferedAmount, now);
+	}
+	fmt::format_to(std::back_inserter(buffer), "]}}");
+	return fmt::to_string(buffer);
+}
+
+/**
+ * @brief The open connections of a server, removable in O(1) by swapping in the last entry.
+ *
+ * Client is anything with a PerSocketData *getUserData(), such as a uWS WebSocket. Each entry remembers its
+ * position in PerSocketData::registryIndex. Only ever touched on the event loop thread.
+ */
+template<typename Client> class ConnectionRegistry {
+public:
+	void add(Client *client)
+	{
+		client->getUserData()->registryIndex = clients.size();
+		clients.push_back(client);
+	}
+
+	/**
+	 * @return false if the client was not registered.
+	 */
+	bool remove(Client *client) noexcept
+	{
+		const std::size_t index = client->getUserData()->registryIndex;
+		if (index >= clients.size() || clients[index] != client) {
+			return false;
+		}
+		clients[index] = clients.back();
+		clients[index]->getUserData()->registryIndex = index;
+		clients.pop_back();
+		return true;
+	}
+
+	std::size_t size() const noexcept { return clients.size(); }
+	bool empty() const noexcept { return clients.empty(); }
+
+	typename std::vector<Client *>::const_iterator begin() const noexcept { return clients.begin(); }
+	typename std::vector<Client *>::const_iterator end() const noexcept { return clients.end(); }
+
+private:
+	std::vector<Client *> clients;
+};
+
+} // namespace WebSocket
+} // namespace KaitoTokyo
@@ -0,0 +1,161 @@
+/*
+WebSocket
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdlib>
+#include <stdexcept>
+#include <string_view>
+#include <string>
+
+#include <SpscQueue.hpp>
+
+namespace KaitoTokyo {
+namespace WebSocket {
+
+/**
+ * @brief Kinds of control commands accepted from WebSocket clients.
+ */
+enum class ControlCommandType {
+	Pause,           ///< "pause": Stop feeding audio to the recognizer.
+	Resume,          ///< "resume": Resume feeding audio to the recognizer.
+	SwitchModel,     ///< "model <path>": Load another Vosk model from the configured models directory.
+	RequestSnapshot, ///< "snapshot": Publish the current partial result immediately.
+	SetPartialRate,  ///< "partial-rate <hz>": Limit partial results per second. 0 disables partials.
+	Subscribe,       ///< "subscribe <topic>": Handled by the server on the event loop.
+	Unsubscribe,     ///< "unsubscribe <topic>": Handled by the server on the event loop.
+	SetFormat,       ///< "format <json|compact|text>": Handled by the server on the event loop.
+};
+
+/**
+ * @brief A parsed control command.
+ *
+ * The wire format is a single text frame containing the command name optionally followed by
+ * one space-separated argument, e.g. "partial-rate 5" or "model /path/to/vosk-model".
+ */
+struct ControlCommand {
+	ControlCommandType type;
+	std::string argument;
+	double partialRate = 0.0;
+
+	/**
+	 * @brief Parses a control command from a text frame.
+	 * @param text The received text frame.
+	 * @return The parsed command.
+	 * @throws std::invalid_argument if the frame is not a valid command.
+	 */
+	static ControlCommand parse(std::string_view text)
+	{
+		text = trim(text);
+		const std::size_t separator = text.find(' ');
+		const std::string_view name = text.substr(0, separator);
+		const std::string_view argument =
+			separator == std::string_view::npos ? std::string_view{} : trim(text.substr(separator + 1));
+
+		if (name == "pause") {
+			return withoutArgument(ControlCommandType::Pause, name, argument);
+		} else if (name == "resume") {
+			return withoutArgument(ControlCommandType::Resume, name, argument);
+		} else if (name == "snapshot") {
+			return withoutArgument(ControlCommandType::RequestSnapshot, name, argument);
+		} else if (name == "model") {
+			return withArgument(ControlCommandType::SwitchModel, name, argument);
+		} else if (name == "subscribe") {
+			return withArgument(ControlCommandType::Subscribe, name, argument);
+		} else if (name == "unsubscribe") {
+			return withArgument(ControlCommandType::Unsubscribe, name, argument);
+		} else if (name == "format") {
+			return withArgument(ControlCommandType::SetFormat, name, argument);
+		} else if (name == "partial-rate") {
+			ControlCommand command = withArgument(ControlCommandType::SetPartialRate, name, argument);
+			const std::string value(argument);
+			char *end = nullptr;
+			command.partialRate = std::strtod(value.c_str(), &end);
+			if (end != value.c_str() + value.size() || !(command.partialRate >= 0.0) ||
+			    command.partialRate > 1000.0) {
+				throw std::invalid_argument("partial-rate expects a number between 0 and 1000");
+			}
+			return command;
+		}
+
+		throw std::invalid_argument("unknown command: " + std::string(name));
+	}
+
+private:
+	static std::string_view trim(std::string_view text) noexcept
+	{
+		const std::size_t first = text.find_first_not_of(" \t\r\n");
+		if (first == std::string_view::npos) {
+			return {};
+		}
+		const std::size_t last = text.find_last_not_of(" \t\r\n");
+		return text.substr(first, last - first + 1);
+	}
+
+	static ControlCommand withoutArgument(ControlCommandType type, std::string_view name, std::string_view argument)
+	{
+		if (!argument.empty()) {
+			throw std::invalid_argument(std::string(name) + " takes no argument");
+		}
+		return ControlCommand{type, {}};
+	}
+
+	static ControlCommand withArgument(ControlCommandType type, std::string_view name, std::string_view argument)
+	{
+		if (argument.empty()) {
+			throw std::invalid_argument(std::string(name) + " requires an argument");
+		}
+		return ControlCommand{type, std::string(argument)};
+	}
+};
+
+/**
+ * @brief Queue carrying commands from the server's event loop to the owning plugin context.
+ * The event loop is the only producer and the owner's processing thread is the only consumer.
+ */
+using ControlCommandQueue = BridgeUtils::SpscQueue<ControlCommand>;
+
+/**
+ * @brief Tells whether a peer address, in the binary form uSockets reports, belongs to this machine.
+ *
+ * IPv4 127.0.0.0/8, IPv6 ::1 and IPv4-mapped loopback addresses count as local, as does an empty address,
+ * which is what connections over a Unix domain socket report.
+ */
+inline bool isLocalPeerAddress(std::string_view address) noexcept
+{
+	const auto byte = [address](std::size_t i) { return static_cast<unsigned char>(address[i]); };
+	if (address.empty()) {
+		return true;
+	} else if (address.size() == 4) {
+		return byte(0) == 127;
+	} else if (address.size() != 16) {
+		return false;
+	}
+	for (std::size_t i = 0; i < 10; ++i) {
+		if (byte(i) != 0) {
+			return false;
+		}
+	}
+	if (byte(10) == 0xff && byte(11) == 0xff) {
+		return byte(12) == 127;
+	}
+	return byte(10) == 0 && byte(11) == 0 && byte(12) == 0 && byte(13) == 0 && byte(14) == 0 && byte(15) == 1;
+}
+
+} // namespace WebSocket
+} // namespace KaitoTokyo
@@ -0,0 +1,68 @@
+/*
+WebSocket
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "ConnectionStats.hpp"
+
+namespace KaitoTokyo {
+namespace WebSocket {
+
+/**
+ * @brief The comment written to idle Server-Sent Events streams so that they are not closed for inactivity.
+ */
+inline constexpr std::string_view sseKeepAliveComment = ":\n\n";
+
+/**
+ * @brief Frames one payload as a Server-Sent Event and passes it to write(part) piece by piece, without
+ * re-encoding it.
+ *
+ * Final and partial results are named after their topic, and broadcast messages use the default event type.
+ * Multi-line payloads (Vosk pretty-prints its JSON) are split into several "data:" fields, which the client
+ * joins with newlines again.
+ * @return The number of bytes written.
+ */
+template<typename Write> std::size_t writeSseEvent(Write &&write, std::uint32_t topicBits, std::string_view message)
+{
+	std::size_t written = 0;
+	const auto append = [&](std::string_view part) {
+		write(part);
+		written += part.size();
+	};
+	if (topicBits & FinalTopicBit) {
+		append("event: final\n");
+	} else if (topicBits & PartialTopicBit) {
+		append("event: partial\n");
+	}
+	for (std::string_view rest = message; !rest.empty();) {
+		const std::size_t newline = rest.find('\n');
+		append("data: ");
+		append(rest.substr(0, newline));
+		append("\n");
+		rest = newline == std::string_view::npos ? std::string_view{} : rest.substr(newline + 1);
+	}
+	append("\n");
+	return written;
+}
+
+} // namespace WebSocket
+} // namespace KaitoTokyo
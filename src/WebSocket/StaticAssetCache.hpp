@@ -0,0 +1,294 @@
+/*
+WebSocket
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+#include <string_view>
+#include <string>
+
+#include <brotli/encode.h>
+#include <fmt/format.h>
+#include <zlib.h>
+
+namespace KaitoTokyo {
+namespace WebSocket {
+
+/**
+ * @brief Content codings a static asset can be served with.
+ */
+enum class ContentEncoding { Identity, Gzip, Brotli };
+
+/**
+ * @brief A static file held in memory together with its precompressed variants.
+ *
+ * A compressed variant is left empty when it would not be smaller than the identity body.
+ */
+struct StaticAsset {
+	std::string contentType;
+	std::string identity;
+	std::string gzip;
+	std::string brotli;
+	// Strong ETags including the quotes. Each coding is a distinct representation with its own validator.
+	std::string identityEtag;
+	std::string gzipEtag;
+	std::string brotliEtag;
+
+	/**
+	 * @brief Returns the encoding actually served, falling back when a compressed variant is not available.
+	 */
+	ContentEncoding effectiveEncoding(ContentEncoding encoding) const noexcept
+	{
+		if (encoding == ContentEncoding::Brotli && brotli.empty()) {
+			encoding = gzip.empty() ? ContentEncoding::Identity : ContentEncoding::Gzip;
+		}
+		if (encoding == ContentEncoding::Gzip && gzip.empty()) {
+			encoding = ContentEncoding::Identity;
+		}
+		return encoding;
+	}
+
+	/**
+	 * @brief The body of the representation served for the encoding.
+	 */
+	const std::string &body(ContentEncoding encoding) const noexcept
+	{
+		switch (effectiveEncoding(encoding)) {
+		case ContentEncoding::Brotli:
+			return brotli;
+		case ContentEncoding::Gzip:
+			return gzip;
+		default:
+			return identity;
+		}
+	}
+
+	/**
+	 * @brief The ETag of the representation served for the encoding.
+	 */
+	const std::string &etag(ContentEncoding encoding) const noexcept
+	{
+		switch (effectiveEncoding(encoding)) {
+		case ContentEncoding::Brotli:
+			return brotliEtag;
+		case ContentEncoding::Gzip:
+			return gzipEtag;
+		default:
+			return identityEtag;
+		}
+	}
+};
+
+/**
+ * @brief An immutable in-memory cache of static assets with precomputed gzip and brotli variants.
+ *
+ * Everything is read and compressed once when the cache is built, so serving a request involves
+ * neither disk I/O nor compression work. The cache is read-only afterwards and may be shared.
+ */
+class StaticAssetCache {
+public:
+	/**
+	 * @brief Loads every regular file of a directory (non-recursively).
+	 * @param directory The directory to load.
+	 * @param urlPrefix The URL path the files are served under, e.g. "/overlay/".
+	 * @throws std::runtime_error if a file cannot be read or compressed.
+	 */
+	static StaticAssetCache loadDirectory(const std::filesystem::path &directory, std::string_view urlPrefix)
+	{
+		StaticAssetCache cache;
+		for (const auto &entry : std::filesystem::directory_iterator(directory)) {
+			if (!entry.is_regular_file()) {
+				continue;
+			}
+			std::ifstream stream(entry.path(), std::ios::binary);
+			if (!stream) {
+				throw std::runtime_error("Failed to open static asset: " + entry.path().string());
+			}
+			std::string body((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+			cache.add(std::string(urlPrefix) + entry.path().filename().string(),
+				  contentTypeFor(entry.path().extension().string()), std::move(body));
+		}
+		return cache;
+	}
+
+	/**
+	 * @brief Adds an asset, computing its compressed variants and ETags.
+	 */
+	void add(std::string urlPath, std::string contentType, std::string body)
+	{
+		StaticAsset asset;
+		asset.contentType = std::move(contentType);
+		asset.gzip = compressGzip(body);
+		asset.brotli = compressBrotli(body);
+		if (asset.gzip.size() >= body.size()) {
+			asset.gzip.clear();
+		}
+		if (asset.brotli.size() >= body.size()) {
+			asset.brotli.clear();
+		}
+		const std::string tag = fmt::format("{:016x}-{:x}", fnv1a(body), body.size());
+		asset.identityEtag = "\"" + tag + "\"";
+		asset.gzipEtag = "\"" + tag + "-gz\"";
+		asset.brotliEtag = "\"" + tag + "-br\"";
+		asset.identity = std::move(body);
+		assets[std::move(urlPath)] = std::move(asset);
+	}
+
+	/**
+	 * @brief Looks up an asset. A path ending with '/' resolves to its index.html.
+	 * @return The asset, or nullptr if there is none.
+	 */
+	const StaticAsset *find(std::string_view urlPath) const
+	{
+		std::string key(urlPath);
+		if (!key.empty() && key.back() == '/') {
+			key += "index.html";
+		}
+		auto it = assets.find(key);
+		return it == assets.end() ? nullptr : &it->second;
+	}
+
+	std::size_t size() const noexcept { return assets.size(); }
+
+	/**
+	 * @brief Picks the preferred coding accepted by an Accept-Encoding header value.
+	 */
+	static ContentEncoding negotiate(std::string_view acceptEncoding) noexcept
+	{
+		bool acceptsGzip = false;
+		bool acceptsBrotli = false;
+		while (!acceptEncoding.empty()) {
+			const std::size_t comma = acceptEncoding.find(',');
+			std::string_view item = acceptEncoding.substr(0, comma);
+			acceptEncoding = comma == std::string_view::npos ? std::string_view{}
+									 : acceptEncoding.substr(comma + 1);
+
+			const std::size_t semicolon = item.find(';');
+			std::string_view coding = trim(item.substr(0, semicolon));
+			if (semicolon != std::string_view::npos) {
+				const std::string_view parameter = trim(item.substr(semicolon + 1));
+				if (parameter == "q=0" || parameter == "q=0.0" || parameter == "q=0.00" ||
+				    parameter == "q=0.000") {
+					continue;
+				}
+			}
+			acceptsGzip = acceptsGzip || coding == "gzip";
+			acceptsBrotli = acceptsBrotli || coding == "br";
+		}
+		return acceptsBrotli ? ContentEncoding::Brotli
+				     : (acceptsGzip ? ContentEncoding::Gzip : ContentEncoding::Identity);
+	}
+
+	static const char *contentEncodingHeader(ContentEncoding encoding) noexcept
+	{
+		switch (encoding) {
+		case ContentEncoding::Brotli:
+			return "br";
+		case ContentEncoding::Gzip:
+			return "gzip";
+		default:
+			return nullptr;
+		}
+	}
+
+private:
+	std::map<std::string, StaticAsset, std::less<>> assets;
+
+	static std::string_view trim(std::string_view text) noexcept
+	{
+		const std::size_t first = text.find_first_not_of(" \t");
+		if (first == std::string_view::npos) {
+			return {};
+		}
+		return text.substr(first, text.find_last_not_of(" \t") - first + 1);
+	}
+
+	static std::string contentTypeFor(const std::string &extension)
+	{
+		if (extension == ".html") {
+			return "text/html; charset=utf-8";
+		} else if (extension == ".js") {
+			return "text/javascript; charset=utf-8";
+		} else if (extension == ".css") {
+			return "text/css; charset=utf-8";
+		} else if (extension == ".json") {
+			return "application/json";
+		} else if (extension == ".svg") {
+			return "image/svg+xml";
+		} else if (extension == ".png") {
+			return "image/png";
+		}
+		return "application/octet-stream";
+	}
+
+	static std::uint64_t fnv1a(std::string_view data) noexcept
+	{
+		std::uint64_t hash = 0xcbf29ce484222325ull;
+		for (unsigned char c : data) {
+			hash ^= c;
+			hash *= 0x100000001b3ull;
+		}
+		return hash;
+	}
+
+	static std::string compressGzip(const std::string &input)
+	{
+		z_stream stream{};
+		// 15 window bits + 16 selects the gzip wrapper
+		if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+			throw std::runtime_error("deflateInit2 failed");
+		}
+		std::string output(deflateBound(&stream, static_cast<uLong>(input.size())), '\0');
+		stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+		stream.avail_in = static_cast<uInt>(input.size());
+		stream.next_out = reinterpret_cast<Bytef *>(output.data());
+		stream.avail_out = static_cast<uInt>(output.size());
+		const int result = deflate(&stream, Z_FINISH);
+		const uLong totalOut = stream.total_out;
+		deflateEnd(&stream);
+		if (result != Z_STREAM_END) {
+			throw std::runtime_error("deflate failed");
+		}
+		output.resize(totalOut);
+		return output;
+	}
+
+	static std::string compressBrotli(const std::string &input)
+	{
+		std::size_t encodedSize = BrotliEncoderMaxCompressedSize(input.size());
+		if (encodedSize == 0) {
+			throw std::runtime_error("Static asset is too large for brotli");
+		}
+		std::string output(encodedSize, '\0');
+		if (!BrotliEncoderCompress(BROTLI_MAX_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, input.size(),
+					   reinterpret_cast<const std::uint8_t *>(input.data()), &encodedSize,
+					   reinterpret_cast<std::uint8_t *>(output.data()))) {
+			throw std::runtime_error("BrotliEncoderCompress failed");
+		}
+		output.resize(encodedSize);
+		return output;
+	}
+};
+
+} // namespace WebSocket
+} // namespace KaitoTokyo
@@ -0,0 +1,81 @@
+/*
+WebSocket
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <string>
+
+namespace KaitoTokyo {
+namespace WebSocket {
+
+/**
+ * @brief Certificate and session resumption settings for serving wss://.
+ */
+struct TlsOptions {
+	std::string certFile;   ///< PEM certificate chain. TLS is disabled while this is empty.
+	std::string keyFile;    ///< PEM private key.
+	std::string passphrase; ///< Passphrase of an encrypted private key, if any.
+
+	/**
+	 * @brief Lifetime of resumable sessions. Overlay reconnects within this window skip the full handshake.
+	 */
+	unsigned int sessionLifetimeSeconds = 2 * 60 * 60;
+
+	/**
+	 * @brief Resume through stateless session tickets in addition to the server-side session cache.
+	 */
+	bool sessionTickets = true;
+
+	bool enabled() const noexcept { return !certFile.empty(); }
+};
+
+} // namespace WebSocket
+} // namespace KaitoTokyo
+
+#ifdef WEBSOCKET_TLS
+
+// uSockets is built with OpenSSL for WEBSOCKET_TLS, so its native handle is an OpenSSL SSL_CTX.
+#include <openssl/ssl.h>
+
+namespace KaitoTokyo {
+namespace WebSocket {
+
+/**
+ * @brief Enables TLS session resumption on a server context.
+ *
+ * Resumption uses the server-side session cache and, unless disabled, session tickets whose keys
+ * are generated per context. Both only live as long as the context, i.e. until the server restarts.
+ * @param context The SSL_CTX of the server, e.g. the native handle of a uWS::SSLApp.
+ */
+inline void configureTlsSessionResumption(SSL_CTX *context, const TlsOptions &options)
+{
+	static const unsigned char sessionIdContext[] = "live-transcribe-fine";
+	SSL_CTX_set_session_id_context(context, sessionIdContext, sizeof(sessionIdContext) - 1);
+	SSL_CTX_set_session_cache_mode(context, SSL_SESS_CACHE_SERVER);
+	SSL_CTX_set_timeout(context, static_cast<long>(options.sessionLifetimeSeconds));
+	if (options.sessionTickets) {
+		SSL_CTX_clear_options(context, SSL_OP_NO_TICKET);
+	} else {
+		SSL_CTX_set_options(context, SSL_OP_NO_TICKET);
+	}
+}
+
+} // namespace WebSocket
+} // namespace KaitoTokyo
+
+#endif // WEBSOCKET_TLS
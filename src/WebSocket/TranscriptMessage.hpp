@@ -0,0 +1,235 @@
+/*
+WebSocket
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <string>
+
+#include "ConnectionStats.hpp"
+
+namespace KaitoTokyo {
+namespace WebSocket {
+
+/**
+ * @brief A published message together with its lazily produced representations.
+ *
+ * The source payload is kept as is. Every other representation is serialized at most once, on
+ * the first request, and then shared by every connection and transport that asks for the same
+ * format. Messages on the broadcast topic are opaque, so every format yields the source payload.
+ *
+ * source() may be read from any thread. representation() fills the cache and must only be called
+ * from one thread, the server's event loop.
+ */
+class TranscriptMessage {
+public:
+	TranscriptMessage(std::uint32_t topicBits, std::string source)
+		: topicBits_(topicBits),
+		  source_(std::move(source))
+	{
+	}
+
+	std::uint32_t topicBits() const noexcept { return topicBits_; }
+	const std::string &source() const noexcept { return source_; }
+
+	/**
+	 * @brief Returns the message in the given format, serializing it on first use. Requests for the source
+	 * payload never touch the cache and are not counted.
+	 */
+	std::string_view representation(MessageFormat format) const
+	{
+		if (format == MessageFormat::Json || !(topicBits_ & (FinalTopicBit | PartialTopicBit))) {
+			return source_;
+		}
+
+		std::optional<std::string> &cached = cache_[static_cast<std::size_t>(format)];
+		if (cached) {
+			++hits_;
+		} else {
+			++misses_;
+			cached = serialize(format);
+		}
+		return *cached;
+	}
+
+	std::uint64_t hits() const noexcept { return hits_; }     ///< Requests answered from the cache.
+	std::uint64_t misses() const noexcept { return misses_; } ///< Representations actually serialized.
+
+private:
+	const std::uint32_t topicBits_;
+	const std::string source_;
+	mutable std::array<std::optional<std::string>, messageFormatCount> cache_;
+	mutable std::uint64_t hits_ = 0;
+	mutable std::uint64_t misses_ = 0;
+
+	static constexpr unsigned long replacementCharacter = 0xfffd; ///< Stands in for unpaired surrogates.
+
+	std::string serialize(MessageFormat format) const
+	{
+		const bool isFinal = topicBits_ & FinalTopicBit;
+		// Vosk puts the transcript into "text" for final results and into "partial" otherwise.
+		const std::string_view escaped = findStringField(source_, isFinal ? "text" : "partial");
+		if (format == MessageFormat::Text) {
+			return unescape(escaped);
+		}
+
+		std::string compact;
+		compact.reserve(escaped.size() + 32);
+		compact += isFinal ? R"({"type":"final","text":")" : R"({"type":"partial","text":")";
+		compact += escaped;
+		compact += "\"}";
+		return compact;
+	}
+
+	/**
+	 * @brief Finds a string member and returns its still-escaped contents, or an empty view.
+	 */
+	static std::string_view findStringField(std::string_view json, std::string_view key) noexcept
+	{
+		const std::string quotedKey = "\"" + std::string(key) + "\"";
+		for (std::size_t pos = json.find(quotedKey); pos != std::string_view::npos;
+		     pos = json.find(quotedKey, pos + 1)) {
+			std::size_t cursor = json.find_first_not_of(" \t\r\n", pos + quotedKey.size());
+			if (cursor == std::string_view::npos || json[cursor] != ':') {
+				continue;
+			}
+			cursor = json.find_first_not_of(" \t\r\n", cursor + 1);
+			if (cursor == std::string_view::npos || json[cursor] != '"') {
+				continue;
+			}
+			const std::size_t begin = cursor + 1;
+			for (std::size_t i = begin; i < json.size(); ++i) {
+				if (json[i] == '\\') {
+					++i;
+				} else if (json[i] == '"') {
+					return json.substr(begin, i - begin);
+				}
+			}
+			return {};
+		}
+		return {};
+	}
+
+	static std::string unescape(std::string_view escaped)
+	{
+		std::string text;
+		text.reserve(escaped.size());
+		for (std::size_t i = 0; i < escaped.size(); ++i) {
+			if (escaped[i] != '\\' || i + 1 == escaped.size()) {
+				text += escaped[i];
+				continue;
+			}
+			switch (const char c = escaped[++i]) {
+			case 'b':
+				text += '\b';
+				break;
+			case 'f':
+				text += '\f';
+				break;
+			case 'n':
+				text += '\n';
+				break;
+			case 'r':
+				text += '\r';
+				break;
+			case 't':
+				text += '\t';
+				break;
+			case 'u': {
+				const long unit = parseHexQuad(escaped, i + 1);
+				if (unit < 0) {
+					text += "\\u";
+					break;
+				}
+				i += 4;
+				unsigned long codePoint = static_cast<unsigned long>(unit);
+				if (unit >= 0xd800 && unit <= 0xdbff) {
+					// A high surrogate combines with an escaped low surrogate right after it
+					const bool escapeFollows = i + 2 < escaped.size() && escaped[i + 1] == '\\' &&
+								   escaped[i + 2] == 'u';
+					const long low = escapeFollows ? parseHexQuad(escaped, i + 3) : -1;
+					if (low >= 0xdc00 && low <= 0xdfff) {
+						codePoint = 0x10000 + ((codePoint - 0xd800) << 10) +
+							    static_cast<unsigned long>(low - 0xdc00);
+						i += 6;
+					} else {
+						codePoint = replacementCharacter;
+					}
+				} else if (unit >= 0xdc00 && unit <= 0xdfff) {
+					codePoint = replacementCharacter;
+				}
+				appendUtf8(text, codePoint);
+				break;
+			}
+			default:
+				text += c;
+				break;
+			}
+		}
+		return text;
+	}
+
+	/**
+	 * @brief Reads the four hex digits of a unicode escape starting at pos, or returns -1 if there are not four.
+	 */
+	static long parseHexQuad(std::string_view escaped, std::size_t pos) noexcept
+	{
+		if (pos + 4 > escaped.size()) {
+			return -1;
+		}
+		long value = 0;
+		for (std::size_t i = pos; i < pos + 4; ++i) {
+			const char h = escaped[i];
+			const int digit = h >= '0' && h <= '9'   ? h - '0'
+					  : h >= 'a' && h <= 'f' ? h - 'a' + 10
+					  : h >= 'A' && h <= 'F' ? h - 'A' + 10
+								 : -1;
+			if (digit < 0) {
+				return -1;
+			}
+			value = value * 16 + digit;
+		}
+		return value;
+	}
+
+	static void appendUtf8(std::string &text, unsigned long codePoint)
+	{
+		if (codePoint < 0x80) {
+			text += static_cast<char>(codePoint);
+		} else if (codePoint < 0x800) {
+			text += static_cast<char>(0xc0 | (codePoint >> 6));
+			text += static_cast<char>(0x80 | (codePoint & 0x3f));
+		} else if (codePoint < 0x10000) {
+			text += static_cast<char>(0xe0 | (codePoint >> 12));
+			text += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+			text += static_cast<char>(0x80 | (codePoint & 0x3f));
+		} else {
+			text += static_cast<char>(0xf0 | (codePoint >> 18));
+			text += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3f));
+			text += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+			text += static_cast<char>(0x80 | (codePoint & 0x3f));
+		}
+	}
+};
+
+} // namespace WebSocket
+} // namespace KaitoTokyo
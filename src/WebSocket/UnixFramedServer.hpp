@@ -0,0 +1,406 @@
+/*
+WebSocket
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef _WIN32
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <ILogger.hpp>
+
+#include "ConnectionStats.hpp"
+
+namespace KaitoTokyo {
+namespace WebSocket {
+
+/**
+ * @class UnixFramedServer
+ * @brief Streams messages to local consumers over a Unix domain socket with minimal framing.
+ *
+ * Every message is sent as a 5-byte header followed by the payload:
+ *  - bytes 0..3: payload length as an unsigned 32-bit big-endian integer
+ *  - byte 4: topic bit (1 = broadcast, 2 = final, 4 = partial, see TopicMask)
+ *
+ * There is no handshake, masking or per-frame parsing, and clients receive every topic.
+ * Header and payload go straight to the socket with one sendmsg and only the unsent remainder is buffered.
+ * A client whose buffer exceeds maxBackpressure drops messages, like WebSocket clients do, and so does the queue
+ * of messages waiting for the I/O thread if it falls that far behind.
+ *
+ * The socket file is only accessible to the user running OBS, whatever the umask.
+ *
+ * @note This class is non-copyable and non-movable. It is only available on POSIX systems.
+ */
+class UnixFramedServer {
+public:
+	static constexpr std::size_t headerSize = 5;
+	static constexpr std::size_t maxBackpressure = 1 * 1024 * 1024;
+
+	/**
+     * @brief Constructor. Does not start listening yet.
+     * @param logger Reference to the logger implementation.
+     * @param path Filesystem path of the socket. A stale socket file at that path is replaced.
+     */
+	UnixFramedServer(const BridgeUtils::ILogger &logger, std::string path) : logger_(logger), path_(std::move(path))
+	{
+	}
+
+	~UnixFramedServer() { stop(); }
+
+	UnixFramedServer(const UnixFramedServer &) = delete;
+	UnixFramedServer &operator=(const UnixFramedServer &) = delete;
+	UnixFramedServer(UnixFramedServer &&) = delete;
+	UnixFramedServer &operator=(UnixFramedServer &&) = delete;
+
+	/**
+     * @brief Binds the socket and starts the I/O thread.
+     * @return True if the socket is listening.
+     */
+	bool start()
+	{
+		sockaddr_un address{};
+		address.sun_family = AF_UNIX;
+		if (path_.empty() || path_.size() >= sizeof(address.sun_path)) {
+			logger_.error("Invalid Unix socket path: '{}'", path_);
+			return false;
+		}
+		std::memcpy(address.sun_path, path_.c_str(), path_.size() + 1);
+
+		int pipeFds[2];
+		if (::pipe(pipeFds) != 0) {
+			logger_.error("Failed to create wake-up pipe for Unix socket server: {}", std::strerror(errno));
+			return false;
+		}
+		wakeReadFd_ = pipeFds[0];
+		wakeWriteFd_ = pipeFds[1];
+		setNonBlocking(wakeReadFd_);
+		setNonBlocking(wakeWriteFd_);
+
+		listenFd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+		removeSocketFile(); // A stale socket file from a crashed session would make bind fail
+		// Nobody can connect before listen, so restricting the file in between leaves no window open
+		if (listenFd_ < 0 || ::bind(listenFd_, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+		    ::chmod(path_.c_str(), S_IRUSR | S_IWUSR) != 0 || ::listen(listenFd_, 16) != 0) {
+			logger_.error("Failed to listen on Unix socket '{}': {}", path_, std::strerror(errno));
+			closeFds();
+			return false;
+		}
+		setNonBlocking(listenFd_);
+
+		running_ = true;
+		thread_ = std::thread(&UnixFramedServer::ioLoop, this);
+		logger_.info("Length-prefixed Unix socket server listening on '{}'.", path_);
+		return true;
+	}
+
+	/**
+     * @brief Stops the I/O thread, disconnects every client and removes the socket file.
+     */
+	void stop()
+	{
+		{
+			// publish checks running_ and wakes the thread under the same lock, so it never writes to a
+			// pipe that is being closed below
+			std::lock_guard<std::mutex> lock(pendingMutex_);
+			if (!running_.exchange(false)) {
+				return;
+			}
+			wake();
+		}
+		if (thread_.joinable()) {
+			thread_.join();
+		}
+		for (Client &client : clients_) {
+			::close(client.fd);
+		}
+		clients_.clear();
+		pending_.clear();
+		pendingBytes_ = 0;
+		closeFds();
+		removeSocketFile();
+		logger_.info("Length-prefixed Unix socket server on '{}' stopped.", path_);
+	}
+
+	/**
+     * @brief Queues a message for every connected client. Thread-safe.
+     * @param topicBits The topic the message belongs to.
+     * @param message The payload, shared with other transports without copying.
+     */
+	void publish(std::uint32_t topicBits, std::shared_ptr<const std::string> message)
+	{
+		std::lock_guard<std::mutex> lock(pendingMutex_);
+		if (!running_) {
+			return;
+		}
+		const std::size_t frameSize = headerSize + message->size();
+		if (!pending_.empty() && pendingBytes_ + frameSize > maxBackpressure) {
+			++pendingDropped_;
+			return;
+		}
+		pendingBytes_ += frameSize;
+		pending_.emplace_back(topicBits, std::move(message));
+		if (pending_.size() == 1) {
+			wake();
+		}
+	}
+
+private:
+	struct Client {
+		int fd;
+		PerSocketData data;
+		std::string buffered; ///< Bytes that could not be written yet.
+	};
+
+	using PendingMessage = std::pair<std::uint32_t, std::shared_ptr<const std::string>>;
+
+	static void setNonBlocking(int fd) { ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL, 0) | O_NONBLOCK); }
+
+	void wake()
+	{
+		const char byte = 0;
+		// A full pipe already guarantees a pending wake-up, so the result can be ignored.
+		[[maybe_unused]] ssize_t result = ::write(wakeWriteFd_, &byte, 1);
+	}
+
+	void removeSocketFile() const
+	{
+		struct stat st;
+		if (::lstat(path_.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+			::unlink(path_.c_str());
+		}
+	}
+
+	void closeFds()
+	{
+		for (int *fd : {&listenFd_, &wakeReadFd_, &wakeWriteFd_}) {
+			if (*fd >= 0) {
+				::close(*fd);
+				*fd = -1;
+			}
+		}
+	}
+
+	void ioLoop()
+	{
+		std::vector<pollfd> pollFds;
+		std::vector<PendingMessage> batch;
+		while (running_) {
+			pollFds.clear();
+			pollFds.push_back({listenFd_, POLLIN, 0});
+			pollFds.push_back({wakeReadFd_, POLLIN, 0});
+			for (const Client &client : clients_) {
+				const short events = client.buffered.empty() ? POLLIN : (POLLIN | POLLOUT);
+				pollFds.push_back({client.fd, events, 0});
+			}
+
+			if (::poll(pollFds.data(), static_cast<nfds_t>(pollFds.size()), -1) < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				logger_.error("poll failed on Unix socket server: {}", std::strerror(errno));
+				break;
+			}
+
+			// Client events first: indices of pollFds and clients_ only match before clients change.
+			for (std::size_t i = clients_.size(); i-- > 0;) {
+				const short revents = pollFds[i + 2].revents;
+				if (revents & (POLLIN | POLLHUP | POLLERR)) {
+					char discard[256];
+					const ssize_t received = ::recv(clients_[i].fd, discard, sizeof(discard), 0);
+					if (received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+						disconnect(i);
+						continue;
+					}
+				}
+				if ((revents & POLLOUT) && !flushBuffered(clients_[i])) {
+					disconnect(i);
+				}
+			}
+
+			if (pollFds[0].revents & POLLIN) {
+				acceptClients();
+			}
+
+			if (pollFds[1].revents & POLLIN) {
+				char drain[64];
+				while (::read(wakeReadFd_, drain, sizeof(drain)) > 0) {
+				}
+				std::uint64_t dropped;
+				{
+					std::lock_guard<std::mutex> lock(pendingMutex_);
+					batch.swap(pending_);
+					pendingBytes_ = 0;
+					dropped = std::exchange(pendingDropped_, 0);
+				}
+				if (dropped > 0) {
+					logger_.warn("Unix socket server on '{}' fell behind and dropped {} messages.",
+						     path_, dropped);
+				}
+				for (const auto &[topicBits, message] : batch) {
+					sendToAll(topicBits, *message);
+				}
+				batch.clear();
+			}
+		}
+	}
+
+	void acceptClients()
+	{
+		while (true) {
+			const int fd = ::accept(listenFd_, nullptr, nullptr);
+			if (fd < 0) {
+				return;
+			}
+			setNonBlocking(fd);
+#ifdef SO_NOSIGPIPE
+			const int one = 1;
+			::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+			Client client{fd, {}, {}};
+			client.data.id = ++nextClientId_;
+			client.data.connectedAt = std::chrono::system_clock::now();
+			client.data.subscriptions = DefaultTopics;
+			logger_.info("Unix socket client #{} connected to '{}'.", client.data.id, path_);
+			clients_.push_back(std::move(client));
+		}
+	}
+
+	void disconnect(std::size_t index)
+	{
+		Client &client = clients_[index];
+		logger_.info("Unix socket client #{} disconnected after {} bytes sent ({} messages dropped).",
+			     client.data.id, client.data.bytesSent, client.data.messagesDropped);
+		::close(client.fd);
+		clients_[index] = std::move(clients_.back());
+		clients_.pop_back();
+	}
+
+	void sendToAll(std::uint32_t topicBits, std::string_view message)
+	{
+		const auto length = static_cast<std::uint32_t>(message.size());
+		const char header[headerSize] = {static_cast<char>(length >> 24), static_cast<char>(length >> 16),
+						 static_cast<char>(length >> 8), static_cast<char>(length),
+						 static_cast<char>(topicBits)};
+		for (std::size_t i = clients_.size(); i-- > 0;) {
+			if (!sendFrame(clients_[i], {header, headerSize}, message)) {
+				disconnect(i);
+			}
+		}
+	}
+
+	/**
+     * @return False if the connection is broken.
+     */
+	bool sendFrame(Client &client, std::string_view header, std::string_view payload)
+	{
+		const std::size_t frameSize = header.size() + payload.size();
+		if (!client.buffered.empty()) {
+			// Keep ordering: append behind what is already waiting, unless the client is too far behind.
+			if (client.buffered.size() + frameSize > maxBackpressure) {
+				++client.data.messagesDropped;
+				return true;
+			}
+			client.buffered.append(header).append(payload);
+			++client.data.messagesSent;
+			return true;
+		}
+
+		iovec iov[2] = {{const_cast<char *>(header.data()), header.size()},
+				{const_cast<char *>(payload.data()), payload.size()}};
+		msghdr msg{};
+		msg.msg_iov = iov;
+		msg.msg_iovlen = 2;
+#ifdef MSG_NOSIGNAL
+		const ssize_t written = ::sendmsg(client.fd, &msg, MSG_NOSIGNAL);
+#else
+		const ssize_t written = ::sendmsg(client.fd, &msg, 0);
+#endif
+		if (written < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+			return false;
+		}
+		const std::size_t sent = written < 0 ? 0 : static_cast<std::size_t>(written);
+		client.data.bytesSent += sent;
+		++client.data.messagesSent;
+		if (sent < header.size()) {
+			client.buffered.append(header.substr(sent)).append(payload);
+		} else if (sent < frameSize) {
+			client.buffered.append(payload.substr(sent - header.size()));
+		}
+		return true;
+	}
+
+	/**
+     * @return False if the connection is broken.
+     */
+	bool flushBuffered(Client &client)
+	{
+#ifdef MSG_NOSIGNAL
+		const ssize_t written = ::send(client.fd, client.buffered.data(), client.buffered.size(), MSG_NOSIGNAL);
+#else
+		const ssize_t written = ::send(client.fd, client.buffered.data(), client.buffered.size(), 0);
+#endif
+		if (written < 0) {
+			return errno == EAGAIN || errno == EWOULDBLOCK;
+		}
+		client.data.bytesSent += static_cast<std::size_t>(written);
+		client.buffered.erase(0, static_cast<std::size_t>(written));
+		return true;
+	}
+
+	const BridgeUtils::ILogger &logger_;
+	const std::string path_;
+
+	std::atomic<bool> running_{false};
+	std::thread thread_;
+	int listenFd_ = -1;
+	int wakeReadFd_ = -1;
+	int wakeWriteFd_ = -1;
+
+	std::mutex pendingMutex_; ///< Also orders publish against stop, which closes the wake-up pipe.
+	std::vector<PendingMessage> pending_; ///< Messages published since the I/O thread last woke up.
+	std::size_t pendingBytes_ = 0;        ///< Framed size of pending_, limited like Client::buffered.
+	std::uint64_t pendingDropped_ = 0;    ///< Messages dropped because pending_ was full.
+
+	// I/O thread only
+	std::vector<Client> clients_;
+	std::uint64_t nextClientId_ = 0;
+};
+
+} // namespace WebSocket
+} // namespace KaitoTokyo
+
+#endif // _WIN32
@@ -48,5 +48,6 @@ bool obs_module_load(void)
 
 void obs_module_unload(void)
 {
+	main_plugin_context_module_unload();
 	blog(LOG_INFO, "[" PLUGIN_NAME "] plugin unloaded");
 }
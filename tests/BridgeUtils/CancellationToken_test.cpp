@@ -0,0 +1,121 @@
+/*
+Live Transcribe Fine
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include <CancellationToken.hpp>
+
+using namespace KaitoTokyo::BridgeUtils;
+
+TEST(CancellationTokenTest, TokensShareTheStateOfTheirSource)
+{
+	CancellationSource source;
+	const CancellationToken token = source.token();
+	const CancellationToken copy = token;
+
+	EXPECT_TRUE(token);
+	EXPECT_FALSE(CancellationToken());
+	EXPECT_FALSE(copy.isCancelled());
+
+	EXPECT_TRUE(copy.cancel());
+	EXPECT_FALSE(source.cancel());
+	EXPECT_TRUE(source.isCancelled());
+	EXPECT_TRUE(token.isCancelled());
+	EXPECT_FALSE(CancellationToken().cancel());
+}
+
+TEST(CancellationTokenTest, RecycledSlotsStartUncancelled)
+{
+	for (int i = 0; i < 5000; ++i) {
+		CancellationSource source;
+		ASSERT_FALSE(source.isCancelled());
+		source.cancel();
+	}
+
+	// A token keeps its state after the source is gone
+	std::optional<CancellationSource> source(std::in_place);
+	const CancellationToken token = source->token();
+	source->cancel();
+	source.reset();
+	CancellationSource next;
+	EXPECT_TRUE(token.isCancelled());
+	EXPECT_FALSE(next.isCancelled());
+}
+
+TEST(CancellationTokenTest, CallbacksRunOnCancellationUntilDestroyed)
+{
+	CancellationSource source;
+	int first = 0;
+	int second = 0;
+	int removed = 0;
+	{
+		CancellationCallback keep1(source.token(), [&first] { ++first; });
+		CancellationCallback keep2(source.token(), [&second] { ++second; });
+		{
+			CancellationCallback gone(source.token(), [&removed] { ++removed; });
+		}
+		source.cancel();
+		source.cancel();
+	}
+	EXPECT_EQ(first, 1);
+	EXPECT_EQ(second, 1);
+	EXPECT_EQ(removed, 0);
+
+	// Registering on a cancelled token runs the callback right away
+	int late = 0;
+	CancellationCallback callback(source.token(), [&late] { ++late; });
+	EXPECT_EQ(late, 1);
+
+	// A callback may destroy itself
+	CancellationSource other;
+	auto self = std::make_unique<std::optional<CancellationCallback>>();
+	self->emplace(other.token(), [&self] { self->reset(); });
+	other.cancel();
+	EXPECT_FALSE(self->has_value());
+}
+
+TEST(CancellationTokenTest, ConcurrentCancellationRunsEachCallbackOnce)
+{
+	for (int round = 0; round < 200; ++round) {
+		CancellationSource source;
+		std::atomic<int> calls{0};
+		std::vector<std::unique_ptr<CancellationCallback>> callbacks;
+		for (int i = 0; i < 8; ++i) {
+			auto callback = [&calls] { ++calls; };
+			callbacks.push_back(std::make_unique<CancellationCallback>(source.token(), callback));
+		}
+
+		std::vector<std::thread> threads;
+		for (int i = 0; i < 4; ++i) {
+			threads.emplace_back([token = source.token()] { token.cancel(); });
+		}
+		callbacks.resize(4); // Unregisters or waits for the running callbacks
+		for (std::thread &thread : threads) {
+			thread.join();
+		}
+		callbacks.clear();
+		EXPECT_GE(calls.load(), 4);
+		EXPECT_LE(calls.load(), 8);
+	}
+}
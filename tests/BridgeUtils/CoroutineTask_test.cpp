@@ -0,0 +1,115 @@
+/*
+Live Transcribe Fine
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <gtest/gtest.h>
+
+#include <future>
+#include <string>
+#include <thread>
+
+#include <CoroutineTask.hpp>
+
+#include "../TestLoggers.hpp"
+
+using namespace KaitoTokyo::BridgeUtils;
+using KaitoTokyo::Tests::NullLogger;
+
+namespace {
+
+Task<int> parse(QueueExecutor &executor, std::string text)
+{
+	co_await executor.schedule();
+	co_return std::stoi(text);
+}
+
+Task<std::string> twice(QueueExecutor &executor, std::string text, std::thread::id &workerThread)
+{
+	const int value = co_await parse(executor, std::move(text));
+	workerThread = std::this_thread::get_id();
+	co_return std::to_string(value * 2);
+}
+
+std::exception_ptr runToCompletion(Task<> task)
+{
+	std::promise<std::exception_ptr> done;
+	spawn(std::move(task), [&done](std::exception_ptr exception) { done.set_value(exception); });
+	return done.get_future().get();
+}
+
+} // namespace
+
+TEST(CoroutineTaskTest, RunsMultiStageFlowOnTheQueue)
+{
+	NullLogger logger;
+	ThrottledTaskQueue queue(logger, 8);
+	QueueExecutor executor(queue);
+
+	std::string result;
+	std::thread::id workerThread;
+	const auto flow = [&]() -> Task<> { result = co_await twice(executor, "21", workerThread); };
+	EXPECT_EQ(runToCompletion(flow()), nullptr);
+	EXPECT_EQ(result, "42");
+	EXPECT_NE(workerThread, std::this_thread::get_id());
+}
+
+TEST(CoroutineTaskTest, PropagatesExceptionsToTheAwaiter)
+{
+	NullLogger logger;
+	ThrottledTaskQueue queue(logger, 8);
+	QueueExecutor executor(queue);
+
+	std::string result;
+	std::thread::id workerThread;
+	const auto flow = [&]() -> Task<> { result = co_await twice(executor, "not a number", workerThread); };
+	EXPECT_THROW(std::rethrow_exception(runToCompletion(flow())), std::invalid_argument);
+	EXPECT_TRUE(result.empty());
+}
+
+TEST(CoroutineTaskTest, DroppedResumptionCompletesAsCancelled)
+{
+	NullLogger logger;
+	ThrottledTaskQueue queue(logger, 1);
+	QueueExecutor executor(queue);
+
+	std::promise<void> gate;
+	std::promise<void> started;
+	queue.push([&started, opened = gate.get_future().share()](const auto &) {
+		started.set_value();
+		opened.wait();
+	});
+	started.get_future().wait();
+
+	std::promise<std::exception_ptr> first;
+	std::promise<std::exception_ptr> second;
+	const auto step = [&executor]() -> Task<> { co_await executor.schedule(); };
+	spawn(step(), [&first](std::exception_ptr exception) { first.set_value(exception); });
+	spawn(step(), [&second](std::exception_ptr exception) { second.set_value(exception); });
+
+	// The lane holds one task, so the first resumption was dropped by the second push
+	EXPECT_THROW(std::rethrow_exception(first.get_future().get()), OperationCancelled);
+	gate.set_value();
+	EXPECT_EQ(second.get_future().get(), nullptr);
+}
+
+TEST(CoroutineTaskTest, FramePoolRecyclesFrames)
+{
+	void *frame = CoroutineFramePool::allocate(200);
+	CoroutineFramePool::deallocate(frame, 200);
+	EXPECT_EQ(CoroutineFramePool::allocate(250), frame);
+	CoroutineFramePool::deallocate(frame, 250);
+}
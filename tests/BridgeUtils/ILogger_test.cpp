@@ -0,0 +1,125 @@
+/*
+Live Transcribe Fine
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <ILogger.hpp>
+
+using namespace KaitoTokyo::BridgeUtils;
+
+namespace {
+
+class RecordingLogger : public ILogger {
+public:
+	mutable std::vector<std::string> messages;
+	mutable int suppressionsStarted = 0;
+
+protected:
+	void log(LogLevel, std::string_view message) const noexcept override { messages.emplace_back(message); }
+	const char *getPrefix() const noexcept override { return "> "; }
+	void onMessagesSuppressed() const noexcept override { ++suppressionsStarted; }
+};
+
+/**
+ * Counts how often it is formatted.
+ */
+struct Expensive {
+	int *formatCount;
+};
+
+} // namespace
+
+template<> struct fmt::formatter<Expensive> : fmt::formatter<int> {
+	auto format(const Expensive &value, fmt::format_context &ctx) const
+	{
+		return fmt::formatter<int>::format(++*value.formatCount, ctx);
+	}
+};
+
+TEST(ILoggerTest, SkipsFormattingBelowTheMinimumLevel)
+{
+	RecordingLogger logger;
+	int formatCount = 0;
+	const Expensive expensive{&formatCount};
+
+	logger.debug("debug {}", expensive);
+	logger.setMinimumLevel(ILogger::LogLevel::Warn);
+	logger.debug("debug {}", expensive);
+	logger.info("info {}", expensive);
+	logger.warn("warn {}", expensive);
+	logger.error("error {}", expensive);
+
+	EXPECT_EQ(formatCount, 3);
+	EXPECT_EQ(logger.messages, (std::vector<std::string>{"> debug 1", "> warn 2", "> error 3"}));
+	EXPECT_FALSE(logger.isEnabled(ILogger::LogLevel::Info));
+	EXPECT_TRUE(logger.isEnabled(ILogger::LogLevel::Error));
+}
+
+TEST(ILoggerTest, RateLimitsAndSummarizesSuppressedMessages)
+{
+	RecordingLogger logger;
+	LogRateLimiter limiter("src/Core/Example.cpp", 42, 2, std::chrono::milliseconds(50));
+
+	for (int i = 0; i < 5; ++i) {
+		logger.logRateLimited(limiter, ILogger::LogLevel::Error, "failure {}", i);
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(60));
+	logger.logRateLimited(limiter, ILogger::LogLevel::Error, "failure {}", 5);
+
+	EXPECT_EQ(logger.messages, (std::vector<std::string>{"> failure 0", "> failure 1",
+							     "> Suppressed 3 similar messages from Example.cpp:42",
+							     "> failure 5"}));
+
+	for (int i = 0; i < 100; ++i) {
+		BRIDGE_UTILS_LOG_RATE_LIMITED(logger, Warn, "flood {}", i);
+	}
+	EXPECT_EQ(logger.messages.size(), 9u);
+}
+
+TEST(ILoggerTest, ReportsSuppressedMessagesOnceTheIntervalHasEnded)
+{
+	RecordingLogger logger;
+	RecordingLogger otherLogger;
+	LogRateLimiter limiter("Example.cpp", 7, 1, std::chrono::milliseconds(50));
+
+	for (int i = 0; i < 4; ++i) {
+		logger.logRateLimited(limiter, ILogger::LogLevel::Warn, "failure {}", i);
+	}
+	EXPECT_EQ(logger.suppressionsStarted, 1);
+	EXPECT_TRUE(logger.reportSuppressed(LogRateLimiter::Clock::now()));
+	EXPECT_EQ(logger.messages, (std::vector<std::string>{"> failure 0"}));
+
+	const auto later = LogRateLimiter::Clock::now() + std::chrono::milliseconds(60);
+	otherLogger.reportSuppressed(later);
+	EXPECT_FALSE(logger.reportSuppressed(later));
+	logger.reportSuppressed(later);
+	EXPECT_TRUE(otherLogger.messages.empty());
+	EXPECT_EQ(logger.messages, (std::vector<std::string>{"> failure 0",
+							     "> Suppressed 3 similar messages from Example.cpp:7"}));
+
+	// Already reported, so the next message through does not repeat the summary
+	std::this_thread::sleep_for(std::chrono::milliseconds(60));
+	logger.logRateLimited(limiter, ILogger::LogLevel::Warn, "failure {}", 4);
+	EXPECT_EQ(logger.messages.back(), "> failure 4");
+	EXPECT_EQ(logger.messages.size(), 3u);
+}
@@ -0,0 +1,74 @@
+/*
+Live Transcribe Fine
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <LockFreeThrottledTaskQueue.hpp>
+#include <ThrottledTaskQueue.hpp>
+
+#include "../TestLoggers.hpp"
+
+using namespace KaitoTokyo::BridgeUtils;
+using KaitoTokyo::Tests::NullLogger;
+
+namespace {
+
+template<typename Queue> double nanosecondsPerPush(int producerCount, int tasksPerProducer)
+{
+	NullLogger logger;
+	std::atomic<int> ran{0};
+	Queue queue(logger, 1024);
+	std::atomic<bool> go{false};
+	std::vector<std::thread> producers;
+	for (int p = 0; p < producerCount; ++p) {
+		producers.emplace_back([&] {
+			while (!go.load()) {
+				std::this_thread::yield();
+			}
+			for (int i = 0; i < tasksPerProducer; ++i) {
+				queue.push([&ran](const auto &) { ran.fetch_add(1, std::memory_order_relaxed); });
+			}
+		});
+	}
+	const auto begin = std::chrono::steady_clock::now();
+	go.store(true);
+	for (auto &producer : producers) {
+		producer.join();
+	}
+	const auto elapsed = std::chrono::steady_clock::now() - begin;
+	return std::chrono::duration<double, std::nano>(elapsed).count() / (producerCount * tasksPerProducer);
+}
+
+} // namespace
+
+// Prints the cost of a push under producer contention for the locked and the lock-free queue
+int main()
+{
+	constexpr int tasksPerProducer = 50000;
+	for (int producerCount : {1, 2, 4, 8}) {
+		const double locked = nanosecondsPerPush<ThrottledTaskQueue>(producerCount, tasksPerProducer);
+		const double lockFree = nanosecondsPerPush<LockFreeThrottledTaskQueue>(producerCount, tasksPerProducer);
+		std::cout << producerCount << " producers: ThrottledTaskQueue " << locked
+			  << " ns/push, LockFreeThrottledTaskQueue " << lockFree << " ns/push" << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,125 @@
+/*
+Live Transcribe Fine
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <LockFreeThrottledTaskQueue.hpp>
+#include <ThrottledTaskQueue.hpp>
+
+#include "../TestLoggers.hpp"
+
+using namespace KaitoTokyo::BridgeUtils;
+using KaitoTokyo::Tests::NullLogger;
+
+namespace {
+
+void waitUntil(const std::atomic<int> &value, int expected)
+{
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+	while (value.load() != expected && std::chrono::steady_clock::now() < deadline) {
+		std::this_thread::yield();
+	}
+}
+
+} // namespace
+
+TEST(LockFreeThrottledTaskQueueTest, InplaceFunctionHoldsMoveOnlyCallables)
+{
+	auto counter = std::make_shared<int>(0);
+	InplaceFunction<int(int)> function = [owned = std::make_unique<int>(40), counter](int x) {
+		++*counter;
+		return *owned + x;
+	};
+	InplaceFunction<int(int)> moved = std::move(function);
+	EXPECT_FALSE(function);
+	EXPECT_EQ(moved(2), 42);
+	EXPECT_EQ(counter.use_count(), 2);
+	moved.reset();
+	EXPECT_EQ(counter.use_count(), 1);
+	EXPECT_EQ(*counter, 1);
+}
+
+TEST(LockFreeThrottledTaskQueueTest, CancelsOldestWaitingTaskWhenFull)
+{
+	NullLogger logger;
+	LockFreeThrottledTaskQueue queue(logger, 2);
+
+	std::promise<void> gate;
+	std::shared_future<void> opened = gate.get_future().share();
+	std::atomic<int> started{0};
+	std::atomic<int> finished{0};
+	std::vector<int> order;
+
+	queue.push([&started, opened](const auto &) {
+		++started;
+		opened.wait();
+	});
+	waitUntil(started, 1);
+
+	std::vector<LockFreeThrottledTaskQueue::CancellationToken> tokens;
+	for (int i = 0; i < 3; ++i) {
+		tokens.push_back(queue.push([i, &order, &finished](const auto &) {
+			order.push_back(i);
+			++finished;
+		}));
+	}
+	EXPECT_TRUE(tokens[0].isCancelled());
+	tokens[2].cancel();
+
+	gate.set_value();
+	waitUntil(finished, 2);
+	EXPECT_EQ(order, (std::vector<int>{1, 2}));
+	EXPECT_TRUE(tokens[2].isCancelled()); // Cancellation is cooperative
+	// The dropped task shares its cell with the one cancelled later, and still reports its own outcome
+	EXPECT_TRUE(tokens[0].isCancelled());
+	EXPECT_FALSE(tokens[1].isCancelled());
+}
+
+TEST(LockFreeThrottledTaskQueueTest, RunsEveryTaskFromConcurrentProducers)
+{
+	constexpr int producerCount = 4;
+	constexpr int tasksPerProducer = 10000;
+
+	NullLogger logger;
+	std::atomic<int> ran{0};
+	{
+		LockFreeThrottledTaskQueue queue(logger, producerCount * tasksPerProducer);
+		std::vector<std::thread> producers;
+		for (int p = 0; p < producerCount; ++p) {
+			producers.emplace_back([&queue, &ran] {
+				for (int i = 0; i < tasksPerProducer; ++i) {
+					queue.push([&ran](const auto &) {
+						ran.fetch_add(1, std::memory_order_relaxed);
+					});
+				}
+			});
+		}
+		for (auto &producer : producers) {
+			producer.join();
+		}
+		waitUntil(ran, producerCount * tasksPerProducer);
+	}
+	EXPECT_EQ(ran.load(), producerCount * tasksPerProducer);
+}
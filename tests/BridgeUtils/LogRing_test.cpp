@@ -0,0 +1,107 @@
+/*
+Live Transcribe Fine
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <LogRing.hpp>
+
+using namespace KaitoTokyo::BridgeUtils;
+
+TEST(LogRingTest, KeepsMessagesWholeAcrossSlotsAndWraps)
+{
+	LogRing ring(1024);
+	const std::string longMessage(500, 'x');
+	std::vector<std::string> received;
+	auto collect = [&received](std::uint8_t tag, std::string_view message) {
+		received.push_back(std::to_string(tag) + ":" + std::string(message));
+	};
+
+	for (int round = 0; round < 10; ++round) {
+		ASSERT_TRUE(ring.tryWrite(1, "short"));
+		ASSERT_TRUE(ring.tryWrite(2, longMessage));
+		ASSERT_TRUE(ring.tryWrite(3, ""));
+		EXPECT_EQ(ring.drain(collect), 3u);
+	}
+	ASSERT_EQ(received.size(), 30u);
+	EXPECT_EQ(received[27], "1:short");
+	EXPECT_EQ(received[28], "2:" + longMessage);
+	EXPECT_EQ(received[29], "3:");
+}
+
+TEST(LogRingTest, RejectsMessagesWhenFull)
+{
+	LogRing ring(1024);
+	EXPECT_FALSE(ring.tryWrite(0, std::string(2000, 'x')));
+
+	int written = 0;
+	while (ring.tryWrite(0, "message")) {
+		++written;
+	}
+	EXPECT_EQ(written, 8);
+	EXPECT_EQ(ring.drain([](std::uint8_t, std::string_view) {}), 8u);
+	EXPECT_TRUE(ring.tryWrite(0, "message"));
+}
+
+TEST(LogRingTest, ConcurrentWritersLoseNothingButDrops)
+{
+	constexpr int writerCount = 4;
+	constexpr int messagesPerWriter = 20000;
+	LogRing ring(16 * 1024);
+	std::atomic<int> droppedCount{0};
+	std::atomic<int> finishedWriters{0};
+
+	std::vector<std::thread> writers;
+	for (int writer = 0; writer < writerCount; ++writer) {
+		writers.emplace_back([&, writer] {
+			for (int i = 0; i < messagesPerWriter; ++i) {
+				const std::string message = std::to_string(i) + std::string(i % 300, '.');
+				if (!ring.tryWrite(static_cast<std::uint8_t>(writer), message)) {
+					++droppedCount;
+				}
+			}
+			++finishedWriters;
+		});
+	}
+
+	std::vector<int> last(writerCount, -1);
+	int received = 0;
+	bool ordered = true;
+	auto check = [&](std::uint8_t writer, std::string_view message) {
+		const int index = std::stoi(std::string(message));
+		const std::size_t expectedSize = std::to_string(index).size() + static_cast<std::size_t>(index % 300);
+		ordered = ordered && index > last[writer] && message.size() == expectedSize;
+		last[writer] = index;
+		++received;
+	};
+	while (finishedWriters.load() < writerCount) {
+		ring.drain(check);
+	}
+	ring.drain(check);
+	for (std::thread &writer : writers) {
+		writer.join();
+	}
+
+	EXPECT_TRUE(ordered);
+	EXPECT_EQ(received + droppedCount.load(), writerCount * messagesPerWriter);
+}
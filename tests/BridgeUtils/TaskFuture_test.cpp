@@ -0,0 +1,101 @@
+/*
+Live Transcribe Fine
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <TaskFuture.hpp>
+#include <ThrottledTaskQueue.hpp>
+#include <WorkStealingTaskPool.hpp>
+
+#include "../TestLoggers.hpp"
+
+using namespace KaitoTokyo::BridgeUtils;
+using KaitoTokyo::Tests::NullLogger;
+
+namespace {
+
+template<typename T> FutureStatus waitFor(const TaskFuture<T> &future)
+{
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+	while (future.status() == FutureStatus::Pending && std::chrono::steady_clock::now() < deadline) {
+		std::this_thread::yield();
+	}
+	return future.status();
+}
+
+} // namespace
+
+TEST(TaskFutureTest, ChainsContinuationsAcrossExecutors)
+{
+	NullLogger logger;
+	ThrottledTaskQueue queue(logger, 8);
+	WorkStealingTaskPool pool(logger, 8, 2);
+
+	TaskFuture<int> parsed = queue.submit([](const auto &) { return std::stoi("21"); });
+	TaskFuture<std::string> doubled = parsed.then(pool, [](int value) { return std::to_string(value * 2); });
+
+	EXPECT_EQ(waitFor(doubled), FutureStatus::Fulfilled);
+	EXPECT_EQ(doubled.get(), "42");
+	EXPECT_EQ(parsed.get(), 21);
+}
+
+TEST(TaskFutureTest, PropagatesFailureWithoutRunningContinuations)
+{
+	NullLogger logger;
+	ThrottledTaskQueue queue(logger, 8);
+
+	bool continued = false;
+	TaskFuture<int> parsed = queue.submit([](const auto &) { return std::stoi("not a number"); });
+	TaskFuture<void> next = parsed.then(queue, [&continued](int) { continued = true; });
+
+	EXPECT_EQ(waitFor(next), FutureStatus::Failed);
+	EXPECT_THROW(next.get(), std::invalid_argument);
+	EXPECT_FALSE(continued);
+}
+
+TEST(TaskFutureTest, DiscardedOrCancelledTasksCompleteAsCancelled)
+{
+	NullLogger logger;
+	ThrottledTaskQueue queue(logger, 1);
+
+	std::promise<void> gate;
+	std::promise<void> started;
+	queue.push([&started, opened = gate.get_future().share()](const auto &) {
+		started.set_value();
+		opened.wait();
+	});
+	started.get_future().wait();
+
+	TaskFuture<int> dropped = queue.submit([](const auto &) { return 1; });
+	TaskFuture<int> chained = dropped.then(queue, [](int value) { return value + 1; });
+	TaskFuture<void> refused = queue.submit([](const auto &) { throw OperationCancelled(); });
+
+	// The lane holds one task, so the first submit was dropped by the second one
+	EXPECT_EQ(dropped.status(), FutureStatus::Cancelled);
+	EXPECT_EQ(chained.status(), FutureStatus::Cancelled);
+	EXPECT_THROW(chained.get(), OperationCancelled);
+
+	gate.set_value();
+	EXPECT_EQ(waitFor(refused), FutureStatus::Cancelled);
+}
@@ -0,0 +1,75 @@
+/*
+Live Transcribe Fine
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <future>
+#include <iostream>
+#include <vector>
+
+#include <ThrottledTaskQueue.hpp>
+
+#include "../TestLoggers.hpp"
+
+using namespace KaitoTokyo::BridgeUtils;
+using KaitoTokyo::Tests::NullLogger;
+
+namespace {
+
+/**
+ * Pushes taskCount tasks in batches of batchSize to a worker draining batchSize per wakeup.
+ */
+double nanosecondsPerTask(std::size_t batchSize, std::size_t taskCount)
+{
+	NullLogger logger;
+	const ThrottledTaskQueue::LaneConfig lane{taskCount};
+	ThrottledTaskQueue queue(logger, {lane, lane, lane}, ThrottledTaskQueue::Scheduling::Strict, batchSize);
+	std::atomic<std::size_t> remaining{taskCount};
+	std::promise<void> done;
+	auto task = [&remaining, &done](const auto &) {
+		if (remaining.fetch_sub(1) == 1) {
+			done.set_value();
+		}
+	};
+
+	const auto begin = std::chrono::steady_clock::now();
+	for (std::size_t pushed = 0; pushed < taskCount; pushed += batchSize) {
+		if (batchSize == 1) {
+			queue.push(task);
+		} else {
+			queue.pushBatch(std::vector<ThrottledTaskQueue::CancellableTask>(batchSize, task));
+		}
+	}
+	done.get_future().wait();
+	const auto elapsed = std::chrono::steady_clock::now() - begin;
+	return std::chrono::duration<double, std::nano>(elapsed).count() / static_cast<double>(taskCount);
+}
+
+} // namespace
+
+// Prints the cost per task of pushing and draining in batches of different sizes
+int main()
+{
+	constexpr std::size_t taskCount = 65536;
+	for (std::size_t batchSize : {1, 8, 64, 256}) {
+		const double nanoseconds = nanosecondsPerTask(batchSize, taskCount);
+		std::cout << "batch size " << batchSize << ": " << nanoseconds << " ns/task" << std::endl;
+	}
+	return 0;
+}
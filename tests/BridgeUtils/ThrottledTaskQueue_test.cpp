@@ -0,0 +1,267 @@
+/*
+Live Transcribe Fine
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <ThrottledTaskQueue.hpp>
+
+#include "../TestLoggers.hpp"
+
+using namespace KaitoTokyo::BridgeUtils;
+using KaitoTokyo::Tests::NullLogger;
+
+namespace {
+
+using Priority = ThrottledTaskQueue::Priority;
+
+ThrottledTaskQueue::PushOptions options(Priority priority, std::string coalesceKey = {})
+{
+	ThrottledTaskQueue::PushOptions result;
+	result.priority = priority;
+	result.coalesceKey = std::move(coalesceKey);
+	return result;
+}
+
+/**
+ * Holds the worker on a first task so that the test can fill the lanes deterministically.
+ */
+class BlockedWorker {
+public:
+	explicit BlockedWorker(ThrottledTaskQueue &queue)
+	{
+		std::promise<void> started;
+		queue.push([&started, opened = opened](const auto &) {
+			started.set_value();
+			opened.wait();
+		});
+		started.get_future().wait();
+	}
+
+	void release() { gate.set_value(); }
+
+private:
+	std::promise<void> gate;
+	std::shared_future<void> opened = gate.get_future().share();
+};
+
+std::string drain(ThrottledTaskQueue &queue, BlockedWorker &blocked, std::string &order)
+{
+	std::promise<void> done;
+	queue.push([&done](const auto &) { done.set_value(); }, options(Priority::Background));
+	blocked.release();
+	done.get_future().wait();
+	return order;
+}
+
+} // namespace
+
+TEST(ThrottledTaskQueueTest, RunsInteractiveTasksFirst)
+{
+	NullLogger logger;
+	ThrottledTaskQueue queue(logger, 10);
+	BlockedWorker blocked(queue);
+
+	std::string order;
+	queue.push([&order](const auto &) { order += 'b'; }, options(Priority::Background));
+	queue.push([&order](const auto &) { order += 'n'; });
+	queue.push([&order](const auto &) { order += 'i'; }, options(Priority::Interactive));
+	queue.push([&order](const auto &) { order += 'I'; }, options(Priority::Interactive));
+
+	EXPECT_EQ(drain(queue, blocked, order), "iInb");
+}
+
+TEST(ThrottledTaskQueueTest, DropsOldestWithinTheLaneOnly)
+{
+	NullLogger logger;
+	ThrottledTaskQueue queue(logger, {ThrottledTaskQueue::LaneConfig{1}, {8}, {2}});
+	BlockedWorker blocked(queue);
+
+	std::string order;
+	const auto interactive = queue.push([&order](const auto &) { order += 'i'; }, options(Priority::Interactive));
+	ThrottledTaskQueue::CancellationToken firstBackground;
+	for (char c : std::string("abc")) {
+		auto token = queue.push([&order, c](const auto &) { order += c; }, options(Priority::Background));
+		if (!firstBackground) {
+			firstBackground = token;
+		}
+	}
+	EXPECT_FALSE(interactive.isCancelled());
+	EXPECT_TRUE(firstBackground.isCancelled());
+
+	// The drain task takes one more background slot, evicting 'b'
+	EXPECT_EQ(drain(queue, blocked, order), "ic");
+}
+
+TEST(ThrottledTaskQueueTest, CoalescesTasksWithTheSameKey)
+{
+	NullLogger logger;
+	ThrottledTaskQueue queue(logger, 2);
+	BlockedWorker blocked(queue);
+
+	std::string order;
+	const auto normal = options(Priority::Normal, "partial:mic");
+	const auto interactive = options(Priority::Interactive, "partial:mic");
+	const auto first = queue.push([&order](const auto &) { order += '1'; }, normal);
+	queue.push([&order](const auto &) { order += 'x'; });
+	const auto second = queue.push([&order](const auto &) { order += '2'; }, normal);
+	const auto third = queue.push([&order](const auto &) { order += '3'; }, interactive);
+
+	// Coalescing does not evict the unrelated task, and a replacement keeps its place in line
+	EXPECT_TRUE(first.isCancelled());
+	EXPECT_TRUE(second.isCancelled());
+	EXPECT_FALSE(third.isCancelled());
+	EXPECT_EQ(drain(queue, blocked, order), "3x");
+}
+
+TEST(ThrottledTaskQueueTest, RecordsDepthDropsAndWaitTimes)
+{
+	NullLogger logger;
+	std::string order;
+	{
+		ThrottledTaskQueue queue(logger, 2);
+		BlockedWorker blocked(queue);
+
+		queue.push([](const auto &) {}, options(Priority::Normal, "a"));
+		queue.push([](const auto &) {}, options(Priority::Normal, "a"));
+		queue.push([](const auto &) {});
+		queue.push([](const auto &) {}); // Drops the coalesced "a"
+		queue.push([](const auto &) { throw std::runtime_error("failure"); }, options(Priority::Background));
+
+		QueueStatsSnapshot stats = queue.stats();
+		EXPECT_EQ(stats.pushed, 6u);
+		EXPECT_EQ(stats.started, 1u);
+		EXPECT_EQ(stats.coalesced, 1u);
+		EXPECT_EQ(stats.dropped, 1u);
+		EXPECT_EQ(stats.depth, 3u);
+		EXPECT_EQ(stats.highWaterMark, 3u);
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		drain(queue, blocked, order);
+		stats = queue.stats();
+		EXPECT_EQ(stats.started, 5u);
+		EXPECT_EQ(stats.failed, 1u);
+		EXPECT_EQ(stats.depth, 0u);
+		EXPECT_EQ(stats.waitMicroseconds.total(), 5u);
+		EXPECT_GE(stats.waitMicroseconds.percentile(0.99), 1000u);
+		EXPECT_GE(stats.runMicroseconds.total(), 4u); // The drain task may still be running
+	}
+
+	Log2Histogram histogram;
+	for (std::uint64_t value : {0, 1, 5, 6, 7, 100}) {
+		histogram.record(value);
+	}
+	const Log2HistogramSnapshot snapshot = histogram.snapshot();
+	EXPECT_EQ(snapshot.percentile(0.0), 0u);
+	EXPECT_EQ(snapshot.percentile(0.5), 7u);
+	EXPECT_EQ(snapshot.percentile(1.0), 127u);
+}
+
+TEST(ThrottledTaskQueueTest, SkipsTasksPastTheirDeadline)
+{
+	NullLogger logger;
+	ThrottledTaskQueue queue(logger, 10);
+	BlockedWorker blocked(queue);
+
+	std::string order;
+	ThrottledTaskQueue::PushOptions stale = options(Priority::Interactive);
+	stale.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(1);
+	ThrottledTaskQueue::PushOptions fresh = options(Priority::Interactive);
+	fresh.deadline = std::chrono::steady_clock::now() + std::chrono::hours(1);
+
+	const auto expired = queue.push([&order](const auto &) { order += 's'; }, stale);
+	queue.push([&order](const auto &) { order += 'f'; }, fresh);
+	std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+	EXPECT_EQ(drain(queue, blocked, order), "f");
+	EXPECT_TRUE(expired.isCancelled());
+	EXPECT_EQ(queue.stats().expired, 1u);
+}
+
+TEST(ThrottledTaskQueueTest, WeightedSchedulingSharesTurns)
+{
+	NullLogger logger;
+	ThrottledTaskQueue queue(logger, {ThrottledTaskQueue::LaneConfig{16, 3}, {16, 1}, {16, 1}},
+				 ThrottledTaskQueue::Scheduling::Weighted);
+	BlockedWorker blocked(queue);
+
+	std::string order;
+	std::promise<void> done;
+	int remaining = 12;
+	for (int i = 0; i < 6; ++i) {
+		for (Priority priority : {Priority::Interactive, Priority::Normal}) {
+			queue.push(
+				[&, priority](const auto &) {
+					order += priority == Priority::Interactive ? 'i' : 'n';
+					if (--remaining == 0) {
+						done.set_value();
+					}
+				},
+				options(priority));
+		}
+	}
+	blocked.release();
+	done.get_future().wait();
+
+	// Interactive gets three turns for every normal one, and normal still progresses
+	EXPECT_EQ(order.substr(0, 8), "iiniiini");
+}
+
+TEST(ThrottledTaskQueueTest, PushesAndDrainsInBatches)
+{
+	NullLogger logger;
+	const ThrottledTaskQueue::LaneConfig lane{16};
+	ThrottledTaskQueue queue(logger, {lane, lane, lane}, ThrottledTaskQueue::Scheduling::Strict, 4);
+	BlockedWorker blocked(queue);
+
+	std::string order;
+	std::vector<ThrottledTaskQueue::CancellableTask> tasks;
+	for (char c = '0'; c <= '9'; ++c) {
+		tasks.push_back([&order, c](const auto &) { order += c; });
+	}
+	const auto tokens = queue.pushBatch(std::move(tasks));
+	queue.push([&order](const auto &) { order += 'i'; }, options(Priority::Interactive));
+
+	ASSERT_EQ(tokens.size(), 10u);
+	EXPECT_EQ(drain(queue, blocked, order), "i0123456789");
+	EXPECT_EQ(queue.stats().pushed, 13u);
+}
+
+TEST(ThrottledTaskQueueTest, SkipsAndCountsTasksCancelledWhileWaiting)
+{
+	NullLogger logger;
+	ThrottledTaskQueue queue(logger, 10);
+	BlockedWorker blocked(queue);
+
+	std::string order;
+	const auto cancelled = queue.push([&order](const auto &) { order += 'c'; }, options(Priority::Interactive));
+	queue.push([&order](const auto &) { order += 'k'; }, options(Priority::Interactive));
+	EXPECT_TRUE(cancelled.cancel());
+
+	EXPECT_EQ(drain(queue, blocked, order), "k");
+	const QueueStatsSnapshot stats = queue.stats();
+	EXPECT_EQ(stats.cancelled, 1u);
+	EXPECT_EQ(stats.expired, 0u);
+}
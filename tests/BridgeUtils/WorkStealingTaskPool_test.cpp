@@ -0,0 +1,166 @@
+/*
+Live Transcribe Fine
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <WorkStealingTaskPool.hpp>
+
+#include "../TestLoggers.hpp"
+
+using namespace KaitoTokyo::BridgeUtils;
+using KaitoTokyo::Tests::NullLogger;
+
+namespace {
+
+void waitUntil(const std::atomic<int> &value, int expected)
+{
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+	while (value.load() != expected && std::chrono::steady_clock::now() < deadline) {
+		std::this_thread::yield();
+	}
+}
+
+} // namespace
+
+TEST(WorkStealingTaskPoolTest, RunsTasksFromConcurrentProducers)
+{
+	constexpr int producerCount = 4;
+	constexpr int tasksPerProducer = 5000;
+
+	NullLogger logger;
+	std::atomic<int> ran{0};
+	WorkStealingTaskPool pool(logger, producerCount * tasksPerProducer, 3);
+	EXPECT_EQ(pool.workerCount(), 3u);
+
+	std::vector<std::thread> producers;
+	for (int p = 0; p < producerCount; ++p) {
+		producers.emplace_back([&pool, &ran] {
+			for (int i = 0; i < tasksPerProducer; ++i) {
+				pool.push([&ran](const auto &) { ran.fetch_add(1, std::memory_order_relaxed); });
+			}
+		});
+	}
+	for (auto &producer : producers) {
+		producer.join();
+	}
+	waitUntil(ran, producerCount * tasksPerProducer);
+	EXPECT_EQ(ran.load(), producerCount * tasksPerProducer);
+}
+
+TEST(WorkStealingTaskPoolTest, AffinityKeepsTasksOnOneWorkerInOrder)
+{
+	NullLogger logger;
+	WorkStealingTaskPool pool(logger, 1000, 4);
+
+	std::mutex mtx;
+	std::set<std::thread::id> threads;
+	std::vector<int> order;
+	std::atomic<int> ran{0};
+	for (int i = 0; i < 200; ++i) {
+		pool.pushWithAffinity(7, [i, &mtx, &threads, &order, &ran](const auto &) {
+			std::lock_guard<std::mutex> lock(mtx);
+			threads.insert(std::this_thread::get_id());
+			order.push_back(i);
+			++ran;
+		});
+	}
+	waitUntil(ran, 200);
+
+	std::lock_guard<std::mutex> lock(mtx);
+	EXPECT_EQ(threads.size(), 1u);
+	ASSERT_EQ(order.size(), 200u);
+	for (int i = 0; i < 200; ++i) {
+		EXPECT_EQ(order[i], i);
+	}
+}
+
+TEST(WorkStealingTaskPoolTest, IdleWorkersStealFromABlockedWorker)
+{
+	NullLogger logger;
+	WorkStealingTaskPool pool(logger, 100, 2);
+
+	std::promise<void> gate;
+	std::shared_future<void> opened = gate.get_future().share();
+	std::atomic<int> ran{0};
+
+	// Subtasks pushed from a task go to the same worker, which then blocks until they are done elsewhere
+	pool.push([&pool, &ran, opened](const auto &) {
+		for (int i = 0; i < 10; ++i) {
+			pool.push([&ran](const auto &) { ++ran; });
+		}
+		opened.wait();
+	});
+	waitUntil(ran, 10);
+	EXPECT_EQ(ran.load(), 10);
+	gate.set_value();
+}
+
+TEST(WorkStealingTaskPoolTest, CancelsOldestTaskOfAFullWorker)
+{
+	NullLogger logger;
+	WorkStealingTaskPool pool(logger, 2, 1);
+
+	std::promise<void> gate;
+	std::shared_future<void> opened = gate.get_future().share();
+	std::atomic<int> started{0};
+	pool.push([&started, opened](const auto &) {
+		++started;
+		opened.wait();
+	});
+	waitUntil(started, 1);
+
+	const auto first = pool.pushWithAffinity(1, [](const auto &) {});
+	const auto second = pool.push([](const auto &) {});
+	const auto third = pool.push([](const auto &) {});
+	EXPECT_TRUE(first.isCancelled());
+	EXPECT_FALSE(second.isCancelled());
+	EXPECT_FALSE(third.isCancelled());
+	gate.set_value();
+}
+
+TEST(WorkStealingTaskPoolTest, SkipsAndCountsTasksCancelledWhileWaiting)
+{
+	NullLogger logger;
+	WorkStealingTaskPool pool(logger, 4, 1);
+
+	std::promise<void> gate;
+	std::shared_future<void> opened = gate.get_future().share();
+	std::atomic<int> started{0};
+	pool.push([&started, opened](const auto &) {
+		++started;
+		opened.wait();
+	});
+	waitUntil(started, 1);
+
+	std::atomic<int> ran{0};
+	auto cancelled = pool.push([&ran](const auto &) { ran += 10; });
+	pool.pushWithAffinity(1, [&ran](const auto &) { ++ran; });
+	cancelled.cancel();
+	gate.set_value();
+	waitUntil(ran, 1);
+	EXPECT_EQ(ran.load(), 1);
+	EXPECT_EQ(pool.cancelledCount(), 1u);
+}
@@ -0,0 +1,75 @@
+/*
+Live Transcribe Fine
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <optional>
+#include <string>
+
+#include <ModelDirectory.hpp>
+
+using namespace KaitoTokyo::LiveTranscribeFine;
+namespace fs = std::filesystem;
+
+namespace {
+
+/**
+ * A scratch directory holding a models directory with one model, and a model outside of it.
+ */
+class ModelDirectoryTest : public ::testing::Test {
+protected:
+	void SetUp() override
+	{
+		const std::string testName = ::testing::UnitTest::GetInstance()->current_test_info()->name();
+		base = fs::temp_directory_path() / ("model-directory-" + testName);
+		models = base / "models";
+		fs::remove_all(base);
+		fs::create_directories(models / "vosk-model-ja");
+		fs::create_directories(base / "elsewhere");
+		fs::create_directories(base / "models-other");
+	}
+
+	void TearDown() override { fs::remove_all(base); }
+
+	fs::path base;
+	fs::path models;
+};
+
+} // namespace
+
+TEST_F(ModelDirectoryTest, ResolvesModelsInsideTheDirectory)
+{
+	const fs::path model = fs::canonical(models / "vosk-model-ja");
+	EXPECT_EQ(resolveModelInDirectory(models, "vosk-model-ja"), model);
+	EXPECT_EQ(resolveModelInDirectory(models, model.string()), model);
+	EXPECT_EQ(resolveModelInDirectory(models, "./vosk-model-ja/"), model);
+}
+
+TEST_F(ModelDirectoryTest, RejectsPathsLeadingOutside)
+{
+	EXPECT_EQ(resolveModelInDirectory(models, "../elsewhere"), std::nullopt);
+	EXPECT_EQ(resolveModelInDirectory(models, (base / "elsewhere").string()), std::nullopt);
+	EXPECT_EQ(resolveModelInDirectory(models, (base / "models-other").string()), std::nullopt);
+	EXPECT_EQ(resolveModelInDirectory(models, "."), std::nullopt);
+	EXPECT_EQ(resolveModelInDirectory(models, "missing"), std::nullopt);
+	EXPECT_EQ(resolveModelInDirectory({}, (models / "vosk-model-ja").string()), std::nullopt);
+
+	fs::create_directory_symlink(base / "elsewhere", models / "link");
+	EXPECT_EQ(resolveModelInDirectory(models, "link"), std::nullopt);
+}
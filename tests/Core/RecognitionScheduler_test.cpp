@@ -0,0 +1,276 @@
+/*
+Live Transcribe Fine
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <RecognitionScheduler.hpp>
+
+#include "../TestLoggers.hpp"
+
+using namespace KaitoTokyo::BridgeUtils;
+using namespace KaitoTokyo::LiveTranscribeFine;
+using KaitoTokyo::Tests::NullLogger;
+
+namespace {
+
+template<typename Predicate> void waitUntil(Predicate predicate)
+{
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+	while (!predicate() && std::chrono::steady_clock::now() < deadline) {
+		std::this_thread::yield();
+	}
+}
+
+} // namespace
+
+TEST(RecognitionSchedulerTest, ServicesBusyStreamsInQuantumSizedTurns)
+{
+	NullLogger logger;
+	RecognitionScheduler scheduler(logger, 1, 0.0, std::chrono::milliseconds(100));
+
+	std::promise<void> gate;
+	std::shared_future<void> opened = gate.get_future().share();
+	std::atomic<std::size_t> consumed{0};
+	std::mutex mtx;
+	std::vector<std::string> turns;
+
+	// The first stream blocks the only worker until both streams have a backlog
+	auto blocker = scheduler.addStream("blocker", 1000.0, [opened](const std::int16_t *, std::size_t) {
+		opened.wait();
+	});
+	const std::vector<std::int16_t> audio(1000);
+	blocker->write(audio.data(), 1);
+
+	std::vector<std::shared_ptr<RecognitionScheduler::Stream>> streams;
+	for (const char *name : {"a", "b"}) {
+		auto stream = scheduler.addStream(name, 1000.0, [&, name](const std::int16_t *, std::size_t count) {
+			EXPECT_LE(count, 100u);
+			std::lock_guard<std::mutex> lock(mtx);
+			if (turns.empty() || turns.back() != name) {
+				turns.push_back(name);
+			}
+			consumed += count;
+		});
+		stream->write(audio.data(), audio.size());
+		EXPECT_DOUBLE_EQ(stream->lagSeconds(), 1.0);
+		streams.push_back(stream);
+	}
+	gate.set_value();
+	waitUntil([&] { return consumed.load() == 2000; });
+
+	EXPECT_EQ(consumed.load(), 2000u);
+	EXPECT_DOUBLE_EQ(streams[0]->lagSeconds(), 0.0);
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		EXPECT_EQ(turns.size(), 20u); // 100 samples per turn, alternating
+	}
+	for (const auto &stream : streams) {
+		scheduler.removeStream(stream);
+	}
+	scheduler.removeStream(blocker);
+}
+
+TEST(RecognitionSchedulerTest, ServiceRequestCallsConsumerWithoutAudio)
+{
+	NullLogger logger;
+	RecognitionScheduler scheduler(logger, 2);
+	std::atomic<int> emptyCalls{0};
+	auto stream = scheduler.addStream("s", 16000.0, [&](const std::int16_t *, std::size_t count) {
+		if (count == 0) {
+			++emptyCalls;
+		}
+	});
+	stream->requestService();
+	waitUntil([&] { return emptyCalls.load() == 1; });
+	EXPECT_EQ(emptyCalls.load(), 1);
+	scheduler.removeStream(stream);
+}
+
+TEST(RecognitionSchedulerTest, DropsAudioBeyondTheRingAndStopsAfterRemoval)
+{
+	NullLogger logger;
+	RecognitionScheduler scheduler(logger, 1);
+
+	std::promise<void> gate;
+	std::shared_future<void> opened = gate.get_future().share();
+	std::atomic<int> calls{0};
+	auto stream = scheduler.addStream("s", 100.0, [&calls, opened](const std::int16_t *, std::size_t) {
+		++calls;
+		opened.wait();
+	});
+
+	// The ring holds ten seconds of audio
+	const std::vector<std::int16_t> audio(1200);
+	EXPECT_FALSE(stream->write(audio.data(), audio.size()));
+	EXPECT_EQ(stream->droppedSamples(), 200u);
+
+	waitUntil([&] { return calls.load() == 1; });
+	std::thread remover([&] { scheduler.removeStream(stream); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	gate.set_value();
+	remover.join();
+	const int callsAtRemoval = calls.load();
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	EXPECT_EQ(calls.load(), callsAtRemoval);
+	EXPECT_EQ(callsAtRemoval, 1);
+}
+
+TEST(RecognitionSchedulerTest, RemovedStreamWithPendingAudioLeavesTheRunQueue)
+{
+	NullLogger logger;
+	RecognitionScheduler scheduler(logger, 1);
+
+	std::promise<void> gate;
+	std::shared_future<void> opened = gate.get_future().share();
+	std::atomic<int> blockerCalls{0};
+	auto blocker = scheduler.addStream("blocker", 100.0,
+					   [&blockerCalls, opened](const std::int16_t *, std::size_t) {
+						   ++blockerCalls;
+						   opened.wait();
+					   });
+	std::atomic<int> removedCalls{0};
+	auto removed = scheduler.addStream("removed", 100.0,
+					   [&removedCalls](const std::int16_t *, std::size_t) { ++removedCalls; });
+
+	const std::vector<std::int16_t> audio(100);
+	blocker->write(audio.data(), 1);
+	waitUntil([&] { return blockerCalls.load() == 1; });
+
+	// Queued behind the busy stream on the only worker
+	removed->write(audio.data(), audio.size());
+	scheduler.removeStream(removed);
+	EXPECT_DOUBLE_EQ(removed->lagSeconds(), 0.0);
+	gate.set_value();
+
+	// The scheduler lets go of the stream instead of requeueing it forever
+	waitUntil([&] { return removed.use_count() == 1; });
+	EXPECT_EQ(removed.use_count(), 1);
+	removed->write(audio.data(), audio.size());
+	EXPECT_EQ(removed.use_count(), 1);
+
+	blocker->write(audio.data(), 1);
+	waitUntil([&] { return blockerCalls.load() == 2; });
+	EXPECT_EQ(blockerCalls.load(), 2);
+	EXPECT_EQ(removedCalls.load(), 0);
+	scheduler.removeStream(blocker);
+}
+
+TEST(RecognitionSchedulerTest, GovernorTightensOneStepPerWindowOverBudget)
+{
+	using namespace std::chrono_literals;
+
+	NullLogger logger;
+	CpuBudgetGovernor governor(logger, 0.5, 1s);
+	auto now = CpuBudgetGovernor::Clock::now();
+
+	const CpuBudgetState tightened[] = {CpuBudgetState::PartialsSuspended, CpuBudgetState::SnapshotsSuspended,
+					    CpuBudgetState::SheddingAudio, CpuBudgetState::SheddingAudio};
+	for (CpuBudgetState expected : tightened) {
+		governor.addCpuTime(900ms);
+		now += 1s;
+		governor.evaluate(now);
+		EXPECT_EQ(governor.state(), expected);
+	}
+	EXPECT_NEAR(governor.snapshot().usageCores, 0.9, 0.01);
+
+	governor.addCpuTime(600ms);
+	EXPECT_TRUE(governor.exhausted());
+
+	now += 1s;
+	governor.evaluate(now);
+	EXPECT_EQ(governor.state(), CpuBudgetState::SheddingAudio);
+	EXPECT_FALSE(governor.exhausted());
+
+	governor.addCpuTime(300ms);
+	now += 1s;
+	governor.evaluate(now);
+	EXPECT_EQ(governor.state(), CpuBudgetState::SnapshotsSuspended);
+
+	// Within the budget but not well below it, the state holds
+	governor.addCpuTime(450ms);
+	now += 1s;
+	governor.evaluate(now);
+	EXPECT_EQ(governor.state(), CpuBudgetState::SnapshotsSuspended);
+}
+
+TEST(RecognitionSchedulerTest, IdleWorkersLetTheCpuBudgetRelax)
+{
+	NullLogger logger;
+	RecognitionScheduler scheduler(logger, 1, 0.01);
+	auto stream = scheduler.addStream("busy", 16000.0, [](const std::int16_t *, std::size_t) {
+		const auto start = currentThreadCpuTime();
+		while (currentThreadCpuTime() - start < std::chrono::milliseconds(50)) {
+		}
+	});
+	waitUntil([&] {
+		stream->requestService();
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		return scheduler.cpuBudgetState() != CpuBudgetState::WithinBudget;
+	});
+	ASSERT_NE(scheduler.cpuBudgetState(), CpuBudgetState::WithinBudget);
+
+	// No more audio comes, yet the windows keep closing
+	waitUntil([&] { return scheduler.cpuBudgetState() == CpuBudgetState::WithinBudget; });
+	EXPECT_EQ(scheduler.cpuBudgetState(), CpuBudgetState::WithinBudget);
+	scheduler.removeStream(stream);
+}
+
+TEST(RecognitionSchedulerTest, GovernorChargesLateEvaluationsToTheLastWindow)
+{
+	using namespace std::chrono_literals;
+
+	NullLogger logger;
+	CpuBudgetGovernor governor(logger, 0.5, 1s);
+	auto now = CpuBudgetGovernor::Clock::now();
+	for (int i = 0; i < 3; ++i) {
+		governor.addCpuTime(900ms);
+		now += 1s;
+		governor.evaluate(now);
+	}
+	ASSERT_EQ(governor.state(), CpuBudgetState::SheddingAudio);
+
+	// Two idle windows relax two steps, and the quiet last one a third
+	governor.addCpuTime(100ms);
+	now += 3s;
+	governor.evaluate(now);
+	EXPECT_EQ(governor.state(), CpuBudgetState::WithinBudget);
+	EXPECT_NEAR(governor.snapshot().usageCores, 0.1, 0.01);
+
+	// A burst after a long gap is not averaged away over the gap
+	governor.addCpuTime(900ms);
+	now += 10s;
+	governor.evaluate(now);
+	EXPECT_EQ(governor.state(), CpuBudgetState::PartialsSuspended);
+	EXPECT_NEAR(governor.snapshot().usageCores, 0.9, 0.01);
+
+	// Less than two windows late, the usage is measured over the whole time
+	governor.addCpuTime(900ms);
+	now += 1500ms;
+	governor.evaluate(now);
+	EXPECT_EQ(governor.state(), CpuBudgetState::SnapshotsSuspended);
+	EXPECT_NEAR(governor.snapshot().usageCores, 0.6, 0.01);
+}
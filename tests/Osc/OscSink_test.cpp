@@ -0,0 +1,103 @@
+/*
+Live Transcribe Fine
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <OscSink.hpp>
+
+#include "../TestLoggers.hpp"
+
+using namespace KaitoTokyo::Osc;
+using KaitoTokyo::Tests::NullLogger;
+
+TEST(OscSinkTest, EncodesPaddedStringMessages)
+{
+	const OscPacket packet = OscPacket::withString("/transcript/final", "hello");
+	const std::string expected("/transcript/final\0\0\0,s\0\0hello\0\0\0", 32);
+	EXPECT_EQ(packet.view(), expected);
+}
+
+TEST(OscSinkTest, TruncatesAtCharacterBoundary)
+{
+	std::string text;
+	for (int i = 0; i < 1000; ++i) {
+		text += "\xe3\x81\x82"; // U+3042
+	}
+	const OscPacket packet = OscPacket::withString("/transcript/final", text);
+	EXPECT_LE(packet.size, OscPacket::capacity);
+	EXPECT_EQ(packet.size % 4, 0u);
+	const std::string_view argument(packet.data.data() + 24);
+	EXPECT_EQ(argument.size() % 3, 0u);
+}
+
+TEST(OscSinkTest, KeywordsFireOncePerUtterance)
+{
+	KeywordSpotter spotter("Cue, blackout");
+	std::vector<std::string> fired;
+	const auto collect = [&fired](std::string_view keyword) { fired.emplace_back(keyword); };
+
+	spotter.scan("go to cue", false, collect);
+	spotter.scan("go to cue three", false, collect);
+	spotter.scan("cuesheet", false, collect);
+	spotter.scan("go to CUE three then blackout", true, collect);
+	spotter.scan("cue", true, collect);
+
+	EXPECT_EQ(fired, (std::vector<std::string>{"cue", "blackout", "cue"}));
+}
+
+TEST(OscSinkTest, SendsFinalsAndTriggersOverUdp)
+{
+	const int receiver = ::socket(AF_INET, SOCK_DGRAM, 0);
+	ASSERT_GE(receiver, 0);
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	ASSERT_EQ(::bind(receiver, reinterpret_cast<sockaddr *>(&address), sizeof(address)), 0);
+	socklen_t length = sizeof(address);
+	ASSERT_EQ(::getsockname(receiver, reinterpret_cast<sockaddr *>(&address), &length), 0);
+
+	NullLogger logger;
+	OscSink sink(logger, "127.0.0.1:" + std::to_string(ntohs(address.sin_port)), "cue");
+	ASSERT_TRUE(sink.start());
+	sink.publishPartial("next cue");
+	sink.publishFinal("next cue please");
+
+	std::vector<std::string> received;
+	while (received.size() < 2) {
+		pollfd fd{receiver, POLLIN, 0};
+		ASSERT_EQ(::poll(&fd, 1, 5000), 1);
+		char buffer[OscPacket::capacity];
+		const ssize_t size = ::recv(receiver, buffer, sizeof(buffer), 0);
+		ASSERT_GT(size, 0);
+		received.emplace_back(buffer, static_cast<std::size_t>(size));
+	}
+	sink.stop();
+	::close(receiver);
+
+	EXPECT_EQ(received[0], OscPacket::withString(OscSink::keywordAddress, "cue").view());
+	EXPECT_EQ(received[1], OscPacket::withString(OscSink::finalAddress, "next cue please").view());
+	EXPECT_EQ(sink.sent(), 2u);
+}
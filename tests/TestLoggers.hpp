@@ -0,0 +1,76 @@
+/*
+Live Transcribe Fine
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <ILogger.hpp>
+
+namespace KaitoTokyo {
+namespace Tests {
+
+/**
+ * @brief A logger that discards everything, for tests that do not look at the logs.
+ */
+class NullLogger : public BridgeUtils::ILogger {
+protected:
+	void log(LogLevel, std::string_view) const noexcept override {}
+	const char *getPrefix() const noexcept override { return ""; }
+};
+
+/**
+ * @brief A logger that keeps every message, for tests that wait for or check what a component logged.
+ * Safe to use from several threads.
+ */
+class CapturingLogger : public BridgeUtils::ILogger {
+public:
+	/**
+	 * @brief Tells whether a single message contains all of the fragments.
+	 */
+	bool logged(std::initializer_list<std::string_view> fragments) const
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		return std::any_of(messages.begin(), messages.end(), [fragments](const std::string &message) {
+			return std::all_of(fragments.begin(), fragments.end(), [&message](std::string_view fragment) {
+				return message.find(fragment) != std::string::npos;
+			});
+		});
+	}
+
+protected:
+	void log(LogLevel, std::string_view message) const noexcept override
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		messages.emplace_back(message);
+	}
+
+	const char *getPrefix() const noexcept override { return ""; }
+
+private:
+	mutable std::mutex mtx;
+	mutable std::vector<std::string> messages;
+};
+
+} // namespace Tests
+} // namespace KaitoTokyo
@@ -0,0 +1,152 @@
+/*
+Live Transcribe Fine
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+#include <TranscriptRing.h>
+#include <TranscriptRingWriter.hpp>
+
+using namespace KaitoTokyo::TranscriptRing;
+
+namespace {
+
+struct ReaderDeleter {
+	void operator()(transcript_ring_reader *reader) const noexcept { transcript_ring_close(reader); }
+};
+using unique_reader_t = std::unique_ptr<transcript_ring_reader, ReaderDeleter>;
+
+std::string ringName(const char *suffix)
+{
+	return "/ltf-test-" + std::to_string(getpid()) + "-" + suffix;
+}
+
+std::string payloadFor(std::uint64_t i)
+{
+	// Every byte depends on i so that a torn read would be detected.
+	return std::string(8 + i % 200, static_cast<char>('a' + i % 26)) + std::to_string(i);
+}
+
+} // namespace
+
+TEST(TranscriptRingTest, DeliversMessagesInOrder)
+{
+	TranscriptRingWriter writer(ringName("order"), 8, 64);
+	unique_reader_t reader(transcript_ring_open(writer.name().c_str()));
+	ASSERT_NE(reader, nullptr);
+
+	char buffer[64];
+	transcript_ring_message message{};
+	EXPECT_EQ(transcript_ring_read(reader.get(), buffer, sizeof(buffer), &message), TRANSCRIPT_RING_EMPTY);
+
+	ASSERT_TRUE(writer.publish(TRANSCRIPT_RING_TOPIC_PARTIAL, R"({"partial":"hel"})"));
+	ASSERT_TRUE(writer.publish(TRANSCRIPT_RING_TOPIC_FINAL, R"({"text":"hello"})"));
+
+	ASSERT_EQ(transcript_ring_read(reader.get(), buffer, sizeof(buffer), &message), TRANSCRIPT_RING_OK);
+	EXPECT_EQ(message.seq, 0u);
+	EXPECT_EQ(message.topic, static_cast<std::uint32_t>(TRANSCRIPT_RING_TOPIC_PARTIAL));
+	EXPECT_EQ(std::string(buffer, message.length), R"({"partial":"hel"})");
+
+	ASSERT_EQ(transcript_ring_read(reader.get(), buffer, 4, &message), TRANSCRIPT_RING_BUFFER_TOO_SMALL);
+	EXPECT_EQ(message.length, 16u);
+	ASSERT_EQ(transcript_ring_read(reader.get(), buffer, sizeof(buffer), &message), TRANSCRIPT_RING_OK);
+	EXPECT_EQ(message.topic, static_cast<std::uint32_t>(TRANSCRIPT_RING_TOPIC_FINAL));
+	EXPECT_EQ(std::string(buffer, message.length), R"({"text":"hello"})");
+
+	EXPECT_FALSE(writer.publish(TRANSCRIPT_RING_TOPIC_FINAL, std::string(65, 'x')));
+	EXPECT_EQ(transcript_ring_read(reader.get(), buffer, sizeof(buffer), &message), TRANSCRIPT_RING_EMPTY);
+}
+
+TEST(TranscriptRingTest, LappedReaderSkipsToOldestMessage)
+{
+	TranscriptRingWriter writer(ringName("lap"), 4, 64);
+	unique_reader_t reader(transcript_ring_open(writer.name().c_str()));
+	ASSERT_NE(reader, nullptr);
+
+	for (int i = 0; i < 10; ++i) {
+		ASSERT_TRUE(writer.publish(TRANSCRIPT_RING_TOPIC_FINAL, std::to_string(i)));
+	}
+
+	char buffer[64];
+	transcript_ring_message message{};
+	ASSERT_EQ(transcript_ring_read(reader.get(), buffer, sizeof(buffer), &message), TRANSCRIPT_RING_OK);
+	EXPECT_EQ(std::string(buffer, message.length), "6");
+	EXPECT_EQ(transcript_ring_lost(reader.get()), 6u);
+}
+
+TEST(TranscriptRingTest, ConcurrentReaderNeverSeesTornMessages)
+{
+	constexpr std::uint64_t count = 200000;
+	auto writer = std::make_unique<TranscriptRingWriter>(ringName("torn"), 16, 256);
+	unique_reader_t reader(transcript_ring_open(writer->name().c_str()));
+	ASSERT_NE(reader, nullptr);
+
+	std::thread producer([&writer] {
+		for (std::uint64_t i = 0; i < count; ++i) {
+			writer->publish(TRANSCRIPT_RING_TOPIC_PARTIAL, payloadFor(i));
+		}
+		writer.reset();
+	});
+
+	char buffer[256];
+	transcript_ring_message message{};
+	std::uint64_t received = 0;
+	std::uint64_t lastSeq = 0;
+	for (;;) {
+		const int status = transcript_ring_read(reader.get(), buffer, sizeof(buffer), &message);
+		if (status == TRANSCRIPT_RING_OK) {
+			ASSERT_EQ(std::string(buffer, message.length), payloadFor(message.seq));
+			if (received > 0) {
+				ASSERT_GT(message.seq, lastSeq);
+			}
+			lastSeq = message.seq;
+			++received;
+		} else if (status == TRANSCRIPT_RING_EMPTY) {
+			transcript_ring_wait(reader.get(), 100);
+		} else {
+			ASSERT_EQ(status, TRANSCRIPT_RING_CLOSED);
+			break;
+		}
+	}
+	producer.join();
+
+	EXPECT_EQ(lastSeq, count - 1);
+	EXPECT_EQ(received + transcript_ring_lost(reader.get()), count);
+}
+
+TEST(TranscriptRingTest, WaitWakesUpOnPublish)
+{
+	TranscriptRingWriter writer(ringName("wait"), 4, 64);
+	unique_reader_t reader(transcript_ring_open(writer.name().c_str()));
+	ASSERT_NE(reader, nullptr);
+
+	EXPECT_EQ(transcript_ring_wait(reader.get(), 10), TRANSCRIPT_RING_TIMEOUT);
+
+	std::thread producer([&writer] {
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		writer.publish(TRANSCRIPT_RING_TOPIC_FINAL, "done");
+	});
+	EXPECT_EQ(transcript_ring_wait(reader.get(), 10000), TRANSCRIPT_RING_OK);
+	producer.join();
+}
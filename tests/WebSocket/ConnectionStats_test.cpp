@@ -0,0 +1,146 @@
+/*
+Live Transcribe Fine
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <ConnectionStats.hpp>
+
+using namespace KaitoTokyo::WebSocket;
+
+namespace {
+
+/**
+ * Stands in for a uWS WebSocket, which keeps its PerSocketData inline.
+ */
+struct FakeClient {
+	PerSocketData data;
+	PerSocketData *getUserData() { return &data; }
+};
+
+PerSocketData connection(std::uint64_t id, std::chrono::system_clock::time_point connectedAt)
+{
+	PerSocketData data;
+	data.id = id;
+	data.connectedAt = connectedAt;
+	return data;
+}
+
+std::vector<std::uint64_t> ids(const ConnectionRegistry<FakeClient> &registry)
+{
+	std::vector<std::uint64_t> result;
+	for (FakeClient *client : registry) {
+		result.push_back(client->data.id);
+	}
+	return result;
+}
+
+const std::chrono::system_clock::time_point connectedAt{std::chrono::milliseconds(1500)}; ///< Since the epoch
+
+} // namespace
+
+TEST(ConnectionStatsTest, FormatsOneConnection)
+{
+	PerSocketData data = connection(7, connectedAt);
+	data.bytesSent = 1024;
+	data.messagesSent = 3;
+	data.messagesDropped = 1;
+	data.subscriptions = BroadcastTopicBit | PartialTopicBit;
+	data.format = MessageFormat::Text;
+
+	fmt::memory_buffer buffer;
+	formatConnectionStats(buffer, data, 42, connectedAt + std::chrono::seconds(90));
+	EXPECT_EQ(fmt::to_string(buffer),
+		  R"({"id":7,"connectedAt":1500,"connectedSeconds":90,"bytesSent":1024,"messagesSent":3,)"
+		  R"("messagesDropped":1,"bufferedAmount":42,"format":"text",)"
+		  R"("subscriptions":["broadcast","partial"]})");
+
+	buffer.clear();
+	data.subscriptions = NoTopic;
+	formatConnectionStats(buffer, data, 0, connectedAt);
+	EXPECT_NE(fmt::to_string(buffer).find(R"("connectedSeconds":0,)"), std::string::npos);
+	EXPECT_NE(fmt::to_string(buffer).find(R"("subscriptions":[]})"), std::string::npos);
+}
+
+TEST(ConnectionStatsTest, FormatsTheStatsDocument)
+{
+	ServerStats stats;
+	stats.totalConnections = 5;
+	stats.totalBytesSent = 2048;
+	stats.totalMessagesSent = 6;
+	stats.totalMessagesDropped = 2;
+	stats.serializationHits = 10;
+	stats.serializationMisses = 4;
+	PerSocketData first = connection(1, connectedAt);
+	first.subscriptions = FinalTopicBit;
+	PerSocketData second = connection(2, connectedAt);
+	PerSocketData sse = connection(3, connectedAt);
+	sse.subscriptions = DefaultTopics;
+	sse.format = MessageFormat::Compact;
+
+	const std::string json = formatServerStatsJson(stats, {{&first, 100}, {&second, 20}}, {{&sse, 3}},
+						       connectedAt + std::chrono::seconds(2));
+	// The fields every connection shares here, up to its buffered amount
+	const std::string counters = R"("connectedAt":1500,"connectedSeconds":2,"bytesSent":0,"messagesSent":0,)"
+				     R"("messagesDropped":0,"bufferedAmount":)";
+	std::string expected =
+		R"({"clients":2,"sseClients":1,"totalConnections":5,"totalBytesSent":2048,"totalMessagesSent":6,)"
+		R"("totalMessagesDropped":2,"serializationHits":10,"serializationMisses":4,"bufferedAmount":123,)";
+	expected += R"("connections":[{"id":1,)" + counters + R"(100,"format":"json","subscriptions":["final"]},)";
+	expected += R"({"id":2,)" + counters + R"(20,"format":"json","subscriptions":[]}],)";
+	expected += R"("sseConnections":[{"id":3,)" + counters +
+		    R"(3,"format":"compact","subscriptions":["broadcast","final","partial"]}]})";
+	EXPECT_EQ(json, expected);
+
+	EXPECT_EQ(formatServerStatsJson({}, {}, {}, connectedAt),
+		  R"({"clients":0,"sseClients":0,"totalConnections":0,"totalBytesSent":0,"totalMessagesSent":0,)"
+		  R"("totalMessagesDropped":0,"serializationHits":0,"serializationMisses":0,"bufferedAmount":0,)"
+		  R"("connections":[],"sseConnections":[]})");
+}
+
+TEST(ConnectionStatsTest, RegistryRemovesBySwappingInTheLastClient)
+{
+	std::vector<FakeClient> clients(4);
+	ConnectionRegistry<FakeClient> registry;
+	for (std::size_t i = 0; i < clients.size(); ++i) {
+		clients[i].data.id = i;
+		registry.add(&clients[i]);
+	}
+
+	EXPECT_TRUE(registry.remove(&clients[1]));
+	EXPECT_EQ(ids(registry), (std::vector<std::uint64_t>{0, 3, 2}));
+	EXPECT_EQ(clients[3].data.registryIndex, 1u);
+
+	// The last entry and the only entry leave nothing to swap in
+	EXPECT_TRUE(registry.remove(&clients[2]));
+	EXPECT_TRUE(registry.remove(&clients[0]));
+	EXPECT_EQ(ids(registry), (std::vector<std::uint64_t>{3}));
+	EXPECT_EQ(clients[3].data.registryIndex, 0u);
+	EXPECT_TRUE(registry.remove(&clients[3]));
+	EXPECT_TRUE(registry.empty());
+
+	// Removing twice, e.g. from a close handler running after a failed open, is harmless
+	registry.add(&clients[0]);
+	registry.add(&clients[1]);
+	EXPECT_TRUE(registry.remove(&clients[0]));
+	EXPECT_FALSE(registry.remove(&clients[0]));
+	EXPECT_EQ(ids(registry), (std::vector<std::uint64_t>{1}));
+}
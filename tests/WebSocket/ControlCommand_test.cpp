@@ -0,0 +1,96 @@
+/*
+Live Transcribe Fine
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+
+#include <ControlCommand.hpp>
+
+using namespace KaitoTokyo::WebSocket;
+
+TEST(ControlCommandTest, ParsesCommandsWithoutArgument)
+{
+	EXPECT_EQ(ControlCommand::parse("pause").type, ControlCommandType::Pause);
+	EXPECT_EQ(ControlCommand::parse("resume\n").type, ControlCommandType::Resume);
+	EXPECT_EQ(ControlCommand::parse("  snapshot ").type, ControlCommandType::RequestSnapshot);
+}
+
+TEST(ControlCommandTest, ParsesCommandsWithArgument)
+{
+	ControlCommand model = ControlCommand::parse("model /models/vosk model-ja");
+	EXPECT_EQ(model.type, ControlCommandType::SwitchModel);
+	EXPECT_EQ(model.argument, "/models/vosk model-ja");
+
+	ControlCommand rate = ControlCommand::parse("partial-rate 2.5");
+	EXPECT_EQ(rate.type, ControlCommandType::SetPartialRate);
+	EXPECT_DOUBLE_EQ(rate.partialRate, 2.5);
+
+	EXPECT_EQ(ControlCommand::parse("subscribe final").argument, "final");
+	EXPECT_EQ(ControlCommand::parse("format compact").type, ControlCommandType::SetFormat);
+}
+
+TEST(ControlCommandTest, RejectsInvalidCommands)
+{
+	EXPECT_THROW(ControlCommand::parse(""), std::invalid_argument);
+	EXPECT_THROW(ControlCommand::parse("reboot"), std::invalid_argument);
+	EXPECT_THROW(ControlCommand::parse("pause now"), std::invalid_argument);
+	EXPECT_THROW(ControlCommand::parse("model"), std::invalid_argument);
+	EXPECT_THROW(ControlCommand::parse("partial-rate fast"), std::invalid_argument);
+	EXPECT_THROW(ControlCommand::parse("partial-rate -1"), std::invalid_argument);
+}
+
+TEST(ControlCommandTest, QueueTransfersCommandsAcrossThreads)
+{
+	ControlCommandQueue queue(4);
+	std::thread producer([&queue] {
+		for (int i = 0; i < 1000; ++i) {
+			ControlCommand command = ControlCommand::parse("partial-rate " + std::to_string(i));
+			while (!queue.tryPush(std::move(command))) {
+				std::this_thread::yield();
+			}
+		}
+	});
+
+	for (int expected = 0; expected < 1000;) {
+		if (auto command = queue.tryPop()) {
+			EXPECT_DOUBLE_EQ(command->partialRate, expected);
+			++expected;
+		}
+	}
+	producer.join();
+	EXPECT_TRUE(queue.empty());
+}
+
+TEST(ControlCommandTest, AcceptsOnlyLocalPeers)
+{
+	using namespace std::string_literals;
+	EXPECT_TRUE(isLocalPeerAddress(""));
+	EXPECT_TRUE(isLocalPeerAddress("\x7f\x00\x00\x01"s));
+	EXPECT_TRUE(isLocalPeerAddress("\x7f\x01\x02\x03"s));
+	EXPECT_TRUE(isLocalPeerAddress(std::string(15, '\0') + "\x01"));
+	EXPECT_TRUE(isLocalPeerAddress(std::string(10, '\0') + "\xff\xff\x7f\x00\x00\x01"s));
+
+	EXPECT_FALSE(isLocalPeerAddress("\xc0\xa8\x00\x02"s));
+	EXPECT_FALSE(isLocalPeerAddress("\x00\x00\x00\x00"s));
+	EXPECT_FALSE(isLocalPeerAddress(std::string(16, '\0')));
+	EXPECT_FALSE(isLocalPeerAddress(std::string(10, '\0') + "\xff\xff\xc0\xa8\x00\x02"s));
+	EXPECT_FALSE(isLocalPeerAddress("\xfe\x80" + std::string(13, '\0') + "\x01"));
+	EXPECT_FALSE(isLocalPeerAddress("\x7f\x00\x00"s));
+}
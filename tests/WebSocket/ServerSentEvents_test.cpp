@@ -0,0 +1,91 @@
+/*
+Live Transcribe Fine
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <ServerSentEvents.hpp>
+
+using namespace KaitoTokyo::WebSocket;
+
+namespace {
+
+std::string frame(std::uint32_t topicBits, std::string_view message)
+{
+	std::string stream;
+	const std::size_t written =
+		writeSseEvent([&stream](std::string_view part) { stream += part; }, topicBits, message);
+	EXPECT_EQ(written, stream.size());
+	return stream;
+}
+
+/**
+ * Parses a stream the way an EventSource does, as (type, data) pairs. Comments are skipped.
+ */
+std::vector<std::pair<std::string, std::string>> parse(std::string_view stream)
+{
+	std::vector<std::pair<std::string, std::string>> events;
+	std::string type;
+	std::string data;
+	bool hasData = false;
+	while (!stream.empty()) {
+		const std::size_t newline = stream.find('\n');
+		const std::string_view line = stream.substr(0, newline);
+		stream = newline == std::string_view::npos ? std::string_view{} : stream.substr(newline + 1);
+		if (line.empty()) {
+			if (hasData) {
+				events.emplace_back(type.empty() ? "message" : type, data);
+			}
+			type.clear();
+			data.clear();
+			hasData = false;
+		} else if (line.rfind("event: ", 0) == 0) {
+			type = line.substr(7);
+		} else if (line.rfind("data: ", 0) == 0) {
+			data += hasData ? "\n" : "";
+			data += line.substr(6);
+			hasData = true;
+		}
+	}
+	return events;
+}
+
+} // namespace
+
+TEST(ServerSentEventsTest, NamesEventsAfterTheirTopic)
+{
+	EXPECT_EQ(frame(FinalTopicBit, R"({"text":"hello"})"), "event: final\ndata: {\"text\":\"hello\"}\n\n");
+	EXPECT_EQ(frame(PartialTopicBit, "hel"), "event: partial\ndata: hel\n\n");
+	EXPECT_EQ(frame(BroadcastTopicBit, "announcement"), "data: announcement\n\n");
+}
+
+TEST(ServerSentEventsTest, SplitsMultiLinePayloadsIntoDataFields)
+{
+	const std::string vosk = "{\n  \"result\" : [],\n  \"text\" : \"hello\"\n}";
+	const std::string stream = frame(FinalTopicBit, vosk);
+	EXPECT_EQ(stream, "event: final\ndata: {\ndata:   \"result\" : [],\ndata:   \"text\" : \"hello\"\ndata: }\n\n");
+
+	const std::string keptAlive = frame(PartialTopicBit, "a\n\nb") + std::string(sseKeepAliveComment) +
+				      std::string(sseKeepAliveComment) + frame(BroadcastTopicBit, "c");
+	EXPECT_EQ(parse(stream + keptAlive), (std::vector<std::pair<std::string, std::string>>{
+						     {"final", vosk}, {"partial", "a\n\nb"}, {"message", "c"}}));
+}
@@ -0,0 +1,127 @@
+/*
+Live Transcribe Fine
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+
+#include <brotli/decode.h>
+#include <zlib.h>
+
+#include <StaticAssetCache.hpp>
+
+using namespace KaitoTokyo::WebSocket;
+
+namespace {
+
+std::string gunzip(const std::string &input)
+{
+	z_stream stream{};
+	EXPECT_EQ(inflateInit2(&stream, 15 + 16), Z_OK);
+	std::string output(1 << 20, '\0');
+	stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+	stream.avail_in = static_cast<uInt>(input.size());
+	stream.next_out = reinterpret_cast<Bytef *>(output.data());
+	stream.avail_out = static_cast<uInt>(output.size());
+	EXPECT_EQ(inflate(&stream, Z_FINISH), Z_STREAM_END);
+	output.resize(stream.total_out);
+	inflateEnd(&stream);
+	return output;
+}
+
+std::string unbrotli(const std::string &input)
+{
+	std::string output(1 << 20, '\0');
+	std::size_t decodedSize = output.size();
+	EXPECT_EQ(BrotliDecoderDecompress(input.size(), reinterpret_cast<const std::uint8_t *>(input.data()),
+					  &decodedSize, reinterpret_cast<std::uint8_t *>(output.data())),
+		  BROTLI_DECODER_RESULT_SUCCESS);
+	output.resize(decodedSize);
+	return output;
+}
+
+} // namespace
+
+TEST(StaticAssetCacheTest, PrecompressesAssets)
+{
+	std::string body;
+	for (int i = 0; i < 200; ++i) {
+		body += "<p>caption line " + std::to_string(i) + "</p>\n";
+	}
+
+	StaticAssetCache cache;
+	cache.add("/overlay/index.html", "text/html", body);
+
+	const StaticAsset *asset = cache.find("/overlay/");
+	ASSERT_NE(asset, nullptr);
+	EXPECT_EQ(asset->identity, body);
+	ASSERT_FALSE(asset->gzip.empty());
+	ASSERT_FALSE(asset->brotli.empty());
+	EXPECT_LT(asset->gzip.size(), body.size());
+	EXPECT_EQ(gunzip(asset->gzip), body);
+	EXPECT_EQ(unbrotli(asset->brotli), body);
+}
+
+TEST(StaticAssetCacheTest, KeepsIdentityWhenCompressionDoesNotHelp)
+{
+	StaticAssetCache cache;
+	cache.add("/overlay/a.txt", "text/plain", "a");
+
+	const StaticAsset *asset = cache.find("/overlay/a.txt");
+	ASSERT_NE(asset, nullptr);
+	EXPECT_EQ(asset->effectiveEncoding(ContentEncoding::Brotli), ContentEncoding::Identity);
+	EXPECT_EQ(asset->body(ContentEncoding::Gzip), "a");
+	EXPECT_EQ(asset->etag(ContentEncoding::Brotli), asset->identityEtag);
+}
+
+TEST(StaticAssetCacheTest, EtagsDifferPerContentAndEncoding)
+{
+	StaticAssetCache cache;
+	cache.add("/a.css", "text/css", std::string(1000, 'a'));
+	cache.add("/b.css", "text/css", std::string(1000, 'b'));
+
+	const StaticAsset *a = cache.find("/a.css");
+	const StaticAsset *b = cache.find("/b.css");
+	ASSERT_NE(a, nullptr);
+	ASSERT_NE(b, nullptr);
+	EXPECT_NE(a->identityEtag, b->identityEtag);
+	EXPECT_NE(a->etag(ContentEncoding::Gzip), a->etag(ContentEncoding::Brotli));
+	EXPECT_EQ(a->identityEtag.front(), '"');
+	EXPECT_EQ(a->identityEtag.back(), '"');
+	EXPECT_EQ(cache.find("/missing.css"), nullptr);
+}
+
+TEST(StaticAssetCacheTest, NegotiatesContentEncoding)
+{
+	EXPECT_EQ(StaticAssetCache::negotiate(""), ContentEncoding::Identity);
+	EXPECT_EQ(StaticAssetCache::negotiate("gzip, deflate"), ContentEncoding::Gzip);
+	EXPECT_EQ(StaticAssetCache::negotiate("gzip, deflate, br, zstd"), ContentEncoding::Brotli);
+	EXPECT_EQ(StaticAssetCache::negotiate("br;q=0, gzip;q=0.5"), ContentEncoding::Gzip);
+	EXPECT_EQ(StaticAssetCache::negotiate("identity"), ContentEncoding::Identity);
+}
+
+TEST(StaticAssetCacheTest, LoadsCaptionOverlay)
+{
+	StaticAssetCache cache = StaticAssetCache::loadDirectory(DATA_DIR "/overlay", "/overlay/");
+	const StaticAsset *index = cache.find("/overlay/");
+	ASSERT_NE(index, nullptr);
+	EXPECT_EQ(index->contentType, "text/html; charset=utf-8");
+	EXPECT_NE(cache.find("/overlay/overlay.js"), nullptr);
+	EXPECT_NE(cache.find("/overlay/overlay.css"), nullptr);
+}
@@ -0,0 +1,104 @@
+/*
+Live Transcribe Fine
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <TlsSessionResumption.hpp>
+
+namespace KaitoTokyo {
+namespace Tests {
+
+/**
+ * @brief A server context set up like the one of the wss:// server, and a client context that caches sessions.
+ */
+struct TlsContexts {
+	SSL_CTX *server;
+	SSL_CTX *client;
+
+	explicit TlsContexts(bool sessionTickets)
+		: server(SSL_CTX_new(TLS_server_method())),
+		  client(SSL_CTX_new(TLS_client_method()))
+	{
+		SSL_CTX_use_certificate_chain_file(server, TESTS_DIR "/WebSocket/tls/cert.pem");
+		SSL_CTX_use_PrivateKey_file(server, TESTS_DIR "/WebSocket/tls/key.pem", SSL_FILETYPE_PEM);
+		WebSocket::TlsOptions options;
+		options.sessionTickets = sessionTickets;
+		WebSocket::configureTlsSessionResumption(server, options);
+		SSL_CTX_set_session_cache_mode(client, SSL_SESS_CACHE_CLIENT);
+	}
+
+	~TlsContexts()
+	{
+		SSL_CTX_free(server);
+		SSL_CTX_free(client);
+	}
+};
+
+// Moves pending bytes from one memory BIO to the other
+inline void transfer(BIO *from, BIO *to)
+{
+	char buffer[16384];
+	int n;
+	while ((n = BIO_read(from, buffer, sizeof(buffer))) > 0) {
+		BIO_write(to, buffer, n);
+	}
+}
+
+/**
+ * Runs one handshake in memory, optionally offering a session, and returns the session to resume next time.
+ */
+inline SSL_SESSION *tlsHandshake(TlsContexts &contexts, SSL_SESSION *offered, bool *completed, bool *reused)
+{
+	SSL *server = SSL_new(contexts.server);
+	SSL *client = SSL_new(contexts.client);
+	BIO *serverIn = BIO_new(BIO_s_mem()), *serverOut = BIO_new(BIO_s_mem());
+	BIO *clientIn = BIO_new(BIO_s_mem()), *clientOut = BIO_new(BIO_s_mem());
+	SSL_set_bio(server, serverIn, serverOut);
+	SSL_set_bio(client, clientIn, clientOut);
+	SSL_set_accept_state(server);
+	SSL_set_connect_state(client);
+	if (offered) {
+		SSL_set_session(client, offered);
+	}
+
+	bool serverDone = false, clientDone = false;
+	for (int round = 0; round < 10 && !(serverDone && clientDone); ++round) {
+		clientDone = SSL_do_handshake(client) == 1;
+		transfer(clientOut, serverIn);
+		serverDone = SSL_do_handshake(server) == 1;
+		transfer(serverOut, clientIn);
+	}
+	*completed = serverDone && clientDone;
+
+	// TLS 1.3 tickets arrive after the handshake, so let the client read them
+	char byte;
+	SSL_read(client, &byte, 1);
+
+	*reused = SSL_session_reused(client) == 1;
+	SSL_SESSION *session = SSL_get1_session(client);
+	// Sessions of connections freed without close_notify are not resumable
+	SSL_shutdown(client);
+	transfer(clientOut, serverIn);
+	SSL_shutdown(server);
+	SSL_free(server);
+	SSL_free(client);
+	return session;
+}
+
+} // namespace Tests
+} // namespace KaitoTokyo
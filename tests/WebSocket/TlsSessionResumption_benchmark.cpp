@@ -0,0 +1,66 @@
+/*
+Live Transcribe Fine
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <ctime>
+#include <iostream>
+
+#include "TlsHandshake.hpp"
+
+using KaitoTokyo::Tests::TlsContexts;
+using KaitoTokyo::Tests::tlsHandshake;
+
+namespace {
+
+constexpr int handshakeCount = 200;
+
+double cpuMillisecondsPerHandshake(TlsContexts &contexts, bool resume)
+{
+	bool completed = false, reused = false;
+	SSL_SESSION *session = resume ? tlsHandshake(contexts, nullptr, &completed, &reused) : nullptr;
+
+	const std::clock_t begin = std::clock();
+	for (int i = 0; i < handshakeCount; ++i) {
+		SSL_SESSION *next = tlsHandshake(contexts, session, &completed, &reused);
+		if (resume) {
+			SSL_SESSION_free(session);
+			session = next;
+		} else {
+			SSL_SESSION_free(next);
+		}
+	}
+	const std::clock_t end = std::clock();
+
+	SSL_SESSION_free(session);
+	return 1000.0 * static_cast<double>(end - begin) / CLOCKS_PER_SEC / handshakeCount;
+}
+
+} // namespace
+
+// Prints the CPU time of full and resumed handshakes with the TLS library the server is built with
+int main()
+{
+	std::cout << OpenSSL_version(OPENSSL_VERSION) << ", " << handshakeCount << " handshakes each" << std::endl;
+	for (bool sessionTickets : {true, false}) {
+		TlsContexts contexts(sessionTickets);
+		const double full = cpuMillisecondsPerHandshake(contexts, false);
+		const double resumed = cpuMillisecondsPerHandshake(contexts, true);
+		std::cout << (sessionTickets ? "tickets" : "session cache") << ": full handshake " << full
+			  << " ms CPU, resumed " << resumed << " ms CPU" << std::endl;
+	}
+	return 0;
+}
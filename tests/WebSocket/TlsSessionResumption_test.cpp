@@ -0,0 +1,67 @@
+/*
+Live Transcribe Fine
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <gtest/gtest.h>
+
+#include "TlsHandshake.hpp"
+
+using KaitoTokyo::Tests::TlsContexts;
+using KaitoTokyo::Tests::tlsHandshake;
+
+namespace {
+
+constexpr int handshakeCount = 20;
+
+/**
+ * Counts the handshakes that resumed a session, either offering the previous session each time or never.
+ */
+int countReusedHandshakes(TlsContexts &contexts, bool resume)
+{
+	bool completed = false, reused = false;
+	SSL_SESSION *session = resume ? tlsHandshake(contexts, nullptr, &completed, &reused) : nullptr;
+	int reusedCount = 0;
+	for (int i = 0; i < handshakeCount; ++i) {
+		SSL_SESSION *next = tlsHandshake(contexts, session, &completed, &reused);
+		EXPECT_TRUE(completed);
+		reusedCount += reused;
+		if (resume) {
+			SSL_SESSION_free(session);
+			session = next;
+		} else {
+			SSL_SESSION_free(next);
+		}
+	}
+	SSL_SESSION_free(session);
+	return reusedCount;
+}
+
+} // namespace
+
+TEST(TlsSessionResumptionTest, TicketsSkipTheFullHandshake)
+{
+	TlsContexts contexts(true);
+	EXPECT_EQ(countReusedHandshakes(contexts, false), 0);
+	EXPECT_EQ(countReusedHandshakes(contexts, true), handshakeCount);
+}
+
+TEST(TlsSessionResumptionTest, SessionCacheSkipsTheFullHandshake)
+{
+	TlsContexts contexts(false);
+	EXPECT_EQ(countReusedHandshakes(contexts, false), 0);
+	EXPECT_EQ(countReusedHandshakes(contexts, true), handshakeCount);
+}
@@ -0,0 +1,67 @@
+/*
+Live Transcribe Fine
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <gtest/gtest.h>
+
+#include <TranscriptMessage.hpp>
+
+using namespace KaitoTokyo::WebSocket;
+
+TEST(TranscriptMessageTest, DerivesFormatsFromVoskResults)
+{
+	const TranscriptMessage final(FinalTopicBit, "{\n  \"result\" : [],\n  \"text\" : \"say \\\"hi\\\"\"\n}");
+	EXPECT_EQ(final.representation(MessageFormat::Compact), R"({"type":"final","text":"say \"hi\""})");
+	EXPECT_EQ(final.representation(MessageFormat::Text), "say \"hi\"");
+
+	const TranscriptMessage partial(PartialTopicBit, "{\n  \"partial\" : \"\\u3053\\u3093\"\n}");
+	EXPECT_EQ(partial.representation(MessageFormat::Compact), R"({"type":"partial","text":"\u3053\u3093"})");
+	EXPECT_EQ(partial.representation(MessageFormat::Text), "\xe3\x81\x93\xe3\x82\x93");
+}
+
+TEST(TranscriptMessageTest, SerializesEachFormatOnce)
+{
+	const TranscriptMessage message(FinalTopicBit, R"({"text" : "hello"})");
+	const std::string_view first = message.representation(MessageFormat::Text);
+	for (int i = 0; i < 9; ++i) {
+		EXPECT_EQ(message.representation(MessageFormat::Text).data(), first.data());
+	}
+	message.representation(MessageFormat::Compact);
+	message.representation(MessageFormat::Json);
+
+	EXPECT_EQ(message.misses(), 2u);
+	EXPECT_EQ(message.hits(), 9u); // The Json request returns the source without looking at the cache
+}
+
+TEST(TranscriptMessageTest, BroadcastMessagesAreOpaque)
+{
+	const TranscriptMessage message(BroadcastTopicBit, "plain announcement");
+	EXPECT_EQ(message.representation(MessageFormat::Text), "plain announcement");
+	EXPECT_EQ(message.representation(MessageFormat::Compact), "plain announcement");
+	EXPECT_EQ(message.misses(), 0u);
+}
+
+TEST(TranscriptMessageTest, DecodesSurrogatePairsIntoFourByteUtf8)
+{
+	const TranscriptMessage paired(FinalTopicBit, R"({"text" : "\ud83c\udf89 ok"})");
+	EXPECT_EQ(paired.representation(MessageFormat::Text), "\xf0\x9f\x8e\x89 ok");
+
+	// Unpaired surrogates have no UTF-8 encoding of their own
+	const TranscriptMessage unpaired(FinalTopicBit, R"({"text" : "a\ud83cb\udf89c\ud83c\u0041\ud83c"})");
+	EXPECT_EQ(unpaired.representation(MessageFormat::Text),
+		  "a\xef\xbf\xbd" "b\xef\xbf\xbd" "c\xef\xbf\xbd" "A\xef\xbf\xbd");
+}
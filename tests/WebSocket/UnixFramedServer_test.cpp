@@ -0,0 +1,286 @@
+/*
+Live Transcribe Fine
+Copyright (C) 2025 Kaito Udagawa umireon@kaito.tokyo
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <UnixFramedServer.hpp>
+
+#include "../TestLoggers.hpp"
+
+using namespace KaitoTokyo::WebSocket;
+using KaitoTokyo::Tests::CapturingLogger;
+
+namespace {
+
+template<typename Predicate> bool waitUntil(Predicate predicate)
+{
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+	while (!predicate()) {
+		if (std::chrono::steady_clock::now() > deadline) {
+			return false;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return true;
+}
+
+std::string socketPath(const char *name)
+{
+	return "/tmp/unix-framed-" + std::to_string(::getpid()) + "-" + name + ".sock";
+}
+
+/**
+ * Connects a client, optionally with a small receive buffer, and waits until the server has accepted it.
+ */
+int connectClient(const std::string &path, const CapturingLogger &logger, int clientNumber, int receiveBuffer = 0)
+{
+	const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (receiveBuffer > 0) {
+		::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &receiveBuffer, sizeof(receiveBuffer));
+	}
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+	EXPECT_EQ(::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)), 0);
+	const std::string accepted = "client #" + std::to_string(clientNumber) + " connected";
+	EXPECT_TRUE(waitUntil([&] { return logger.logged({accepted}); }));
+	return fd;
+}
+
+bool readExactly(int fd, char *data, std::size_t size)
+{
+	while (size > 0) {
+		pollfd pfd{fd, POLLIN, 0};
+		if (::poll(&pfd, 1, 10000) <= 0) {
+			return false;
+		}
+		const ssize_t received = ::recv(fd, data, size, 0);
+		if (received <= 0) {
+			return false;
+		}
+		data += received;
+		size -= static_cast<std::size_t>(received);
+	}
+	return true;
+}
+
+struct Frame {
+	unsigned char header[UnixFramedServer::headerSize];
+	std::string payload;
+};
+
+std::optional<Frame> readFrame(int fd)
+{
+	Frame frame;
+	if (!readExactly(fd, reinterpret_cast<char *>(frame.header), sizeof(frame.header))) {
+		return std::nullopt;
+	}
+	const std::uint32_t length = (std::uint32_t(frame.header[0]) << 24) | (std::uint32_t(frame.header[1]) << 16) |
+				     (std::uint32_t(frame.header[2]) << 8) | std::uint32_t(frame.header[3]);
+	frame.payload.resize(length);
+	if (!readExactly(fd, frame.payload.data(), length)) {
+		return std::nullopt;
+	}
+	return frame;
+}
+
+std::shared_ptr<const std::string> message(std::string text)
+{
+	return std::make_shared<const std::string>(std::move(text));
+}
+
+} // namespace
+
+TEST(UnixFramedServerTest, PrefixesEachMessageWithLengthAndTopic)
+{
+	CapturingLogger logger;
+	const std::string path = socketPath("framing");
+	UnixFramedServer server(logger, path);
+	ASSERT_TRUE(server.start());
+	const int fd = connectClient(path, logger, 1);
+
+	server.publish(FinalTopicBit, message("hello"));
+	server.publish(PartialTopicBit, message(""));
+
+	char bytes[UnixFramedServer::headerSize * 2 + 5];
+	ASSERT_TRUE(readExactly(fd, bytes, sizeof(bytes)));
+	EXPECT_EQ(std::string(bytes, sizeof(bytes)), std::string("\0\0\0\5\2hello\0\0\0\0\4", sizeof(bytes)));
+
+	::close(fd);
+}
+
+TEST(UnixFramedServerTest, BuffersTheRestOfPartialWritesInOrder)
+{
+	CapturingLogger logger;
+	const std::string path = socketPath("partial");
+	UnixFramedServer server(logger, path);
+	ASSERT_TRUE(server.start());
+	const int fd = connectClient(path, logger, 1, 4096);
+
+	// Far more than a socket buffer, so sendmsg only writes part of it
+	std::string large(0x010203, '\0');
+	for (std::size_t i = 0; i < large.size(); ++i) {
+		large[i] = static_cast<char>(i * 7);
+	}
+	server.publish(BroadcastTopicBit, message(large));
+	server.publish(FinalTopicBit, message("tail"));
+
+	const std::optional<Frame> first = readFrame(fd);
+	ASSERT_TRUE(first);
+	EXPECT_EQ(std::vector<unsigned char>(first->header, first->header + 5),
+		  (std::vector<unsigned char>{0, 1, 2, 3, BroadcastTopicBit}));
+	EXPECT_TRUE(first->payload == large);
+	const std::optional<Frame> second = readFrame(fd);
+	ASSERT_TRUE(second);
+	EXPECT_EQ(second->header[4], FinalTopicBit);
+	EXPECT_EQ(second->payload, "tail");
+
+	::close(fd);
+}
+
+TEST(UnixFramedServerTest, DropsMessagesForClientsBeyondMaxBackpressure)
+{
+	CapturingLogger logger;
+	const std::string path = socketPath("backpressure");
+	UnixFramedServer server(logger, path);
+	ASSERT_TRUE(server.start());
+	const int slow = connectClient(path, logger, 1, 4096);
+	const int observer = connectClient(path, logger, 2);
+
+	// The observer keeps reading, so once it has the last message the server is done with all three
+	std::atomic<int> observed{0};
+	std::thread observing([observer, &observed] {
+		while (const std::optional<Frame> frame = readFrame(observer)) {
+			++observed;
+			if (frame->payload == "c") {
+				return;
+			}
+		}
+		ADD_FAILURE() << "The observer missed the last message";
+	});
+	// Publishing one at a time keeps the queue in front of the I/O thread from dropping anything itself
+	const std::string a(UnixFramedServer::maxBackpressure / 2, 'a');
+	const std::string b(UnixFramedServer::maxBackpressure, 'b');
+	server.publish(FinalTopicBit, message(a));
+	EXPECT_TRUE(waitUntil([&] { return observed == 1; }));
+	server.publish(FinalTopicBit, message(b));
+	EXPECT_TRUE(waitUntil([&] { return observed == 2; }));
+	server.publish(FinalTopicBit, message("c"));
+	observing.join();
+
+	const std::optional<Frame> first = readFrame(slow);
+	ASSERT_TRUE(first);
+	EXPECT_TRUE(first->payload == a);
+	const std::optional<Frame> second = readFrame(slow);
+	ASSERT_TRUE(second);
+	EXPECT_EQ(second->payload, "c");
+
+	::close(slow);
+	EXPECT_TRUE(waitUntil([&] { return logger.logged({"client #1 disconnected", "(1 messages dropped)"}); }));
+	::close(observer);
+}
+
+TEST(UnixFramedServerTest, WakesUpForMessagesFromManyThreads)
+{
+	constexpr int threadCount = 4;
+	constexpr int messagesPerThread = 250;
+
+	CapturingLogger logger;
+	const std::string path = socketPath("wakeup");
+	UnixFramedServer server(logger, path);
+	ASSERT_TRUE(server.start());
+	const int fd = connectClient(path, logger, 1);
+
+	std::vector<std::thread> publishers;
+	for (int t = 0; t < threadCount; ++t) {
+		publishers.emplace_back([&server, t] {
+			for (int i = 0; i < messagesPerThread; ++i) {
+				server.publish(PartialTopicBit, message(std::to_string(t) + ":" + std::to_string(i)));
+				if (i % 50 == 0) {
+					// Let the I/O thread go idle, so that later messages have to wake it up
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				}
+			}
+		});
+	}
+
+	std::vector<int> next(threadCount, 0);
+	for (int received = 0; received < threadCount * messagesPerThread; ++received) {
+		const std::optional<Frame> frame = readFrame(fd);
+		ASSERT_TRUE(frame) << "after " << received << " messages";
+		const std::size_t colon = frame->payload.find(':');
+		const int t = std::stoi(frame->payload.substr(0, colon));
+		EXPECT_EQ(std::stoi(frame->payload.substr(colon + 1)), next[t]++); // In order per publisher
+	}
+	for (std::thread &publisher : publishers) {
+		publisher.join();
+	}
+
+	::close(fd);
+}
+
+TEST(UnixFramedServerTest, StopDisconnectsClientsAndRemovesTheSocket)
+{
+	CapturingLogger logger;
+	const std::string path = socketPath("stop");
+
+	// A socket file left behind by a crashed session does not keep the server from starting
+	{
+		const int stale = ::socket(AF_UNIX, SOCK_STREAM, 0);
+		sockaddr_un address{};
+		address.sun_family = AF_UNIX;
+		std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+		ASSERT_EQ(::bind(stale, reinterpret_cast<sockaddr *>(&address), sizeof(address)), 0);
+		::close(stale);
+	}
+
+	UnixFramedServer server(logger, path);
+	const mode_t previousUmask = ::umask(0);
+	const bool started = server.start();
+	::umask(previousUmask);
+	ASSERT_TRUE(started);
+	struct stat status {};
+	ASSERT_EQ(::stat(path.c_str(), &status), 0);
+	EXPECT_EQ(status.st_mode & 0777, 0600); // Even a permissive umask leaves other users unable to connect
+	const int fd = connectClient(path, logger, 1);
+
+	server.stop();
+	char byte;
+	EXPECT_EQ(::recv(fd, &byte, 1, 0), 0);
+	EXPECT_NE(::access(path.c_str(), F_OK), 0);
+
+	server.publish(FinalTopicBit, message("ignored"));
+	server.stop();
+	::close(fd);
+}